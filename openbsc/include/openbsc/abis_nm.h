@@ -163,5 +163,6 @@ void abis_nm_clear_queue(struct gsm_bts *bts);
 int _abis_nm_sendmsg(struct msgb *msg);
 
 void abis_nm_queue_send_next(struct gsm_bts *bts);	/* for bs11_config. */
+void abis_nm_queue_reset(struct gsm_bts *bts);
 
 #endif /* _NM_H */
@@ -14,4 +14,22 @@ enum auth_action {
 int auth_get_tuple_for_subscr(struct gsm_auth_tuple *atuple,
                               struct gsm_subscriber *subscr, int key_seq);
 
+/* pool of precomputed tuples of the recently seen subscribers */
+#define AUTH_POOL_DEF_SUBSCRIBERS	1024
+#define AUTH_POOL_DEF_TUPLES		4
+
+struct auth_pool_stats {
+	unsigned int subscribers;
+	unsigned int tuples;
+	unsigned long long generated;
+	unsigned long long hits;
+	unsigned long long misses;
+	/* dropped because the key changed */
+	unsigned long long stale;
+};
+
+int auth_pool_init(void *ctx, unsigned int subscribers, unsigned int tuples);
+void auth_pool_flush_subscr(unsigned long long subscr_id);
+void auth_pool_get_stats(struct auth_pool_stats *stats);
+
 #endif /* _AUTH_H */
@@ -40,6 +40,9 @@
 
 #define PAGIN_GROUP_UNASSIGNED -1
 
+/* number of buckets for the SCCP reference lookup tables, power of two */
+#define NAT_SCCP_HASH_SIZE	256
+
 struct sccp_source_reference;
 struct sccp_connections;
 struct bsc_nat_parsed;
@@ -217,6 +220,12 @@ struct bsc_nat_statistics {
 	struct {
 		struct osmo_counter *reconn;
 	} ussd;
+
+	struct {
+		struct osmo_counter *forwarded;
+		/* msgb and talloc allocations made while forwarding */
+		struct osmo_counter *allocs;
+	} msg;
 };
 
 enum bsc_nat_acc_ctr {
@@ -252,6 +261,11 @@ struct bsc_nat {
 	/* active SCCP connections that need patching */
 	struct llist_head sccp_connections;
 
+	/* the same connections hashed by the patched, real and remote ref */
+	struct llist_head sccp_by_patched[NAT_SCCP_HASH_SIZE];
+	struct llist_head sccp_by_real[NAT_SCCP_HASH_SIZE];
+	struct llist_head sccp_by_remote[NAT_SCCP_HASH_SIZE];
+
 	/* active BSC connections that need patching */
 	struct llist_head bsc_connections;
 
@@ -338,8 +352,10 @@ void bsc_close_connection(struct bsc_connection *);
 const char *bsc_con_type_to_string(int type);
 
 /**
- * parse the given message into the above structure
+ * parse the given message into the above structure, the allocating
+ * version needs to be talloc_free'd by the caller.
  */
+int bsc_nat_parse_into(struct msgb *msg, struct bsc_nat_parsed *parsed);
 struct bsc_nat_parsed *bsc_nat_parse(struct msgb *msg);
 
 /**
@@ -366,6 +382,8 @@ void remove_sccp_src_ref(struct bsc_connection *bsc, struct msgb *msg, struct bs
 struct sccp_connections *patch_sccp_src_ref_to_bsc(struct msgb *, struct bsc_nat_parsed *, struct bsc_nat *);
 struct sccp_connections *patch_sccp_src_ref_to_msc(struct msgb *, struct bsc_nat_parsed *, struct bsc_connection *);
 struct sccp_connections *bsc_nat_find_con_by_bsc(struct bsc_nat *, struct sccp_source_reference *);
+void sccp_connection_set_remote_ref(struct sccp_connections *, struct sccp_source_reference *);
+void sccp_connection_unhash(struct sccp_connections *);
 
 /**
  * MGCP/Audio handling
@@ -65,6 +65,11 @@ struct bsc_nat_parsed {
 struct sccp_connections {
 	struct llist_head list_entry;
 
+	/* entries in the bsc_nat reference hash tables */
+	struct llist_head patched_hentry;
+	struct llist_head real_hentry;
+	struct llist_head remote_hentry;
+
 	struct bsc_connection *bsc;
 	struct bsc_msc_connection *msc_con;
 
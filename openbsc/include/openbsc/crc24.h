@@ -5,6 +5,9 @@
 
 #define INIT_CRC24	0xffffff
 
+/* slicing-by-8 implementation used by the LLC layer */
 uint32_t crc24_calc(uint32_t fcs, uint8_t *cp, unsigned int len);
+/* byte-at-a-time reference implementation */
+uint32_t crc24_calc_bytewise(uint32_t fcs, uint8_t *cp, unsigned int len);
 
 #endif
@@ -53,6 +53,10 @@ int db_get_authinfo_for_subscr(struct gsm_auth_info *ainfo,
                                struct gsm_subscriber *subscr);
 int db_sync_authinfo_for_subscr(struct gsm_auth_info *ainfo,
                                 struct gsm_subscriber *subscr);
+#define DB_AUTHINFO_BATCH	64
+int db_get_authinfo_for_subscr_ids(struct gsm_auth_info *ainfo,
+				   const unsigned long long *ids,
+				   unsigned int num);
 int db_get_lastauthtuple_for_subscr(struct gsm_auth_tuple *atuple,
                                     struct gsm_subscriber *subscr);
 int db_sync_lastauthtuple_for_subscr(struct gsm_auth_tuple *atuple,
@@ -64,8 +68,16 @@ struct gsm_sms *db_sms_get(struct gsm_network *net, unsigned long long id);
 struct gsm_sms *db_sms_get_unsent(struct gsm_network *net, unsigned long long min_id);
 struct gsm_sms *db_sms_get_unsent_by_subscr(struct gsm_network *net, unsigned long long min_subscr_id, unsigned int failed);
 struct gsm_sms *db_sms_get_unsent_for_subscr(struct gsm_subscriber *subscr);
+struct gsm_sms *db_sms_get_unsent_by_id(struct gsm_network *net, unsigned long long id, unsigned int failed);
+int db_sms_for_each_unsent(unsigned long long min_id, unsigned int failed,
+			   int (*cb)(unsigned long long sms_id,
+				     unsigned long long receiver_id,
+				     int attached, void *data),
+			   void *data);
+/* state changes are written behind, db_sms_flush() writes them now */
 int db_sms_mark_sent(struct gsm_sms *sms);
 int db_sms_inc_deliver_attempts(struct gsm_sms *sms);
+int db_sms_flush(void);
 
 /* APDU blob storage */
 int db_apdu_blob_store(struct gsm_subscriber *subscr, 
@@ -77,5 +89,7 @@ struct osmo_counter;
 int db_store_counter(struct osmo_counter *ctr);
 struct rate_ctr_group;
 int db_store_rate_ctr_group(struct rate_ctr_group *ctrg);
+int db_store_counters(void);
+int db_prune_counters(unsigned int days);
 
 #endif /* _DB_H */
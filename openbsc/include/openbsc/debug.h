@@ -62,6 +62,8 @@ void log_set_nsvc_filter(struct log_target *target,
 void log_set_bvc_filter(struct log_target *target,
 			struct bssgp_bvc_ctx *bctx);
 
+int log_level_enabled(int subsys, unsigned int level);
+
 extern const struct log_info log_info;
 
 #endif /* _DEBUG_H */
@@ -155,19 +155,29 @@ int bssgp_tx_status(uint8_t cause, uint16_t *bvci, struct msgb *orig_msg);
 
 /* gprs_bssgp.c */
 
+/* PDUs a flow control instance queues before it starts dropping */
+#define BSSGP_FC_MS_QUEUE_DEPTH		64
+#define BSSGP_FC_BVC_QUEUE_DEPTH	1024
+
+struct bssgp_fc_queue_element;
+
 /* According to Section 8.2 */
 struct bssgp_flow_control {
 	uint32_t bucket_size_max;
 	uint32_t bucket_leak_rate;
 
 	uint32_t bucket_counter;
-	struct timeval time_last_pdu;
+	/* CLOCK_MONOTONIC time of the last PDU in microseconds */
+	uint64_t time_last_pdu;
 
-	/* the built-in queue */
+	/* the built-in queue, a ring of max_queue_depth elements */
 	uint32_t max_queue_depth;
 	uint32_t queue_depth;
-	struct llist_head queue;
-	struct osmo_timer_list timer;
+	uint32_t queue_head;
+	struct bssgp_fc_queue_element *queue;
+	/* entry in the flow control timer wheel and its tick */
+	struct llist_head wheel_list;
+	uint64_t wheel_expire;
 	/* callback to be called at output of flow control */
 	int (*out_cb)(struct bssgp_flow_control *fc, struct msgb *msg,
 			uint32_t llc_pdu_len, void *priv);
@@ -178,6 +188,9 @@ struct bssgp_flow_control {
 /* The per-BTS context that we keep on the SGSN side of the BSSGP link */
 struct bssgp_bvc_ctx {
 	struct llist_head list;
+	/* chains of the (BVCI, NSEI) and (RA ID, Cell ID) hash tables */
+	struct bssgp_bvc_ctx *bvci_hnext;
+	struct bssgp_bvc_ctx *cell_hnext;
 
 	/* parsed RA ID and Cell ID of the remote BTS */
 	struct gprs_ra_id ra_id;
@@ -256,6 +269,17 @@ int gprs_bssgp_tx_paging(uint16_t nsei, uint16_t ns_bvci,
 int bssgp_fc_in(struct bssgp_flow_control *fc, struct msgb *msg,
 		uint32_t llc_pdu_len, void *priv);
 
+/* Initialize a flow control instance, the bucket parameters may still
+ * be updated later */
+void bssgp_fc_init(struct bssgp_flow_control *fc,
+		   uint32_t bucket_size_max, uint32_t bucket_leak_rate,
+		   uint32_t max_queue_depth,
+		   int (*out_cb)(struct bssgp_flow_control *fc, struct msgb *msg,
+				 uint32_t llc_pdu_len, void *priv));
+
+/* Drop all queued PDUs and stop the flow control instance */
+void bssgp_fc_flush(struct bssgp_flow_control *fc);
+
 /* Initialize the Flow Control parameters for a new MS according to
  * default values for the BVC specified by BVCI and NSEI */
 int bssgp_fc_ms_init(struct bssgp_flow_control *fc_ms, uint16_t bvci,
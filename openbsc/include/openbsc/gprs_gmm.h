@@ -15,5 +15,6 @@ int gsm0408_gprs_rcvmsg(struct msgb *msg, struct gprs_llc_llme *llme);
 int gprs_gmm_rx_suspend(struct gprs_ra_id *raid, uint32_t tlli);
 int gprs_gmm_rx_resume(struct gprs_ra_id *raid, uint32_t tlli,
 		       uint8_t suspend_ref);
+void gprs_gmm_mmctx_resume(struct sgsn_mm_ctx *mmctx);
 
 #endif /* _GPRS_GMM_H */
@@ -120,6 +120,9 @@ struct gprs_llc_lle {
 	unsigned int retrans_ctr;
 
 	struct gprs_llc_params params;
+
+	/* Keystream precomputed for the next UI frame, if enabled */
+	struct gprs_llc_ks_cache *ks_cache;
 };
 
 #define NUM_SAPIS	16
@@ -2,6 +2,7 @@
 #define _GPRS_NS_H
 
 #include <stdint.h>
+#include <limits.h>
 
 /* GPRS Networks Service (NS) messages on the Gb interface
  * 3GPP TS 08.16 version 8.0.1 Release 1999 / ETSI TS 101 299 V8.0.1 (2002-05)
@@ -114,6 +115,11 @@ enum gprs_ns_evt {
 	GPRS_NS_EVT_UNIT_DATA,
 };
 
+#define NS_RX_BATCH	16	/* NS-over-IP PDUs read per syscall */
+#define NS_TX_BATCH	16	/* NS-over-IP PDUs written per syscall */
+#define NS_TX_QUEUE_MAX	1024	/* NS-over-IP PDUs queued per NS-VC */
+#define NS_HASH_SIZE	256	/* buckets of the NS-VC lookup tables */
+
 struct gprs_nsvc;
 typedef int gprs_ns_cb_t(enum gprs_ns_evt event, struct gprs_nsvc *nsvc,
 			 struct msgb *msg, uint16_t bvci);
@@ -125,6 +131,10 @@ struct gprs_ns_inst {
 
 	/* linked lists of all NSVC in this instance */
 	struct llist_head gprs_nsvcs;
+	/* the same NSVCs hashed by NSVCI, NSEI and remote address */
+	struct llist_head nsvci_hash[NS_HASH_SIZE];
+	struct llist_head nsei_hash[NS_HASH_SIZE];
+	struct llist_head addr_hash[NS_HASH_SIZE];
 
 	/* a NSVC object that's needed to deal with packets for unknown NSVC */
 	struct gprs_nsvc *unknown_nsvc;
@@ -136,6 +146,10 @@ struct gprs_ns_inst {
 		struct osmo_fd fd;
 		uint32_t local_ip;
 		uint16_t local_port;
+		/* NS-VCs with a non-empty transmit queue */
+		struct llist_head tx_pending;
+		/* receive buffers for the next batch read */
+		struct msgb *rx_msg[NS_RX_BATCH];
 	} nsip;
 	/* NS-over-FR-over-GRE-over-IP specific bits */
 	struct {
@@ -157,6 +171,11 @@ struct gprs_nsvc {
 	struct llist_head list;
 	struct gprs_ns_inst *nsi;
 
+	/* entries in the hash tables of the nsi, see nsvc_rehash() */
+	struct llist_head nsvci_hentry;
+	struct llist_head nsei_hentry;
+	struct llist_head addr_hentry;
+
 	uint16_t nsei;		/* end-to-end significance */
 	uint16_t nsvci;	/* uniquely identifies NS-VC at SGSN */
 
@@ -183,6 +202,12 @@ struct gprs_nsvc {
 			struct sockaddr_in bts_addr;
 		} frgre;
 	};
+
+	/* NS-over-IP PDUs waiting for the socket to become writable */
+	struct llist_head tx_queue;
+	unsigned int tx_queue_len;
+	/* entry in nsi->nsip.tx_pending */
+	struct llist_head tx_list;
 };
 
 /* Create a new NS protocol instance */
@@ -215,6 +240,8 @@ struct gprs_nsvc *nsvc_create(struct gprs_ns_inst *nsi, uint16_t nsvci);
 void nsvc_delete(struct gprs_nsvc *nsvc);
 struct gprs_nsvc *nsvc_by_nsei(struct gprs_ns_inst *nsi, uint16_t nsei);
 struct gprs_nsvc *nsvc_by_nsvci(struct gprs_ns_inst *nsi, uint16_t nsvci);
+/* Call after changing the NSEI, NSVCI or remote address of a NSVC */
+void nsvc_rehash(struct gprs_nsvc *nsvc);
 
 /* Initiate a RESET procedure (including timer start, ...)*/
 void gprs_nsvc_reset(struct gprs_nsvc *nsvc, uint8_t cause);
@@ -229,4 +256,10 @@ static inline struct msgb *gprs_ns_msgb_alloc(void)
 	return msgb_alloc_headroom(NS_ALLOC_SIZE, NS_ALLOC_HEADROOM, "GPRS/NS");
 }
 
+/* Returned by the GPRS_NS_EVT_UNIT_DATA callback if it took over the msgb,
+ * e.g. to send it on unmodified. gprs_ns_rcvmsg() returns it to its caller,
+ * which must not free the msgb then. No send path returns a value this
+ * large, and msgb->cb has no room left for a flag on 32bit. */
+#define GPRS_NS_RX_KEPT		INT_MAX
+
 #endif
@@ -43,6 +43,9 @@ enum gprs_pdp_ctx {
 	PDP_CTR_PKTS_UDATA_OUT,
 	PDP_CTR_BYTES_UDATA_IN,
 	PDP_CTR_BYTES_UDATA_OUT,
+	PDP_CTR_DL_QUEUED,
+	PDP_CTR_DL_QUEUE_FULL,
+	PDP_CTR_DL_QUEUE_EXPIRED,
 };
 
 enum gprs_t3350_mode {
@@ -111,6 +114,9 @@ struct sgsn_mm_ctx {
 	uint8_t			t3370_id_type;
 
 	struct bssgp_flow_control fc;
+
+	/* expiry of the downlink N-PDUs queued while paging */
+	struct osmo_timer_list	dl_queue_timer;
 };
 
 /* look-up a SGSN MM context based on TLLI + RAI */
@@ -123,6 +129,10 @@ struct sgsn_mm_ctx *sgsn_mm_ctx_by_imsi(const char *imsi);
 struct sgsn_mm_ctx *sgsn_mm_ctx_alloc(uint32_t tlli,
 					const struct gprs_ra_id *raid);
 void sgsn_mm_ctx_free(struct sgsn_mm_ctx *mm);
+/* pass all downlink N-PDUs queued during paging on to SNDCP */
+void sgsn_mm_ctx_dl_flush(struct sgsn_mm_ctx *mm);
+/* drop them instead, e.g. on detach */
+void sgsn_mm_ctx_dl_discard(struct sgsn_mm_ctx *mm);
 
 
 enum pdp_ctx_state {
@@ -174,6 +184,10 @@ struct sgsn_pdp_ctx {
 	struct osmo_timer_list	timer;
 	unsigned int		T;		/* Txxxx number */
 	unsigned int		num_T_exp;	/* number of consecutive T expirations */
+
+	/* downlink N-PDUs held back while the MS is being paged */
+	struct llist_head	dl_queue;
+	unsigned int		dl_queue_len;
 };
 
 
@@ -187,6 +201,8 @@ struct sgsn_pdp_ctx *sgsn_pdp_ctx_by_tid(const struct sgsn_mm_ctx *mm,
 struct sgsn_pdp_ctx *sgsn_pdp_ctx_alloc(struct sgsn_mm_ctx *mm,
 					uint8_t nsapi);
 void sgsn_pdp_ctx_free(struct sgsn_pdp_ctx *pdp);
+/* hold back a downlink N-PDU until the MS answers the paging */
+int sgsn_pdp_dl_enqueue(struct sgsn_pdp_ctx *pdp, struct msgb *msg);
 
 
 struct sgsn_ggsn_ctx {
@@ -105,6 +105,7 @@ struct gsm_anchor_operation {
 
 /* Maximum number of neighbor cells whose average we track */
 #define MAX_NEIGH_MEAS		10
+#define BTS_NEIGH_HASH_SIZE	256
 /* Maximum size of the averaging window for neighbor cells */
 #define MAX_WIN_NEIGH_AVG	10
 
@@ -114,6 +115,9 @@ struct neigh_meas_proc {
 	uint8_t bsic;
 	uint8_t rxlev[MAX_WIN_NEIGH_AVG];
 	unsigned int rxlev_cnt;
+	/* running sum of rxlev and its value before each entry was added */
+	uint32_t rxlev_sum;
+	uint32_t rxlev_sum_before[MAX_WIN_NEIGH_AVG];
 	uint8_t last_seen_nr;
 };
 
@@ -254,6 +258,8 @@ struct gsm_network {
 
 	unsigned int num_bts;
 	struct llist_head bts_list;
+	/* the BTS by ARFCN of their C0 and BSIC, see gsm_bts_neighbor() */
+	struct llist_head bts_hash[BTS_NEIGH_HASH_SIZE];
 
 	/* timer values */
 	int T3101;
@@ -321,6 +327,8 @@ struct gsm_bts *gsm_bts_num(struct gsm_network *net, int num);
 /* Get reference to a neighbor cell on a given BCCH ARFCN */
 struct gsm_bts *gsm_bts_neighbor(const struct gsm_bts *bts,
 				 uint16_t arfcn, uint8_t bsic);
+/* update the lookup after the ARFCN of C0 or the BSIC changed */
+void gsm_bts_rehash(struct gsm_bts *bts);
 
 enum gsm_bts_type parse_btstype(const char *arg);
 const char *btstype2str(enum gsm_bts_type type);
@@ -365,6 +373,8 @@ const char *bts_gprs_mode_name(enum bts_gprs_mode mode);
 int gsm48_ra_id_by_bts(uint8_t *buf, struct gsm_bts *bts);
 void gprs_ra_id_by_bts(struct gprs_ra_id *raid, struct gsm_bts *bts);
 struct gsm_meas_rep *lchan_next_meas_rep(struct gsm_lchan *lchan);
+void lchan_commit_meas_rep(struct gsm_lchan *lchan);
+void lchan_reset_meas_rep(struct gsm_lchan *lchan);
 
 int gsm_btsmodel_set_feature(struct gsm_bts_model *model, enum gsm_bts_features feat);
 int gsm_bts_model_register(struct gsm_bts_model *model);
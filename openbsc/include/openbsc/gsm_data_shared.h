@@ -80,6 +80,7 @@ struct gsm_mncc;
 struct osmo_rtp_socket;
 struct rtp_socket;
 struct bsc_api;
+struct bsc_handover;
 
 /* Network Management State */
 struct gsm_nm_state {
@@ -207,13 +208,17 @@ struct gsm_lchan {
 	struct neigh_meas_proc neigh_meas[MAX_NEIGH_MEAS];
 
 	/* cache of last measurement reports on this lchan */
-	struct gsm_meas_rep meas_rep[6];
+	struct gsm_meas_rep meas_rep[MEAS_REP_NUM];
 	int meas_rep_idx;
+	struct gsm_meas_rep_sums meas_sums;
 
 	/* GSM Random Access data */
 	struct gsm48_req_ref *rqd_ref;
 
 	struct gsm_subscriber_connection *conn;
+
+	/* handover this lchan takes part in, as old or as new channel */
+	struct bsc_handover *ho;
 #else
 	struct lapdm_channel lapdm_ch;
 	struct llist_head dl_tch_queue;
@@ -313,6 +318,9 @@ struct gsm_bts_trx {
 	int nominal_power;		/* in dBm */
 	unsigned int max_power_red;	/* in actual dB */
 
+	/* hash of each SI type as last sent to this TRX, 0 if never sent */
+	uint32_t si_sent_hash[_MAX_SYSINFO_TYPE];
+
 	struct {
 		void *l1h;
 	} role_bts;
@@ -421,6 +429,25 @@ enum neigh_list_manual_mode {
 	NL_MODE_MANUAL_SI5SEP = 2, /* SI2 and SI5 have separate neighbor lists */
 };
 
+#define ABIS_NM_MAX_WINDOW	8
+/* seconds after which an unanswered OML message is given up */
+#define ABIS_NM_ACK_TIMEOUT	30
+
+/* An OML message that has been sent and still waits for its ACK/NACK */
+struct abis_nm_inflight {
+	struct gsm_bts *bts;
+	/* retires the entry if no ACK/NACK ever matches it */
+	struct osmo_timer_list timer;
+	/* sending order, the oldest entry has the lowest number */
+	unsigned int seq;
+	uint8_t in_use;
+	uint8_t msg_type;
+	uint8_t obj_class;
+	uint8_t obj_inst[3];
+	/* nothing else may be sent while this is outstanding */
+	uint8_t serialise;
+};
+
 /* One BTS */
 struct gsm_bts {
 	/* list header in net->bts_list */
@@ -546,8 +573,16 @@ struct gsm_bts {
 	/* Abis NM queue */
 	struct llist_head abis_queue;
 	int abis_nm_pend;
+	/* how many OML messages may wait for their ACK at the same time */
+	int abis_nm_window;
+	struct abis_nm_inflight abis_nm_inflight[ABIS_NM_MAX_WINDOW];
+	unsigned int abis_nm_seq;
 
 	struct gsm_network *network;
+	/* entry in network->bts_hash */
+	struct llist_head hash_list;
+	/* handover counters per target BTS, see handover_logic.c */
+	struct llist_head ho_stats;
 
 	/* should the channel allocator allocate channels from high TRX to TRX0,
 	 * rather than starting from TRX0 and go upwards? */
@@ -576,6 +611,9 @@ struct gsm_bts {
 
 	/* do we use static (user-defined) system information messages? (bitmask) */
 	uint32_t si_mode_static;
+	/* SI that need to be regenerated, see gsm_bts_si_changed() */
+	uint32_t si_dirty;
+	struct osmo_timer_list si_timer;
 #endif /* ROLE_BSC */
 	void *role;
 };
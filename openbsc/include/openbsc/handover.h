@@ -1,7 +1,25 @@
 #ifndef _HANDOVER_H
 #define _HANDOVER_H
 
+#include <osmocom/core/linuxlist.h>
+
 struct gsm_subscriber_connection;
+struct rate_ctr_group;
+
+enum bsc_ho_ctr {
+	BSC_HO_CTR_ATTEMPTED,
+	BSC_HO_CTR_NO_CHANNEL,
+	BSC_HO_CTR_TIMEOUT,
+	BSC_HO_CTR_COMPLETED,
+	BSC_HO_CTR_FAILED,
+};
+
+/* handover counters from one BTS to another, in bts->ho_stats */
+struct bsc_ho_stats {
+	struct llist_head list;
+	struct gsm_bts *target;
+	struct rate_ctr_group *ctrg;
+};
 
 /* Hand over the specified logical channel to the specified new BTS.
  * This is the main entry point for the actual handover algorithm,
@@ -71,6 +71,52 @@ enum meas_rep_field {
 	MEAS_REP_UL_RXQUAL_SUB,
 };
 
+#define MEAS_REP_NUM_FIELDS	8
+#define MEAS_REP_NUM		6
+/* values up to this are counted for meas_rep_n_out_of_m_be() */
+#define MEAS_REP_MAX_BE		7
+
+/*
+ * Running sums over the cached measurement reports of a lchan. For each
+ * slot we remember the sums before the report in it was added, so the
+ * sum over the last N reports is the current sum minus the one before
+ * the oldest of them.
+ */
+struct gsm_meas_rep_sums {
+	uint32_t sum[MEAS_REP_NUM_FIELDS];
+	uint32_t sum_before[MEAS_REP_NUM][MEAS_REP_NUM_FIELDS];
+	/* number of values >= x for x > 0, modulo 256 */
+	uint8_t ge[MEAS_REP_NUM_FIELDS][MEAS_REP_MAX_BE + 1];
+	uint8_t ge_before[MEAS_REP_NUM][MEAS_REP_NUM_FIELDS][MEAS_REP_MAX_BE + 1];
+	/* the last report has not been added yet */
+	int pending;
+};
+
+static inline int meas_rep_get_field(const struct gsm_meas_rep *rep,
+				     enum meas_rep_field field)
+{
+	switch (field) {
+	case MEAS_REP_DL_RXLEV_FULL:
+		return rep->dl.full.rx_lev;
+	case MEAS_REP_DL_RXLEV_SUB:
+		return rep->dl.sub.rx_lev;
+	case MEAS_REP_DL_RXQUAL_FULL:
+		return rep->dl.full.rx_qual;
+	case MEAS_REP_DL_RXQUAL_SUB:
+		return rep->dl.sub.rx_qual;
+	case MEAS_REP_UL_RXLEV_FULL:
+		return rep->ul.full.rx_lev;
+	case MEAS_REP_UL_RXLEV_SUB:
+		return rep->ul.sub.rx_lev;
+	case MEAS_REP_UL_RXQUAL_FULL:
+		return rep->ul.full.rx_qual;
+	case MEAS_REP_UL_RXQUAL_SUB:
+		return rep->ul.sub.rx_qual;
+	}
+
+	return 0;
+}
+
 /* obtain an average over the last 'num' fields in the meas reps */
 int get_meas_rep_avg(const struct gsm_lchan *lchan,
 		     enum meas_rep_field field, unsigned int num);
@@ -84,4 +130,9 @@ unsigned int calc_initial_idx(unsigned int array_size,
 			      unsigned int meas_rep_idx,
 			      unsigned int num_values);
 
+struct neigh_meas_proc;
+/* add a rxlev of a neighbor and average over the last 'window' ones */
+void neigh_meas_add(struct neigh_meas_proc *nmp, uint8_t rxlev);
+int neigh_meas_avg(const struct neigh_meas_proc *nmp, int window);
+
 #endif /* _MEAS_REP_H */
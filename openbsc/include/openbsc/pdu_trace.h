@@ -0,0 +1,42 @@
+#ifndef _PDU_TRACE_H
+#define _PDU_TRACE_H
+
+#include <stdint.h>
+
+/*
+ * A binary trace of the last signalling PDUs that is cheap enough to be
+ * always enabled. The PDUs are copied into a preallocated ring and can
+ * be written to a pcap file on demand.
+ */
+
+enum pdu_trace_proto {
+	PDU_TRACE_RSL,		/* A-bis RSL, written as GSMTAP */
+	PDU_TRACE_IPA,		/* IPA framed A/SCCP of the NAT */
+	PDU_TRACE_NS,		/* GPRS NS over IP */
+};
+
+enum pdu_trace_dir {
+	PDU_TRACE_RX,
+	PDU_TRACE_TX,
+};
+
+#define PDU_TRACE_DEF_ENTRIES	1024
+#define PDU_TRACE_DEF_SNAPLEN	256
+
+struct pdu_trace_stats {
+	unsigned int entries;
+	unsigned int snaplen;
+	unsigned int used;
+	unsigned long long recorded;
+};
+
+int pdu_trace_init(void *ctx, unsigned int entries, unsigned int snaplen);
+void pdu_trace_record(uint8_t proto, uint8_t dir, uint32_t entity,
+		      const uint8_t *data, unsigned int len);
+void pdu_trace_clear(void);
+void pdu_trace_get_stats(struct pdu_trace_stats *stats);
+int pdu_trace_write_pcap(const char *filename);
+
+int pdu_trace_vty_init(void);
+
+#endif
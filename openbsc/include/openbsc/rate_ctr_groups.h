@@ -0,0 +1,15 @@
+#ifndef _RATE_CTR_GROUPS_H
+#define _RATE_CTR_GROUPS_H
+
+struct rate_ctr_group;
+
+/*
+ * Walk all allocated rate_ctr_groups in the order they were allocated.
+ * The walk stops at the first callback returning non-zero and returns
+ * that value.
+ */
+int bsc_rate_ctr_for_each_group(int (*cb)(struct rate_ctr_group *ctrg,
+					  void *data),
+				void *data);
+
+#endif /* _RATE_CTR_GROUPS_H */
@@ -7,6 +7,13 @@
 #include <openbsc/gprs_ns.h>
 #include <openbsc/gprs_sgsn.h>
 
+/* Room reserved in front of a downlink N-PDU for the SNDCP (4), LLC (3),
+ * worst case BSSGP DL-UNITDATA (~90) and NS-UNITDATA (4) headers, so that
+ * none of the layers has to reallocate or copy */
+#define SGSN_DL_HEADROOM	128
+/* Room reserved after a downlink N-PDU for the LLC FCS */
+#define SGSN_DL_TAILROOM	3
+
 struct sgsn_config {
 	/* parsed from config file */
 
@@ -21,6 +28,13 @@ struct sgsn_config {
 	int remote_gtp1c_port;
 	int remote_gtp1u_port;
 
+	/* precompute the GEA keystream of the next LLC UI frame */
+	int llc_ks_precompute;
+
+	/* downlink buffering while a suspended MS is paged */
+	unsigned int dl_queue_max_pkts;
+	unsigned int dl_queue_expiry;
+
 	/* misc */
 	struct gprs_ns_inst *nsi;
 };
@@ -68,5 +82,8 @@ int sgsn_rx_sndcp_ud_ind(struct gprs_ra_id *ra_id, int32_t tlli, uint8_t nsapi,
 			 struct msgb *msg, uint32_t npdu_len, uint8_t *npdu);
 int sndcp_unitdata_req(struct msgb *msg, struct gprs_llc_lle *lle, uint8_t nsapi,
 			void *mmcontext);
+int sndcp_unitdata_req_buf(const uint8_t *npdu, unsigned int npdu_len,
+			   struct gprs_llc_lle *lle, uint8_t nsapi,
+			   struct sgsn_mm_ctx *mm);
 
 #endif
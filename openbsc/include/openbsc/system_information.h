@@ -4,7 +4,23 @@
 #include <osmocom/gsm/sysinfo.h>
 
 struct gsm_bts;
+struct gsm_bts_trx;
+
+/* SI types that depend on the respective parts of the configuration */
+#define SI_MASK(x)		(1 << SYSINFO_TYPE_##x)
+#define SI_MASK_RACH		(SI_MASK(1) | SI_MASK(2) | SI_MASK(3) | SI_MASK(4))
+#define SI_MASK_CELL_SEL	(SI_MASK(3) | SI_MASK(4))
+#define SI_MASK_NEIGH		(SI_MASK(2) | SI_MASK(5))
+#define SI_MASK_CELL_ID		(SI_MASK(3) | SI_MASK(4) | SI_MASK(6))
 
 int gsm_generate_si(struct gsm_bts *bts, enum osmo_sysinfo_type type);
 
+/* generate and send all SI to a TRX, e.g. when its RSL link came up */
+int gsm_bts_trx_set_system_infos(struct gsm_bts_trx *trx);
+/* regenerate the dirty SI and resend the ones whose content changed */
+int gsm_bts_set_system_infos(struct gsm_bts *bts);
+/* mark SI as dirty, they are sent with the next gsm_bts_set_system_infos()
+ * which is scheduled to run shortly, so bursts of changes go out at once */
+void gsm_bts_si_changed(struct gsm_bts *bts, uint32_t si_mask);
+
 #endif
@@ -57,11 +57,62 @@ static const uint32_t tbl_crc24[256] = {
 	0x00dafe19, 0x000c596f, 0x002cbb4e, 0x00fa1c38, 0x006d7f0c, 0x00bbd87a, 0x009b3a5b, 0x004d9d2d
 };
 
-#define INIT_CRC24	0xffffff
+/* Slicing-by-8 tables: tbl_crc24_s8[k][i] is the CRC contribution of byte
+ * value i followed by k zero bytes.  tbl_crc24_s8[0] equals tbl_crc24. */
+static uint32_t tbl_crc24_s8[8][256];
+static int tbl_crc24_s8_init;
 
-uint32_t crc24_calc(uint32_t fcs, uint8_t *cp, unsigned int len)
+static void crc24_init_s8(void)
+{
+	int i, k;
+
+	for (i = 0; i < 256; i++) {
+		uint32_t crc = tbl_crc24[i];
+		tbl_crc24_s8[0][i] = crc;
+		for (k = 1; k < 8; k++) {
+			crc = (crc >> 8) ^ tbl_crc24[crc & 0xff];
+			tbl_crc24_s8[k][i] = crc;
+		}
+	}
+	tbl_crc24_s8_init = 1;
+}
+
+/* read 32bit little endian, the compiler turns this into a plain load */
+static inline uint32_t load_le32(const uint8_t *cp)
+{
+	return cp[0] | (cp[1] << 8) | (cp[2] << 16) | ((uint32_t)cp[3] << 24);
+}
+
+/* reference implementation, one table lookup per byte */
+uint32_t crc24_calc_bytewise(uint32_t fcs, uint8_t *cp, unsigned int len)
 {
 	while (len--)
 		fcs = (fcs >> 8) ^ tbl_crc24[(fcs ^ *cp++) & 0xff];
 	return fcs;
 }
+
+uint32_t crc24_calc(uint32_t fcs, uint8_t *cp, unsigned int len)
+{
+	if (!tbl_crc24_s8_init)
+		crc24_init_s8();
+
+	/* process eight octets per iteration; the 24bit register is
+	 * folded into the first word, its upper byte stays zero */
+	while (len >= 8) {
+		uint32_t lo = fcs ^ load_le32(cp);
+		uint32_t hi = load_le32(cp + 4);
+
+		fcs = tbl_crc24_s8[7][lo & 0xff] ^
+		      tbl_crc24_s8[6][(lo >> 8) & 0xff] ^
+		      tbl_crc24_s8[5][(lo >> 16) & 0xff] ^
+		      tbl_crc24_s8[4][lo >> 24] ^
+		      tbl_crc24_s8[3][hi & 0xff] ^
+		      tbl_crc24_s8[2][(hi >> 8) & 0xff] ^
+		      tbl_crc24_s8[1][(hi >> 16) & 0xff] ^
+		      tbl_crc24_s8[0][hi >> 24];
+		cp += 8;
+		len -= 8;
+	}
+
+	return crc24_calc_bytewise(fcs, cp, len);
+}
@@ -41,6 +41,11 @@
 struct gbprox_peer {
 	struct llist_head list;
 
+	/* chains of the BVCI, NS-VC and LA hash tables */
+	struct gbprox_peer *bvci_hnext;
+	struct gbprox_peer *nsvc_hnext;
+	struct gbprox_peer *la_hnext;
+
 	/* NS-VC over which we send/receive data to this BVC */
 	struct gprs_nsvc *nsvc;
 
@@ -55,11 +60,39 @@ struct gbprox_peer {
 /* Linked list of all Gb peers (except SGSN) */
 static LLIST_HEAD(gbprox_bts_peers);
 
+/* The same peers hashed by PTP BVCI, NS-VC and Location Area. The LA
+ * is the first five bytes of the RA, so the LA table serves both the
+ * RAC and the LAC lookup. */
+#define PEER_HASH_SIZE	256
+
+static struct gbprox_peer *peer_bvci_hash[PEER_HASH_SIZE];
+static struct gbprox_peer *peer_nsvc_hash[PEER_HASH_SIZE];
+static struct gbprox_peer *peer_la_hash[PEER_HASH_SIZE];
+
+static inline unsigned int bvci_hash(uint16_t bvci)
+{
+	return (bvci ^ (bvci >> 8)) & (PEER_HASH_SIZE - 1);
+}
+
+static inline unsigned int nsvc_hash(const struct gprs_nsvc *nsvc)
+{
+	unsigned long val = (unsigned long) nsvc >> 4;
+
+	return (val ^ (val >> 8)) & (PEER_HASH_SIZE - 1);
+}
+
+static inline unsigned int la_hash(const uint8_t *la)
+{
+	return (la[2] ^ la[3] ^ (la[4] << 1)) & (PEER_HASH_SIZE - 1);
+}
+
 /* Find the gbprox_peer by its BVCI */
 static struct gbprox_peer *peer_by_bvci(uint16_t bvci)
 {
 	struct gbprox_peer *peer;
-	llist_for_each_entry(peer, &gbprox_bts_peers, list) {
+
+	for (peer = peer_bvci_hash[bvci_hash(bvci)]; peer;
+	     peer = peer->bvci_hnext) {
 		if (peer->bvci == bvci)
 			return peer;
 	}
@@ -69,7 +102,9 @@ static struct gbprox_peer *peer_by_bvci(uint16_t bvci)
 static struct gbprox_peer *peer_by_nsvc(struct gprs_nsvc *nsvc)
 {
 	struct gbprox_peer *peer;
-	llist_for_each_entry(peer, &gbprox_bts_peers, list) {
+
+	for (peer = peer_nsvc_hash[nsvc_hash(nsvc)]; peer;
+	     peer = peer->nsvc_hnext) {
 		if (peer->nsvc == nsvc)
 			return peer;
 	}
@@ -80,7 +115,8 @@ static struct gbprox_peer *peer_by_nsvc(struct gprs_nsvc *nsvc)
 static struct gbprox_peer *peer_by_rac(const uint8_t *ra)
 {
 	struct gbprox_peer *peer;
-	llist_for_each_entry(peer, &gbprox_bts_peers, list) {
+
+	for (peer = peer_la_hash[la_hash(ra)]; peer; peer = peer->la_hnext) {
 		if (!memcmp(peer->ra, ra, 6))
 			return peer;
 	}
@@ -91,29 +127,88 @@ static struct gbprox_peer *peer_by_rac(const uint8_t *ra)
 static struct gbprox_peer *peer_by_lac(const uint8_t *la)
 {
 	struct gbprox_peer *peer;
-	llist_for_each_entry(peer, &gbprox_bts_peers, list) {
+
+	for (peer = peer_la_hash[la_hash(la)]; peer; peer = peer->la_hnext) {
 		if (!memcmp(peer->ra, la, 5))
 			return peer;
 	}
 	return NULL;
 }
 
-static struct gbprox_peer *peer_alloc(uint16_t bvci)
+/* unlink a peer from the LA hash chain it currently is in */
+static void peer_la_unhash(struct gbprox_peer *peer)
+{
+	struct gbprox_peer **pp;
+
+	for (pp = &peer_la_hash[la_hash(peer->ra)]; *pp; pp = &(*pp)->la_hnext) {
+		if (*pp == peer) {
+			*pp = peer->la_hnext;
+			break;
+		}
+	}
+	peer->la_hnext = NULL;
+}
+
+static void peer_la_hash_add(struct gbprox_peer *peer)
+{
+	unsigned int key = la_hash(peer->ra);
+
+	peer->la_hnext = peer_la_hash[key];
+	peer_la_hash[key] = peer;
+}
+
+/* update the Routeing Area of a peer, keeping the LA index in sync */
+static void peer_set_ra(struct gbprox_peer *peer, const uint8_t *ra)
+{
+	peer_la_unhash(peer);
+	memcpy(peer->ra, ra, sizeof(peer->ra));
+	peer_la_hash_add(peer);
+}
+
+static struct gbprox_peer *peer_alloc(uint16_t bvci, struct gprs_nsvc *nsvc)
 {
 	struct gbprox_peer *peer;
+	unsigned int key;
 
 	peer = talloc_zero(tall_bsc_ctx, struct gbprox_peer);
 	if (!peer)
 		return NULL;
 
 	peer->bvci = bvci;
+	peer->nsvc = nsvc;
 	llist_add(&peer->list, &gbprox_bts_peers);
 
+	key = bvci_hash(bvci);
+	peer->bvci_hnext = peer_bvci_hash[key];
+	peer_bvci_hash[key] = peer;
+	key = nsvc_hash(nsvc);
+	peer->nsvc_hnext = peer_nsvc_hash[key];
+	peer_nsvc_hash[key] = peer;
+	peer_la_hash_add(peer);
+
 	return peer;
 }
 
 static void peer_free(struct gbprox_peer *peer)
 {
+	struct gbprox_peer **pp;
+
+	for (pp = &peer_bvci_hash[bvci_hash(peer->bvci)]; *pp;
+	     pp = &(*pp)->bvci_hnext) {
+		if (*pp == peer) {
+			*pp = peer->bvci_hnext;
+			break;
+		}
+	}
+	for (pp = &peer_nsvc_hash[nsvc_hash(peer->nsvc)]; *pp;
+	     pp = &(*pp)->nsvc_hnext) {
+		if (*pp == peer) {
+			*pp = peer->nsvc_hnext;
+			break;
+		}
+	}
+	peer_la_unhash(peer);
+
 	llist_del(&peer->list);
 	talloc_free(peer);
 }
@@ -166,13 +261,9 @@ static void strip_ns_hdr(struct msgb *msg)
 	msgb_pull(msg, strip_len);
 }
 
-/* feed a message down the NS-VC associated with the specified peer */
-static int gbprox_relay2sgsn(struct msgb *old_msg, uint16_t ns_bvci)
+/* feed a message down the NS-VC of the SGSN, msg is consumed */
+static int gbprox_tx2sgsn(struct msgb *msg, uint16_t ns_bvci)
 {
-	/* create a copy of the message so the old one can
-	 * be free()d safely when we return from gbprox_rcvmsg() */
-	struct msgb *msg = msgb_copy(old_msg, "msgb_relay2sgsn");
-
 	DEBUGP(DGPRS, "NSEI=%u proxying BTS->SGSN (NS_BVCI=%u, NSEI=%u)\n",
 		msgb_nsei(msg), ns_bvci, gbcfg.nsip_sgsn_nsei);
 
@@ -184,14 +275,11 @@ static int gbprox_relay2sgsn(struct msgb *old_msg, uint16_t ns_bvci)
 	return gprs_ns_sendmsg(bssgp_nsi, msg);
 }
 
-/* feed a message down the NS-VC associated with the specified peer */
-static int gbprox_relay2peer(struct msgb *old_msg, struct gbprox_peer *peer,
+/* feed a message down the NS-VC associated with the specified peer,
+ * msg is consumed */
+static int gbprox_tx2peer(struct msgb *msg, struct gbprox_peer *peer,
 			  uint16_t ns_bvci)
 {
-	/* create a copy of the message so the old one can
-	 * be free()d safely when we return from gbprox_rcvmsg() */
-	struct msgb *msg = msgb_copy(old_msg, "msgb_relay2peer");
-
 	DEBUGP(DGPRS, "NSEI=%u proxying SGSN->BSS (NS_BVCI=%u, NSEI=%u)\n",
 		msgb_nsei(msg), ns_bvci, peer->nsvc->nsei);
 
@@ -204,6 +292,34 @@ static int gbprox_relay2peer(struct msgb *old_msg, struct gbprox_peer *peer,
 	return gprs_ns_sendmsg(bssgp_nsi, msg);
 }
 
+/* feed a copy of a message down the NS-VC of the SGSN */
+static int gbprox_relay2sgsn(struct msgb *old_msg, uint16_t ns_bvci)
+{
+	/* create a copy of the message so the old one can
+	 * be free()d safely when we return from gbprox_rcvmsg() */
+	struct msgb *msg = msgb_copy(old_msg, "msgb_relay2sgsn");
+
+	if (!msg)
+		return -ENOMEM;
+
+	return gbprox_tx2sgsn(msg, ns_bvci);
+}
+
+/* feed a copy of a message down the NS-VC associated with the specified
+ * peer */
+static int gbprox_relay2peer(struct msgb *old_msg, struct gbprox_peer *peer,
+			  uint16_t ns_bvci)
+{
+	/* create a copy of the message so the old one can
+	 * be free()d safely when we return from gbprox_rcvmsg() */
+	struct msgb *msg = msgb_copy(old_msg, "msgb_relay2peer");
+
+	if (!msg)
+		return -ENOMEM;
+
+	return gbprox_tx2peer(msg, peer, ns_bvci);
+}
+
 static int block_unblock_peer(uint16_t ptp_bvci, uint8_t pdu_type)
 {
 	struct gbprox_peer *peer;
@@ -286,8 +402,7 @@ static int gbprox_rx_sig_from_bss(struct msgb *msg, struct gprs_nsvc *nsvc,
 		from_peer = peer_by_nsvc(nsvc);
 		if (!from_peer)
 			goto err_no_peer;
-		memcpy(from_peer->ra, TLVP_VAL(&tp, BSSGP_IE_ROUTEING_AREA),
-			sizeof(from_peer->ra));
+		peer_set_ra(from_peer, TLVP_VAL(&tp, BSSGP_IE_ROUTEING_AREA));
 		gsm48_parse_ra(&raid, from_peer->ra);
 		LOGP(DGPRS, LOGL_INFO, "NSEI=%u BSSGP SUSPEND/RESUME "
 			"RAC snooping: RAC %u-%u-%u-%u behind BVCI=%u, "
@@ -317,8 +432,7 @@ static int gbprox_rx_sig_from_bss(struct msgb *msg, struct gprs_nsvc *nsvc,
 				LOGP(DGPRS, LOGL_INFO, "Allocationg new peer for "
 				     "BVCI=%u via NSVCI=%u/NSEI=%u\n", bvci,
 				     nsvc->nsvci, nsvc->nsei);
-				from_peer = peer_alloc(bvci);
-				from_peer->nsvc = nsvc;
+				from_peer = peer_alloc(bvci, nsvc);
 			}
 			if (TLVP_PRESENT(&tp, BSSGP_IE_CELL_ID)) {
 				struct gprs_ra_id raid;
@@ -326,9 +440,8 @@ static int gbprox_rx_sig_from_bss(struct msgb *msg, struct gprs_nsvc *nsvc,
 				 * PDU, this means we can extend our local
 				 * state information about this particular cell
 				 * */
-				memcpy(from_peer->ra,
-					TLVP_VAL(&tp, BSSGP_IE_CELL_ID),
-					sizeof(from_peer->ra));
+				peer_set_ra(from_peer,
+					    TLVP_VAL(&tp, BSSGP_IE_CELL_ID));
 				gsm48_parse_ra(&raid, from_peer->ra);
 				LOGP(DGPRS, LOGL_INFO, "NSEI=%u/BVCI=%u "
 				     "Cell ID %u-%u-%u-%u\n", nsvc->nsei,
@@ -550,9 +663,12 @@ int gbprox_rcvmsg(struct msgb *msg, struct gprs_nsvc *nsvc, uint16_t ns_bvci)
 		else
 			rc = gbprox_rx_sig_from_bss(msg, nsvc, ns_bvci);
 	} else {
-		/* All other BVCI are PTP and thus can be simply forwarded */
+		/* All other BVCI are PTP and thus can be simply forwarded.
+		 * We are the last user of the msgb, so instead of copying it
+		 * we take it over from the NS layer and send it on. */
 		if (!nsvc->remote_end_is_sgsn) {
-			return gbprox_relay2sgsn(msg, ns_bvci);
+			gbprox_tx2sgsn(msg, ns_bvci);
+			return GPRS_NS_RX_KEPT;
 		}
 		/* else: SGSN -> BSS direction */
 		peer = peer_by_bvci(ns_bvci);
@@ -560,8 +676,7 @@ int gbprox_rcvmsg(struct msgb *msg, struct gprs_nsvc *nsvc, uint16_t ns_bvci)
 			LOGP(DGPRS, LOGL_INFO, "Allocationg new peer for "
 			     "BVCI=%u via NSVC=%u/NSEI=%u\n", ns_bvci,
 			     nsvc->nsvci, nsvc->nsei);
-			peer = peer_alloc(ns_bvci);
-			peer->nsvc = nsvc;
+			peer = peer_alloc(ns_bvci, nsvc);
 		}
 		if (peer->blocked) {
 			LOGP(DGPRS, LOGL_NOTICE, "Dropping PDU for "
@@ -569,7 +684,8 @@ int gbprox_rcvmsg(struct msgb *msg, struct gprs_nsvc *nsvc, uint16_t ns_bvci)
 			     ns_bvci, nsvc->nsvci, nsvc->nsei);
 			return bssgp_tx_status(BSSGP_CAUSE_BVCI_BLOCKED, NULL, msg);
 		}
-		rc = gbprox_relay2peer(msg, peer, ns_bvci);
+		gbprox_tx2peer(msg, peer, ns_bvci);
+		rc = GPRS_NS_RX_KEPT;
 	}
 
 	return rc;
@@ -43,6 +43,7 @@
 #include <openbsc/gprs_bssgp.h>
 #include <openbsc/vty.h>
 #include <openbsc/gb_proxy.h>
+#include <openbsc/pdu_trace.h>
 
 #include <osmocom/vty/command.h>
 #include <osmocom/vty/telnet_interface.h>
@@ -219,6 +220,8 @@ int main(int argc, char **argv)
 	vty_init(&vty_info);
 	logging_vty_add_cmds(&log_info);
 	gbproxy_vty_init();
+	pdu_trace_vty_init();
+	pdu_trace_init(tall_bsc_ctx, PDU_TRACE_DEF_ENTRIES, PDU_TRACE_DEF_SNAPLEN);
 
 	handle_options(argc, argv);
 
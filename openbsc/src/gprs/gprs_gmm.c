@@ -787,8 +787,9 @@ static int gsm48_rx_gmm_det_req(struct sgsn_mm_ctx *ctx, struct msgb *msg)
 		msgb_tlli(msg), get_value_string(gprs_det_t_mo_strs, detach_type),
 		power_off ? "Power-off" : "");
 
-	/* Mark MM state as deregistered */
+	/* Mark MM state as deregistered, nothing queued gets sent now */
 	ctx->mm_state = GMM_DEREGISTERED;
+	sgsn_mm_ctx_dl_discard(ctx);
 
 	/* delete all existing PDP contexts for this MS */
 	llist_for_each_entry_safe(pdp, pdp2, &ctx->pdp_list, list) {
@@ -1545,10 +1546,11 @@ int gsm0408_gprs_rcvmsg(struct msgb *msg, struct gprs_llc_llme *llme)
 	uint8_t pdisc = gh->proto_discr & 0x0f;
 	struct sgsn_mm_ctx *mmctx;
 	struct gprs_ra_id ra_id;
+	uint32_t tlli = msgb_tlli(msg);
 	int rc = -EINVAL;
 
 	bssgp_parse_cell_id(&ra_id, msgb_bcid(msg));
-	mmctx = sgsn_mm_ctx_by_tlli(msgb_tlli(msg), &ra_id);
+	mmctx = sgsn_mm_ctx_by_tlli(tlli, &ra_id);
 	if (mmctx) {
 		msgid2mmctx(mmctx, msg);
 		rate_ctr_inc(&mmctx->ctrg->ctr[GMM_CTR_PKTS_SIG_IN]);
@@ -1571,6 +1573,14 @@ int gsm0408_gprs_rcvmsg(struct msgb *msg, struct gprs_llc_llme *llme)
 		break;
 	}
 
+	/* Any uplink frame of a suspended MS answers our paging. Only
+	 * resume once the frame has been handled: a DETACH REQUEST has
+	 * left the suspended state and discarded the queue by now, and
+	 * the context may even be gone. */
+	mmctx = sgsn_mm_ctx_by_tlli(tlli, &ra_id);
+	if (mmctx && mmctx->mm_state == GMM_REGISTERED_SUSPENDED)
+		gprs_gmm_mmctx_resume(mmctx);
+
 	return rc;
 }
 
@@ -1618,6 +1628,13 @@ int gprs_gmm_rx_resume(struct gprs_ra_id *raid, uint32_t tlli,
 	}
 
 	/* Transition from SUSPENDED to NORMAL */
-	mmctx->mm_state = GMM_REGISTERED_NORMAL;
+	gprs_gmm_mmctx_resume(mmctx);
 	return 0;
 }
+
+/* Return to REGISTERED_NORMAL and send what was queued while suspended */
+void gprs_gmm_mmctx_resume(struct sgsn_mm_ctx *mmctx)
+{
+	mmctx->mm_state = GMM_REGISTERED_NORMAL;
+	sgsn_mm_ctx_dl_flush(mmctx);
+}
@@ -30,6 +30,7 @@
 #include <openbsc/gsm_data.h>
 #include <openbsc/debug.h>
 #include <openbsc/gprs_sgsn.h>
+#include <openbsc/sgsn.h>
 #include <openbsc/gprs_gmm.h>
 #include <openbsc/gprs_bssgp.h>
 #include <openbsc/gprs_llc.h>
@@ -108,6 +109,117 @@ static const struct gprs_llc_params llc_default_params[] = {
 LLIST_HEAD(gprs_llc_llmes);
 void *llc_tall_ctx;
 
+/* Keystream for the next downlink UI frame of a LLE, computed from a
+ * zero-timeout timer so that the work is done once the select loop has
+ * nothing else to do, and not while the frame is waiting to be sent */
+struct gprs_llc_ks_cache {
+	struct gprs_llc_lle *lle;
+	struct osmo_timer_list timer;
+
+	int valid;
+	uint16_t nu;
+	uint32_t oc;
+	uint16_t len;
+	uint8_t ks[GSM0464_CIPH_MAX_BLOCK];
+};
+
+/* XOR the keystream into the frame, one machine word at a time */
+static void llc_xor_keystream(uint8_t *data, const uint8_t *ks,
+			      unsigned int len)
+{
+	unsigned long d, k;
+
+	while (len >= sizeof(d)) {
+		memcpy(&d, data, sizeof(d));
+		memcpy(&k, ks, sizeof(k));
+		d ^= k;
+		memcpy(data, &d, sizeof(d));
+		data += sizeof(d);
+		ks += sizeof(d);
+		len -= sizeof(d);
+	}
+
+	while (len--)
+		*data++ ^= *ks++;
+}
+
+static void ks_cache_cb(void *data)
+{
+	struct gprs_llc_ks_cache *ksc = data;
+	struct gprs_llc_lle *lle = ksc->lle;
+	uint32_t iov_ui = 0; /* FIXME: randomly select for TLLI */
+	uint64_t kc = *(uint64_t *)&lle->llme->kc;
+	uint32_t iv;
+	uint16_t len;
+	int rc;
+
+	if (lle->llme->algo == GPRS_ALGO_GEA0)
+		return;
+
+	/* information field of N201-U octets plus FCS */
+	len = lle->params.n201_u + 3;
+	if (len > sizeof(ksc->ks))
+		len = sizeof(ksc->ks);
+
+	iv = gprs_cipher_gen_input_ui(iov_ui, lle->sapi, lle->vu_send,
+				      lle->oc_ui_send);
+	rc = gprs_cipher_run(ksc->ks, len, lle->llme->algo, kc, iv,
+			     GPRS_CIPH_SGSN2MS);
+	if (rc < 0)
+		return;
+
+	ksc->nu = lle->vu_send;
+	ksc->oc = lle->oc_ui_send;
+	ksc->len = len;
+	ksc->valid = 1;
+}
+
+/* schedule the keystream computation for the next N(U) of this LLE */
+static void ks_cache_schedule(struct gprs_llc_lle *lle)
+{
+	struct gprs_llc_ks_cache *ksc = lle->ks_cache;
+
+	if (!sgsn->cfg.llc_ks_precompute)
+		return;
+
+	if (!ksc) {
+		ksc = talloc_zero(lle->llme, struct gprs_llc_ks_cache);
+		if (!ksc)
+			return;
+		ksc->lle = lle;
+		ksc->timer.cb = ks_cache_cb;
+		ksc->timer.data = ksc;
+		lle->ks_cache = ksc;
+	}
+
+	ksc->valid = 0;
+	osmo_timer_schedule(&ksc->timer, 0, 0);
+}
+
+/* return the cached keystream if it was computed for this very frame */
+static uint8_t *ks_cache_get(struct gprs_llc_lle *lle, uint16_t nu,
+			     uint32_t oc, uint16_t len)
+{
+	struct gprs_llc_ks_cache *ksc = lle->ks_cache;
+
+	if (!ksc || !ksc->valid)
+		return NULL;
+	if (ksc->nu != nu || ksc->oc != oc || ksc->len < len)
+		return NULL;
+
+	ksc->valid = 0;
+	return ksc->ks;
+}
+
+static void ks_cache_invalidate(struct gprs_llc_lle *lle)
+{
+	if (!lle->ks_cache)
+		return;
+
+	osmo_timer_del(&lle->ks_cache->timer);
+	lle->ks_cache->valid = 0;
+}
+
 /* If the TLLI is foreign, return its local version */
 static inline uint32_t tlli_foreign2local(uint32_t tlli)
 {
@@ -172,6 +284,11 @@ static struct gprs_llc_llme *llme_alloc(uint32_t tlli)
 
 static void llme_free(struct gprs_llc_llme *llme)
 {
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(llme->lle); i++)
+		ks_cache_invalidate(&llme->lle[i]);
+
 	llist_del(&llme->list);
 	talloc_free(llme);
 }
@@ -394,27 +511,35 @@ int gprs_llc_tx_ui(struct msgb *msg, uint8_t sapi, int command,
 		uint32_t iov_ui = 0; /* FIXME: randomly select for TLLI */
 		uint16_t crypt_len = (fcs + 3) - (llch + 3);
 		uint8_t cipher_out[GSM0464_CIPH_MAX_BLOCK];
+		uint8_t *ks;
 		uint32_t iv;
-		int rc, i;
+		int rc;
 		uint64_t kc = *(uint64_t *)&lle->llme->kc;
 
-		/* Compute the 'Input' Paraemeter */
-		iv = gprs_cipher_gen_input_ui(iov_ui, sapi, nu, oc);
-
-		/* Compute the keystream that we need to XOR with the data */
-		rc = gprs_cipher_run(cipher_out, crypt_len, lle->llme->algo,
-				     kc, iv, GPRS_CIPH_SGSN2MS);
-		if (rc < 0) {
-			LOGP(DLLC, LOGL_ERROR, "Error crypting UI frame: %d\n", rc);
-			return rc;
+		/* Use the keystream precomputed during idle time, if any */
+		ks = ks_cache_get(lle, nu, oc, crypt_len);
+		if (!ks) {
+			/* Compute the 'Input' Paraemeter */
+			iv = gprs_cipher_gen_input_ui(iov_ui, sapi, nu, oc);
+
+			/* Compute the keystream that we need to XOR with the data */
+			rc = gprs_cipher_run(cipher_out, crypt_len, lle->llme->algo,
+					     kc, iv, GPRS_CIPH_SGSN2MS);
+			if (rc < 0) {
+				LOGP(DLLC, LOGL_ERROR, "Error crypting UI frame: %d\n", rc);
+				return rc;
+			}
+			ks = cipher_out;
 		}
 
 		/* XOR the cipher output with the information field + FCS */
-		for (i = 0; i < crypt_len; i++)
-			*(llch + 3 + i) ^= cipher_out[i];
+		llc_xor_keystream(llch + 3, ks, crypt_len);
 
 		/* Mark frame as encrypted */
 		ctrl[1] |= 0x02;
+
+		/* Prepare the keystream for the next N(U) */
+		ks_cache_schedule(lle);
 	}
 
 	/* Identifiers passed down: (BVCI, NSEI) */
@@ -715,7 +840,7 @@ int gprs_llc_rcvmsg(struct msgb *msg, struct tlv_parsed *tv)
 		uint8_t cipher_out[GSM0464_CIPH_MAX_BLOCK];
 		uint32_t iv;
 		uint64_t kc = *(uint64_t *)&lle->llme->kc;
-		int rc, i;
+		int rc;
 
 		if (lle->llme->algo == GPRS_ALGO_GEA0) {
 			LOGP(DLLC, LOGL_NOTICE, "encrypted frame for LLC that "
@@ -734,8 +859,7 @@ int gprs_llc_rcvmsg(struct msgb *msg, struct tlv_parsed *tv)
 		}
 
 		/* XOR the cipher output with the information field + FCS */
-		for (i = 0; i < crypt_len; i++)
-			*(llhp.data + i) ^= cipher_out[i];
+		llc_xor_keystream(llhp.data, cipher_out, crypt_len);
 	} else {
 		if (lle->llme->algo != GPRS_ALGO_GEA0) {
 			LOGP(DLLC, LOGL_NOTICE, "unencrypted frame for LLC "
@@ -797,7 +921,9 @@ int gprs_llgmm_assign(struct gprs_llc_llme *llme,
 {
 	unsigned int i;
 
-	/* Update the crypto parameters */
+	/* Update the crypto parameters, cached keystreams are stale now */
+	for (i = 0; i < ARRAY_SIZE(llme->lle); i++)
+		ks_cache_invalidate(&llme->lle[i]);
 	llme->algo = alg;
 	if (alg != GPRS_ALGO_GEA0)
 		memcpy(llme->kc, kc, sizeof(llme->kc));
@@ -20,6 +20,7 @@
  */
 
 #include <stdint.h>
+#include <errno.h>
 
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/talloc.h>
@@ -67,6 +68,9 @@ static const struct rate_ctr_desc pdpctx_ctr_description[] = {
 	{ "udata.packets.out",	"User Data  Messages (Out)" },
 	{ "udata.bytes.in",	"User Data  Bytes    ( In)" },
 	{ "udata.bytes.out",	"User Data  Bytes    (Out)" },
+	{ "udata.queued",	"User Data  Queued (Paging)" },
+	{ "udata.queue_full",	"User Data  Queue Full     " },
+	{ "udata.queue_expired", "User Data  Queue Expired  " },
 };
 
 static const struct rate_ctr_group_desc pdpctx_ctrg_desc = {
@@ -151,6 +155,31 @@ struct sgsn_mm_ctx *sgsn_mm_ctx_by_imsi(const char *imsi)
 
 }
 
+static void dl_queue_purge(struct sgsn_pdp_ctx *pdp, int ctr)
+{
+	struct msgb *msg;
+
+	while ((msg = msgb_dequeue(&pdp->dl_queue))) {
+		pdp->dl_queue_len--;
+		if (ctr >= 0)
+			rate_ctr_inc(&pdp->ctrg->ctr[ctr]);
+		msgb_free(msg);
+	}
+}
+
+/* The MS did not answer the paging in time, drop what we have queued */
+static void dl_queue_timer_cb(void *_mm)
+{
+	struct sgsn_mm_ctx *mm = _mm;
+	struct sgsn_pdp_ctx *pdp;
+
+	LOGP(DGPRS, LOGL_NOTICE, "No paging response from TLLI %08x, "
+		"dropping queued downlink data\n", mm->tlli);
+
+	llist_for_each_entry(pdp, &mm->pdp_list, list)
+		dl_queue_purge(pdp, PDP_CTR_DL_QUEUE_EXPIRED);
+}
+
 /* Allocate a new SGSN MM context */
 struct sgsn_mm_ctx *sgsn_mm_ctx_alloc(uint32_t tlli,
 					const struct gprs_ra_id *raid)
@@ -166,7 +195,9 @@ struct sgsn_mm_ctx *sgsn_mm_ctx_alloc(uint32_t tlli,
 	ctx->mm_state = GMM_DEREGISTERED;
 	ctx->ctrg = rate_ctr_group_alloc(ctx, &mmctx_ctrg_desc, tlli);
 	INIT_LLIST_HEAD(&ctx->pdp_list);
-	ctx->fc.out_cb = &bssgp_fc_in;
+	bssgp_fc_init(&ctx->fc, 0, 0, BSSGP_FC_MS_QUEUE_DEPTH, &bssgp_fc_in);
+	ctx->dl_queue_timer.cb = dl_queue_timer_cb;
+	ctx->dl_queue_timer.data = ctx;
 
 	llist_add(&ctx->list, &sgsn_mm_ctxts);
 
@@ -180,6 +211,9 @@ void sgsn_mm_ctx_free(struct sgsn_mm_ctx *mm)
 	/* Unlink from global list of MM contexts */
 	llist_del(&mm->list);
 
+	osmo_timer_del(&mm->dl_queue_timer);
+	bssgp_fc_flush(&mm->fc);
+
 	/* Free all PDP contexts */
 	llist_for_each_entry_safe(pdp, pdp2, &mm->pdp_list, list)
 		sgsn_pdp_ctx_free(pdp);
@@ -189,6 +223,46 @@ void sgsn_mm_ctx_free(struct sgsn_mm_ctx *mm)
 	talloc_free(mm);
 }
 
+/* The MS went away, drop what was queued for it */
+void sgsn_mm_ctx_dl_discard(struct sgsn_mm_ctx *mm)
+{
+	struct sgsn_pdp_ctx *pdp;
+
+	osmo_timer_del(&mm->dl_queue_timer);
+
+	llist_for_each_entry(pdp, &mm->pdp_list, list)
+		dl_queue_purge(pdp, -1);
+}
+
+void sgsn_mm_ctx_dl_flush(struct sgsn_mm_ctx *mm)
+{
+	struct sgsn_pdp_ctx *pdp;
+	struct msgb *msg;
+
+	osmo_timer_del(&mm->dl_queue_timer);
+
+	llist_for_each_entry(pdp, &mm->pdp_list, list) {
+		while ((msg = msgb_dequeue(&pdp->dl_queue))) {
+			pdp->dl_queue_len--;
+
+			/* the MS may have changed TLLI or cell meanwhile */
+			msgb_tlli(msg) = mm->tlli;
+			msgb_bvci(msg) = mm->bvci;
+			msgb_nsei(msg) = mm->nsei;
+
+			rate_ctr_inc(&pdp->ctrg->ctr[PDP_CTR_PKTS_UDATA_OUT]);
+			rate_ctr_add(&pdp->ctrg->ctr[PDP_CTR_BYTES_UDATA_OUT],
+				     msg->len);
+			rate_ctr_inc(&mm->ctrg->ctr[GMM_CTR_PKTS_UDATA_OUT]);
+			rate_ctr_add(&mm->ctrg->ctr[GMM_CTR_BYTES_UDATA_OUT],
+				     msg->len);
+
+			sndcp_unitdata_req(msg, &mm->llme->lle[pdp->sapi],
+					   pdp->nsapi, mm);
+		}
+	}
+}
+
 /* look up PDP context by MM context and NSAPI */
 struct sgsn_pdp_ctx *sgsn_pdp_ctx_by_nsapi(const struct sgsn_mm_ctx *mm,
 					   uint8_t nsapi)
@@ -231,6 +305,7 @@ struct sgsn_pdp_ctx *sgsn_pdp_ctx_alloc(struct sgsn_mm_ctx *mm,
 	pdp->mm = mm;
 	pdp->nsapi = nsapi;
 	pdp->ctrg = rate_ctr_group_alloc(pdp, &pdpctx_ctrg_desc, nsapi);
+	INIT_LLIST_HEAD(&pdp->dl_queue);
 	llist_add(&pdp->list, &mm->pdp_list);
 	llist_add(&pdp->g_list, &sgsn_pdp_ctxts);
 
@@ -239,12 +314,37 @@ struct sgsn_pdp_ctx *sgsn_pdp_ctx_alloc(struct sgsn_mm_ctx *mm,
 
 void sgsn_pdp_ctx_free(struct sgsn_pdp_ctx *pdp)
 {
+	dl_queue_purge(pdp, -1);
 	rate_ctr_group_free(pdp->ctrg);
 	llist_del(&pdp->list);
 	llist_del(&pdp->g_list);
 	talloc_free(pdp);
 }
 
+int sgsn_pdp_dl_enqueue(struct sgsn_pdp_ctx *pdp, struct msgb *msg)
+{
+	struct sgsn_mm_ctx *mm = pdp->mm;
+
+	if (pdp->dl_queue_len >= sgsn->cfg.dl_queue_max_pkts) {
+		LOGP(DGPRS, LOGL_INFO, "Downlink queue of TLLI %08x NSAPI %u "
+			"full, dropping N-PDU\n", mm->tlli, pdp->nsapi);
+		rate_ctr_inc(&pdp->ctrg->ctr[PDP_CTR_DL_QUEUE_FULL]);
+		msgb_free(msg);
+		return -ENOSPC;
+	}
+
+	msgb_enqueue(&pdp->dl_queue, msg);
+	pdp->dl_queue_len++;
+	rate_ctr_inc(&pdp->ctrg->ctr[PDP_CTR_DL_QUEUED]);
+
+	/* the first queued N-PDU starts the wait for the paging response */
+	if (!osmo_timer_pending(&mm->dl_queue_timer))
+		osmo_timer_schedule(&mm->dl_queue_timer,
+				    sgsn->cfg.dl_queue_expiry, 0);
+
+	return 0;
+}
+
 /* GGSN contexts */
 
 struct sgsn_ggsn_ctx *sgsn_ggsn_ctx_alloc(uint32_t id)
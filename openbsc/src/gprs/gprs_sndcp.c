@@ -337,13 +337,32 @@ int sndcp_sm_deactivate_ind(struct gprs_llc_lle *lle, uint8_t nsapi)
 /* Fragmenter state */
 struct sndcp_frag_state {
 	uint8_t frag_nr;
-	struct msgb *msg;	/* original message */
-	uint8_t *next_byte;	/* first byte of next fragment */
+	struct msgb *msg;	/* original message, NULL if not in a msgb */
+	const uint8_t *next_byte;	/* first byte of next fragment */
+	const uint8_t *end;	/* first byte after the N-PDU */
+
+	/* how lower layers route the fragments */
+	uint32_t tlli;
+	uint16_t bvci;
+	uint16_t nsei;
 
 	struct gprs_sndcp_entity *sne;
 	void *mmcontext;
 };
 
+/* maximum SN-PDU payload that fits into a single LLC UI frame */
+static unsigned int sndcp_max_payload(struct gprs_llc_lle *lle, int first)
+{
+	unsigned int len = lle->params.n201_u -
+		(sizeof(struct sndcp_common_hdr) +
+		 sizeof(struct sndcp_udata_hdr));
+
+	if (first)
+		len -= sizeof(struct sndcp_comp_hdr);
+
+	return len;
+}
+
 /* returns '1' if there are more fragments to send, '0' if none */
 static int sndcp_send_ud_frag(struct sndcp_frag_state *fs)
 {
@@ -358,15 +377,16 @@ static int sndcp_send_ud_frag(struct sndcp_frag_state *fs)
 	uint8_t *data;
 	int rc, more;
 
-	fmsg = msgb_alloc_headroom(fs->sne->lle->params.n201_u+256, 128,
+	fmsg = msgb_alloc_headroom(SGSN_DL_HEADROOM + lle->params.n201_u +
+				   SGSN_DL_TAILROOM, SGSN_DL_HEADROOM,
 				   "SNDCP Frag");
 	if (!fmsg)
 		return -ENOMEM;
 
 	/* make sure lower layers route the fragment like the original */
-	msgb_tlli(fmsg) = msgb_tlli(fs->msg);
-	msgb_bvci(fmsg) = msgb_bvci(fs->msg);
-	msgb_nsei(fmsg) = msgb_nsei(fs->msg);
+	msgb_tlli(fmsg) = fs->tlli;
+	msgb_bvci(fmsg) = fs->bvci;
+	msgb_nsei(fmsg) = fs->nsei;
 
 	/* prepend common SNDCP header */
 	sch = (struct sndcp_common_hdr *) msgb_put(fmsg, sizeof(*sch));
@@ -391,11 +411,9 @@ static int sndcp_send_ud_frag(struct sndcp_frag_state *fs)
 	suh->seg_nr = fs->frag_nr % 0xf;
 
 	/* calculate remaining length to be sent */
-	len = (fs->msg->data + fs->msg->len) - fs->next_byte;
+	len = fs->end - fs->next_byte;
 	/* how much payload can we actually send via LLC? */
-	max_payload_len = lle->params.n201_u - (sizeof(*sch) + sizeof(*suh));
-	if (sch->first)
-		max_payload_len -= sizeof(*scomph);
+	max_payload_len = sndcp_max_payload(lle, sch->first);
 	/* check if we're exceeding the max */
 	if (len > max_payload_len)
 		len = max_payload_len;
@@ -409,7 +427,7 @@ static int sndcp_send_ud_frag(struct sndcp_frag_state *fs)
 	fs->next_byte += len;
 
 	/* determine if we have more fragemnts to send */
-	if ((fs->msg->data + fs->msg->len) <= fs->next_byte)
+	if (fs->end <= fs->next_byte)
 		more = 0;
 	else
 		more = 1;
@@ -426,7 +444,8 @@ static int sndcp_send_ud_frag(struct sndcp_frag_state *fs)
 
 	if (!more) {
 		/* we've sent all fragments */
-		msgb_free(fs->msg);
+		if (fs->msg)
+			msgb_free(fs->msg);
 		memset(fs, 0, sizeof(*fs));
 		/* increment NPDU number for next frame */
 		sne->tx_npdu_nr = (sne->tx_npdu_nr + 1) % 0xfff;
@@ -437,6 +456,16 @@ static int sndcp_send_ud_frag(struct sndcp_frag_state *fs)
 	return 1;
 }
 
+/* generate and send fragments until all of the N-PDU has been sent */
+static int sndcp_send_ud_frags(struct sndcp_frag_state *fs)
+{
+	while (1) {
+		int rc = sndcp_send_ud_frag(fs);
+		if (rc <= 0)
+			return rc;
+	}
+}
+
 /* Request transmission of a SN-PDU over specified LLC Entity + SAPI */
 int sndcp_unitdata_req(struct msgb *msg, struct gprs_llc_lle *lle, uint8_t nsapi,
 			void *mmcontext)
@@ -456,26 +485,19 @@ int sndcp_unitdata_req(struct msgb *msg, struct gprs_llc_lle *lle, uint8_t nsapi
 	}
 
 	/* Check if we need to fragment this N-PDU into multiple SN-PDUs */
-	if (msg->len > lle->params.n201_u - 
-			(sizeof(*sch) + sizeof(*suh) + sizeof(*scomph))) {
+	if (msg->len > sndcp_max_payload(lle, 1)) {
 		/* initialize the fragmenter state */
 		fs.msg = msg;
 		fs.frag_nr = 0;
 		fs.next_byte = msg->data;
+		fs.end = msg->data + msg->len;
+		fs.tlli = msgb_tlli(msg);
+		fs.bvci = msgb_bvci(msg);
+		fs.nsei = msgb_nsei(msg);
 		fs.sne = sne;
 		fs.mmcontext = mmcontext;
 
-		/* call function to generate and send fragments until all
-		 * of the N-PDU has been sent */
-		while (1) {
-			int rc = sndcp_send_ud_frag(&fs);
-			if (rc == 0)
-				return 0;
-			if (rc < 0)
-				return rc;
-		}
-		/* not reached */
-		return 0;
+		return sndcp_send_ud_frags(&fs);
 	}
 
 	/* this is the non-fragmenting case where we only build 1 SN-PDU */
@@ -500,6 +522,51 @@ int sndcp_unitdata_req(struct msgb *msg, struct gprs_llc_lle *lle, uint8_t nsapi
 	return gprs_llc_tx_ui(msg, lle->sapi, 0, mmcontext);
 }
 
+/* Request transmission of a N-PDU that is not yet in a msgb.  Each octet
+ * of the N-PDU is copied exactly once: either into a msgb that already
+ * has the headroom for all lower layer headers, or straight into the
+ * SN-PDU fragments. */
+int sndcp_unitdata_req_buf(const uint8_t *npdu, unsigned int npdu_len,
+			   struct gprs_llc_lle *lle, uint8_t nsapi,
+			   struct sgsn_mm_ctx *mm)
+{
+	struct gprs_sndcp_entity *sne;
+	struct sndcp_frag_state fs;
+	struct msgb *msg;
+
+	if (npdu_len <= sndcp_max_payload(lle, 1)) {
+		msg = msgb_alloc_headroom(SGSN_DL_HEADROOM + npdu_len +
+					  SGSN_DL_TAILROOM, SGSN_DL_HEADROOM,
+					  "GTP->SNDCP");
+		if (!msg)
+			return -ENOMEM;
+		memcpy(msgb_put(msg, npdu_len), npdu, npdu_len);
+		msgb_tlli(msg) = mm->tlli;
+		msgb_bvci(msg) = mm->bvci;
+		msgb_nsei(msg) = mm->nsei;
+
+		return sndcp_unitdata_req(msg, lle, nsapi, mm);
+	}
+
+	sne = gprs_sndcp_entity_by_lle(lle, nsapi);
+	if (!sne) {
+		LOGP(DSNDCP, LOGL_ERROR, "Cannot find SNDCP Entity\n");
+		return -EIO;
+	}
+
+	fs.msg = NULL;
+	fs.frag_nr = 0;
+	fs.next_byte = npdu;
+	fs.end = npdu + npdu_len;
+	fs.tlli = mm->tlli;
+	fs.bvci = mm->bvci;
+	fs.nsei = mm->nsei;
+	fs.sne = sne;
+	fs.mmcontext = mm;
+
+	return sndcp_send_ud_frags(&fs);
+}
+
 /* Section 5.1.2.17 LL-UNITDATA.ind */
 int sndcp_llunitdata_ind(struct msgb *msg, struct gprs_llc_lle *lle,
 			 uint8_t *hdr, uint16_t len)
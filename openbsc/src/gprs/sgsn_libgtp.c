@@ -427,35 +427,39 @@ static int cb_data_ind(struct pdp_t *lib, void *packet, unsigned int len)
 	}
 	mm = pdp->mm;
 
-	msg = msgb_alloc_headroom(len+256, 128, "GTP->SNDCP");
-	ud = msgb_put(msg, len);
-	memcpy(ud, packet, len);
-
-	msgb_tlli(msg) = mm->tlli;
-	msgb_bvci(msg) = mm->bvci;
-	msgb_nsei(msg) = mm->nsei;
-
 	switch (mm->mm_state) {
 	case GMM_REGISTERED_SUSPENDED:
-		/* initiate PS PAGING procedure */
-		memset(&pinfo, 0, sizeof(pinfo));
-		pinfo.mode = BSSGP_PAGING_PS;
-		pinfo.scope = BSSGP_PAGING_BVCI;
-		pinfo.bvci = mm->bvci;
-		pinfo.imsi = mm->imsi;
-		pinfo.ptmsi = &mm->p_tmsi;
-		pinfo.drx_params = mm->drx_parms;
-		pinfo.qos[0] = 0; // FIXME
-		rc = gprs_bssgp_tx_paging(mm->nsei, 0, &pinfo);
-		rate_ctr_inc(&mm->ctrg->ctr[GMM_CTR_PAGING_PS]);
-		/* FIXME: queue the packet we received from GTP */
+		/* only page once, further N-PDUs wait for the same response */
+		if (!osmo_timer_pending(&mm->dl_queue_timer)) {
+			/* initiate PS PAGING procedure */
+			memset(&pinfo, 0, sizeof(pinfo));
+			pinfo.mode = BSSGP_PAGING_PS;
+			pinfo.scope = BSSGP_PAGING_BVCI;
+			pinfo.bvci = mm->bvci;
+			pinfo.imsi = mm->imsi;
+			pinfo.ptmsi = &mm->p_tmsi;
+			pinfo.drx_params = mm->drx_parms;
+			pinfo.qos[0] = 0; // FIXME
+			rc = gprs_bssgp_tx_paging(mm->nsei, 0, &pinfo);
+			rate_ctr_inc(&mm->ctrg->ctr[GMM_CTR_PAGING_PS]);
+		}
+		/* queue the packet until the MS responds or resumes */
+		if (sgsn->cfg.dl_queue_max_pkts) {
+			msg = msgb_alloc_headroom(SGSN_DL_HEADROOM + len +
+						  SGSN_DL_TAILROOM,
+						  SGSN_DL_HEADROOM, "GTP->SNDCP");
+			if (!msg)
+				return -ENOMEM;
+			ud = msgb_put(msg, len);
+			memcpy(ud, packet, len);
+			return sgsn_pdp_dl_enqueue(pdp, msg);
+		}
 		break;
 	case GMM_REGISTERED_NORMAL:
 		break;
 	default:
 		LOGP(DGPRS, LOGL_ERROR, "GTP DATA IND for TLLI %08X in state "
 			"%u\n", mm->tlli, mm->mm_state);
-		msgb_free(msg);
 		return -1;
 	}
 
@@ -464,8 +468,9 @@ static int cb_data_ind(struct pdp_t *lib, void *packet, unsigned int len)
 	rate_ctr_inc(&mm->ctrg->ctr[GMM_CTR_PKTS_UDATA_OUT]);
 	rate_ctr_add(&mm->ctrg->ctr[GMM_CTR_BYTES_UDATA_OUT], len);
 
-	return sndcp_unitdata_req(msg, &mm->llme->lle[pdp->sapi],
-				  pdp->nsapi, mm);
+	/* build the SN-PDU(s) straight from the libgtp receive buffer */
+	return sndcp_unitdata_req_buf(packet, len, &mm->llme->lle[pdp->sapi],
+				      pdp->nsapi, mm);
 }
 
 /* Called by SNDCP when it has received/re-assembled a N-PDU */
@@ -482,6 +487,9 @@ int sgsn_rx_sndcp_ud_ind(struct gprs_ra_id *ra_id, int32_t tlli, uint8_t nsapi,
 			"Cannot find MM CTX for TLLI %08x\n", tlli);
 		return -EIO;
 	}
+	/* any uplink frame of a suspended MS answers our paging */
+	if (mmctx->mm_state == GMM_REGISTERED_SUSPENDED)
+		gprs_gmm_mmctx_resume(mmctx);
 	/* look-up the PDP context for this message */
 	pdp = sgsn_pdp_ctx_by_nsapi(mmctx, nsapi);
 	if (!pdp) {
@@ -49,6 +49,7 @@
 #include <openbsc/gprs_ns.h>
 #include <openbsc/gprs_bssgp.h>
 #include <openbsc/gprs_llc.h>
+#include <openbsc/pdu_trace.h>
 
 #include <gtp.h>
 
@@ -74,6 +75,8 @@ static struct sgsn_instance sgsn_inst = {
 	.config_file = "osmo_sgsn.cfg",
 	.cfg = {
 		.gtp_statedir = "./",
+		.dl_queue_max_pkts = 32,
+		.dl_queue_expiry = 30,
 	},
 };
 struct sgsn_instance *sgsn = &sgsn_inst;
@@ -219,6 +222,8 @@ int main(int argc, char **argv)
 	vty_init(&vty_info);
 	logging_vty_add_cmds(&log_info);
         sgsn_vty_init();
+	pdu_trace_vty_init();
+	pdu_trace_init(tall_bsc_ctx, PDU_TRACE_DEF_ENTRIES, PDU_TRACE_DEF_SNAPLEN);
 
 	handle_options(argc, argv);
 
@@ -134,6 +134,13 @@ static int config_write_sgsn(struct vty *vty)
 			gctx->gtp_version, VTY_NEWLINE);
 	}
 
+	if (g_cfg->llc_ks_precompute)
+		vty_out(vty, " llc keystream-precompute 1%s", VTY_NEWLINE);
+	vty_out(vty, " downlink-queue max-packets %u%s",
+		g_cfg->dl_queue_max_pkts, VTY_NEWLINE);
+	vty_out(vty, " downlink-queue expiry %u%s",
+		g_cfg->dl_queue_expiry, VTY_NEWLINE);
+
 	return CMD_SUCCESS;
 }
 
@@ -256,6 +263,42 @@ DEFUN(cfg_ggsn_gtp_version, cfg_ggsn_gtp_version_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_llc_ks_precompute, cfg_llc_ks_precompute_cmd,
+	"llc keystream-precompute (0|1)",
+	"LLC Parameters\n"
+	"Precompute the GEA keystream of the next UI frame during idle time\n"
+	"Compute the keystream when the frame is sent\n"
+	"Precompute the keystream\n")
+{
+	g_cfg->llc_ks_precompute = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+#define DL_QUEUE_STR	"Downlink buffering while a suspended MS is paged\n"
+
+DEFUN(cfg_dl_queue_max_pkts, cfg_dl_queue_max_pkts_cmd,
+	"downlink-queue max-packets <0-65535>",
+	DL_QUEUE_STR
+	"Maximum number of N-PDUs queued per PDP context\n"
+	"Number of N-PDUs, 0 disables the queue\n")
+{
+	g_cfg->dl_queue_max_pkts = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_dl_queue_expiry, cfg_dl_queue_expiry_cmd,
+	"downlink-queue expiry <1-3600>",
+	DL_QUEUE_STR
+	"Drop the queued N-PDUs if there is no paging response in time\n"
+	"Seconds\n")
+{
+	g_cfg->dl_queue_expiry = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
 #if 0
 DEFUN(cfg_apn_ggsn, cfg_apn_ggsn_cmd,
 	"apn APNAME ggsn <0-255>",
@@ -412,6 +455,9 @@ int sgsn_vty_init(void)
 	install_element(SGSN_NODE, &cfg_ggsn_remote_ip_cmd);
 	//install_element(SGSN_NODE, &cfg_ggsn_remote_port_cmd);
 	install_element(SGSN_NODE, &cfg_ggsn_gtp_version_cmd);
+	install_element(SGSN_NODE, &cfg_llc_ks_precompute_cmd);
+	install_element(SGSN_NODE, &cfg_dl_queue_max_pkts_cmd);
+	install_element(SGSN_NODE, &cfg_dl_queue_expiry_cmd);
 
 	return 0;
 }
@@ -31,6 +31,7 @@
 #include <sys/fcntl.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 
@@ -128,6 +129,11 @@ static int gprs_ns_cb(struct osmo_fd *bfd, unsigned int what);
 
 #define PROXY_ALLOC_SIZE	1200
 
+/* number of queued frames handed to the kernel in one go */
+#define PROXY_TX_BATCH		16
+
+static int ipc_queue_msg(struct ipa_proxy_conn *ipc, struct msgb *msg);
+
 static struct ipa_bts_conn *find_bts_by_unitid(struct ipa_proxy *ipp,
 						uint16_t site_id,
 						uint16_t bts_id)
@@ -196,6 +202,20 @@ static void _logp_ipbc_uid(unsigned int ss, unsigned int lvl, char *file, int li
 		logp2(ss, lvl, file, line, 0, "unknown ");
 }
 
+/*
+ * RSL injected over UDP selects the TRX by the IPA stream identifier,
+ * stream n carries the RSL of TRX n. On the TCP connection of the TRX
+ * it is sent with the regular RSL stream identifier.
+ */
+static struct ipa_proxy_conn *udp_rsl_conn(struct ipa_proxy_conn **rsl_conns,
+					   struct ipaccess_head *hh)
+{
+	unsigned int trx_nr = hh->proto - IPAC_PROTO_RSL;
+
+	hh->proto = IPAC_PROTO_RSL;
+	return rsl_conns[trx_nr];
+}
+
 static int handle_udp_read(struct osmo_fd *bfd)
 {
 	struct ipa_bts_conn *ipbc = bfd->data;
@@ -229,7 +249,8 @@ static int handle_udp_read(struct osmo_fd *bfd)
 	}
 	msgb_put(msg, ret);
 	msg->l2h = msg->data + sizeof(*hh);
-	DEBUGP(DLMI, "UDP RX: %s\n", osmo_hexdump(msg->data, msg->len));
+	if (log_level_enabled(DLMI, LOGL_DEBUG))
+		DEBUGP(DLMI, "UDP RX: %s\n", osmo_hexdump(msg->data, msg->len));
 
 	if (hh->len != msg->len - sizeof(*hh)) {
 		DEBUGP(DLINP, "length (%u/%u) disagrees with header(%u)\n",
@@ -241,11 +262,12 @@ static int handle_udp_read(struct osmo_fd *bfd)
 	switch (bfd->priv_nr & 0xff) {
 	case UDP_TO_BTS:
 		/* injection towards BTS */
-		switch (hh->proto) {
-		case IPAC_PROTO_RSL:
-			/* FIXME: what to do about TRX > 0 */
-			other_conn = ipbc->rsl_conn[0];
+		if (hh->proto < IPAC_PROTO_RSL + MAX_TRX) {
+			other_conn = udp_rsl_conn(ipbc->rsl_conn, hh);
 			break;
+		}
+
+		switch (hh->proto) {
 		default:
 			DEBUGP(DLINP, "Unknown protocol 0x%02x, sending to "
 				"OML FD\n", hh->proto);
@@ -258,11 +280,12 @@ static int handle_udp_read(struct osmo_fd *bfd)
 		break;
 	case UDP_TO_BSC:
 		/* injection towards BSC */
-		switch (hh->proto) {
-		case IPAC_PROTO_RSL:
-			/* FIXME: what to do about TRX > 0 */
-			other_conn = ipbc->bsc_rsl_conn[0];
+		if (hh->proto < IPAC_PROTO_RSL + MAX_TRX) {
+			other_conn = udp_rsl_conn(ipbc->bsc_rsl_conn, hh);
 			break;
+		}
+
+		switch (hh->proto) {
 		default:
 			DEBUGP(DLINP, "Unknown protocol 0x%02x, sending to "
 				"OML FD\n", hh->proto);
@@ -278,9 +301,8 @@ static int handle_udp_read(struct osmo_fd *bfd)
 	}
 
 	if (other_conn) {
-		/* enqueue the message for TX on the respective FD */
-		msgb_enqueue(&other_conn->tx_queue, msg);
-		other_conn->fd.when |= BSC_FD_WRITE;
+		/* send or enqueue the message for TX on the respective FD */
+		ipc_queue_msg(other_conn, msg);
 	} else
 		msgb_free(msg);
 
@@ -584,6 +606,9 @@ static struct ipa_proxy_conn *ipc_by_priv_nr(struct ipa_bts_conn *ipbc,
 	struct ipa_proxy_conn *bsc_conn;
 	unsigned int trx_id = priv_nr >> 8;
 
+	if (trx_id >= MAX_TRX)
+		return NULL;
+
 	switch (priv_nr & 0xff) {
 	case OML_FROM_BTS: /* incoming OML data from BTS, forward to BSC OML */
 		bsc_conn = ipbc->bsc_oml_conn;
@@ -787,8 +812,11 @@ static int handle_tcp_read(struct osmo_fd *bfd)
 	}
 
 	msgb_put(msg, ret);
-	logp_ipbc_uid(DLMI, LOGL_DEBUG, ipbc, bfd->priv_nr >> 8);
-	DEBUGPC(DLMI, "RX<-%s: %s\n", btsbsc, osmo_hexdump(msg->data, msg->len));
+	if (log_level_enabled(DLMI, LOGL_DEBUG)) {
+		logp_ipbc_uid(DLMI, LOGL_DEBUG, ipbc, bfd->priv_nr >> 8);
+		DEBUGPC(DLMI, "RX<-%s: %s\n", btsbsc,
+			osmo_hexdump(msg->data, msg->len));
+	}
 
 	hh = (struct ipaccess_head *) msg->data;
 	if (hh->proto == IPAC_PROTO_IPACCESS) {
@@ -819,10 +847,8 @@ static int handle_tcp_read(struct osmo_fd *bfd)
 	if (bsc_conn) {
 		if (gprs_ns_ipaddr)
 			patch_gprs_msg(ipbc, bfd->priv_nr, msg);
-		/* enqueue packet towards BSC */
-		msgb_enqueue(&bsc_conn->tx_queue, msg);
-		/* mark respective filedescriptor as 'we want to write' */
-		bsc_conn->fd.when |= BSC_FD_WRITE;
+		/* send or enqueue packet towards the other side */
+		ipc_queue_msg(bsc_conn, msg);
 	} else {
 		logp_ipbc_uid(DLINP, LOGL_INFO, ipbc, bfd->priv_nr >> 8);
 		LOGPC(DLINP, LOGL_INFO, "Dropping packet from %s, "
@@ -833,13 +859,90 @@ static int handle_tcp_read(struct osmo_fd *bfd)
 	return ret;
 }
 
+/*
+ * Hand as many queued frames as possible to the kernel with a single
+ * non-blocking sendmsg. Completely written frames are freed, a partially
+ * written one stays at the head of the queue with the written part
+ * pulled off. Returns the result of sendmsg.
+ */
+static int ipc_flush_tx_queue(struct ipa_proxy_conn *ipc)
+{
+	struct ipa_bts_conn *ipbc = ipc->bts_conn;
+	struct iovec iov[PROXY_TX_BATCH];
+	struct msghdr mh;
+	struct msgb *msg, *tmp;
+	int count = 0;
+	int ret, left;
+
+	llist_for_each_entry(msg, &ipc->tx_queue, list) {
+		iov[count].iov_base = msg->data;
+		iov[count].iov_len = msg->len;
+		if (++count == PROXY_TX_BATCH)
+			break;
+	}
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = count;
+
+	ret = sendmsg(ipc->fd.fd, &mh, MSG_DONTWAIT);
+	if (ret <= 0)
+		return ret;
+
+	left = ret;
+	llist_for_each_entry_safe(msg, tmp, &ipc->tx_queue, list) {
+		if (left < msg->len) {
+			msgb_pull(msg, left);
+			break;
+		}
+
+		if (log_level_enabled(DLMI, LOGL_DEBUG)) {
+			logp_ipbc_uid(DLMI, LOGL_DEBUG, ipbc, ipc->fd.priv_nr >> 8);
+			DEBUGPC(DLMI, "TX %04x: %s\n", ipc->fd.priv_nr,
+				osmo_hexdump(msg->data, msg->len));
+		}
+
+		left -= msg->len;
+		llist_del(&msg->list);
+		msgb_free(msg);
+		if (--count == 0)
+			break;
+	}
+
+	return ret;
+}
+
+/*
+ * Queue a frame towards a connection. If nothing is pending and the
+ * connection is established, write it through directly instead of
+ * waiting for the next write readiness of the select loop.
+ */
+static int ipc_queue_msg(struct ipa_proxy_conn *ipc, struct msgb *msg)
+{
+	int write_through;
+	int ret;
+
+	write_through = llist_empty(&ipc->tx_queue) &&
+			!(ipc->fd.when & BSC_FD_WRITE);
+	msgb_enqueue(&ipc->tx_queue, msg);
+
+	if (write_through) {
+		/* errors and dead sockets are handled in handle_tcp_write */
+		ret = ipc_flush_tx_queue(ipc);
+		if (ret > 0 && llist_empty(&ipc->tx_queue))
+			return 0;
+	}
+
+	/* mark respective filedescriptor as 'we want to write' */
+	ipc->fd.when |= BSC_FD_WRITE;
+	return 0;
+}
+
 /* a TCP socket is ready to be written to */
 static int handle_tcp_write(struct osmo_fd *bfd)
 {
 	struct ipa_proxy_conn *ipc = bfd->data;
 	struct ipa_bts_conn *ipbc = ipc->bts_conn;
-	struct llist_head *lh;
-	struct msgb *msg;
 	char *btsbsc;
 	int ret;
 
@@ -849,21 +952,22 @@ static int handle_tcp_write(struct osmo_fd *bfd)
 		btsbsc = "BSC";
 
 
-	/* get the next msg for this timeslot */
+	/* send the pending msgs for this timeslot */
 	if (llist_empty(&ipc->tx_queue)) {
 		bfd->when &= ~BSC_FD_WRITE;
 		return 0;
 	}
-	lh = ipc->tx_queue.next;
-	llist_del(lh);
-	msg = llist_entry(lh, struct msgb, list);
 
-	logp_ipbc_uid(DLMI, LOGL_DEBUG, ipbc, bfd->priv_nr >> 8);
-	DEBUGPC(DLMI, "TX %04x: %s\n", bfd->priv_nr,
-		osmo_hexdump(msg->data, msg->len));
+	ret = ipc_flush_tx_queue(ipc);
+	if (ret < 0) {
+		if (errno == EAGAIN)
+			return 0;
+		/* drop the frame that could not be sent */
+		msgb_free(msgb_dequeue(&ipc->tx_queue));
+	}
 
-	ret = send(bfd->fd, msg->data, msg->len, 0);
-	msgb_free(msg);
+	if (llist_empty(&ipc->tx_queue))
+		bfd->when &= ~BSC_FD_WRITE;
 
 	if (ret == 0) {
 		logp_ipbc_uid(DLINP, LOGL_NOTICE, ipbc, bfd->priv_nr >> 8);
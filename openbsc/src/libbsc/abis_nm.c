@@ -26,11 +26,13 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <libgen.h>
 #include <time.h>
 #include <limits.h>
 
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
@@ -126,15 +128,171 @@ int _abis_nm_sendmsg(struct msgb *msg)
 	return abis_sendmsg(msg);
 }
 
+/*
+ * Up to bts->abis_nm_window messages may wait for their ACK/NACK at the
+ * same time. The queue is still sent in order and stops at the first
+ * message that may not go out yet: one for an object that is waiting
+ * for an ACK, a software load or restart that has to wait until the BTS
+ * answered everything else, or anything behind such a message.
+ */
+static const enum abis_nm_msgtype nm_serialised[] = {
+	NM_MT_IPACC_RESTART,
+	NM_MT_BS11_RESTART,
+	NM_MT_BS11_RESET_RESOURCE,
+};
+
+static int nm_is_serialised(struct abis_om_hdr *oh)
+{
+	struct abis_om_fom_hdr *foh = (struct abis_om_fom_hdr *) oh->data;
+
+	if (oh->mdisc != ABIS_OM_MDISC_FOM)
+		return 1;
+
+	return is_in_arr(foh->msg_type, abis_nm_sw_load_msgs,
+			 ARRAY_SIZE(abis_nm_sw_load_msgs))
+		|| is_in_arr(foh->msg_type, nm_serialised,
+			     ARRAY_SIZE(nm_serialised));
+}
+
+/* manufacturer specific messages carry the FOM header after their id */
+static struct abis_om_fom_hdr *nm_foh(struct abis_om_hdr *oh)
+{
+	if (oh->mdisc == ABIS_OM_MDISC_MANUF)
+		return (struct abis_om_fom_hdr *) (oh->data + 1 + oh->data[0]);
+
+	return (struct abis_om_fom_hdr *) oh->data;
+}
+
+static int nm_inflight_match(struct abis_nm_inflight *in,
+			     struct abis_om_fom_hdr *foh)
+{
+	return in->obj_class == foh->obj_class
+		&& in->obj_inst[0] == foh->obj_inst.bts_nr
+		&& in->obj_inst[1] == foh->obj_inst.trx_nr
+		&& in->obj_inst[2] == foh->obj_inst.ts_nr;
+}
+
+static void nm_inflight_del(struct abis_nm_inflight *in)
+{
+	osmo_timer_del(&in->timer);
+	in->in_use = 0;
+	in->bts->abis_nm_pend -= 1;
+}
+
+static struct abis_nm_inflight *nm_inflight_oldest(struct gsm_bts *bts)
+{
+	struct abis_nm_inflight *oldest = NULL;
+	int i;
+
+	for (i = 0; i < ABIS_NM_MAX_WINDOW; i++) {
+		struct abis_nm_inflight *in = &bts->abis_nm_inflight[i];
+
+		if (!in->in_use)
+			continue;
+		if (!oldest || (int) (in->seq - oldest->seq) < 0)
+			oldest = in;
+	}
+
+	return oldest;
+}
+
+static void nm_queue_flush(struct gsm_bts *bts);
+
+static void nm_inflight_timeout(void *data)
+{
+	struct abis_nm_inflight *in = data;
+	struct gsm_bts *bts = in->bts;
+
+	LOGP(DNM, LOGL_ERROR, "BTS %u: no ACK/NACK for OML message 0x%02x "
+	     "to object %u/%u/%u/%u, sending the next one\n", bts->nr,
+	     in->msg_type, in->obj_class, in->obj_inst[0], in->obj_inst[1],
+	     in->obj_inst[2]);
+
+	nm_inflight_del(in);
+	nm_queue_flush(bts);
+}
+
+/* can this message be sent now? */
+static int nm_may_send(struct gsm_bts *bts, struct msgb *msg)
+{
+	struct abis_om_hdr *oh = (struct abis_om_hdr *) msg->data;
+	struct abis_om_fom_hdr *foh = nm_foh(oh);
+	int window = OSMO_MIN(bts->abis_nm_window, ABIS_NM_MAX_WINDOW);
+	int i;
+
+	if (bts->abis_nm_pend == 0)
+		return 1;
+	if (window <= 1 || nm_is_serialised(oh))
+		return 0;
+	if (OBSC_NM_W_ACK_CB(msg) && bts->abis_nm_pend >= window)
+		return 0;
+
+	for (i = 0; i < ABIS_NM_MAX_WINDOW; i++) {
+		struct abis_nm_inflight *in = &bts->abis_nm_inflight[i];
+
+		if (!in->in_use)
+			continue;
+		if (in->serialise || nm_inflight_match(in, foh))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int nm_send(struct gsm_bts *bts, struct msgb *msg)
+{
+	struct abis_om_hdr *oh = (struct abis_om_hdr *) msg->data;
+	struct abis_om_fom_hdr *foh = nm_foh(oh);
+	struct abis_nm_inflight *in;
+	int i;
+
+	if (OBSC_NM_W_ACK_CB(msg)) {
+		/* nm_may_send() made sure there is a free entry */
+		for (i = 0; i < ABIS_NM_MAX_WINDOW; i++) {
+			if (!bts->abis_nm_inflight[i].in_use)
+				break;
+		}
+		in = &bts->abis_nm_inflight[i];
+		in->bts = bts;
+		in->seq = bts->abis_nm_seq++;
+		in->in_use = 1;
+		in->msg_type = foh->msg_type;
+		in->obj_class = foh->obj_class;
+		in->obj_inst[0] = foh->obj_inst.bts_nr;
+		in->obj_inst[1] = foh->obj_inst.trx_nr;
+		in->obj_inst[2] = foh->obj_inst.ts_nr;
+		in->serialise = nm_is_serialised(oh);
+		in->timer.cb = nm_inflight_timeout;
+		in->timer.data = in;
+		osmo_timer_schedule(&in->timer, ABIS_NM_ACK_TIMEOUT, 0);
+		bts->abis_nm_pend++;
+	}
+
+	return _abis_nm_sendmsg(msg);
+}
+
+static void nm_queue_flush(struct gsm_bts *bts)
+{
+	struct msgb *msg;
+
+	while (!llist_empty(&bts->abis_queue)) {
+		msg = llist_entry(bts->abis_queue.next, struct msgb, list);
+		if (!nm_may_send(bts, msg))
+			break;
+
+		llist_del(&msg->list);
+		nm_send(bts, msg);
+	}
+}
+
 /* Send a OML NM Message from BSC to BTS */
 static int abis_nm_queue_msg(struct gsm_bts *bts, struct msgb *msg)
 {
 	msg->dst = bts->oml_link;
 
 	/* queue OML messages */
-	if (llist_empty(&bts->abis_queue) && !bts->abis_nm_pend) {
-		bts->abis_nm_pend = OBSC_NM_W_ACK_CB(msg);
-		return _abis_nm_sendmsg(msg);
+	if (llist_empty(&bts->abis_queue) && nm_may_send(bts, msg)) {
+		return nm_send(bts, msg);
 	} else {
 		msgb_enqueue(&bts->abis_queue, msg);
 		return 0;
@@ -492,21 +650,64 @@ static int abis_nm_rx_lmt_event(struct msgb *mb)
 	return 0;
 }
 
+/* a reply arrived, release the oldest message and send what we can */
 void abis_nm_queue_send_next(struct gsm_bts *bts)
 {
-	int wait = 0;
+	struct abis_nm_inflight *in = nm_inflight_oldest(bts);
+
+	if (in)
+		nm_inflight_del(in);
+
+	nm_queue_flush(bts);
+}
+
+/* the OML link is gone, drop everything queued and in flight */
+void abis_nm_queue_reset(struct gsm_bts *bts)
+{
 	struct msgb *msg;
-	/* the queue is empty */
+	int i;
+
+	for (i = 0; i < ABIS_NM_MAX_WINDOW; i++) {
+		if (bts->abis_nm_inflight[i].in_use)
+			nm_inflight_del(&bts->abis_nm_inflight[i]);
+	}
+
 	while (!llist_empty(&bts->abis_queue)) {
 		msg = msgb_dequeue(&bts->abis_queue);
-		wait = OBSC_NM_W_ACK_CB(msg);
-		_abis_nm_sendmsg(msg);
+		msgb_free(msg);
+	}
+}
 
-		if (wait)
-			break;
+/* match an ACK/NACK to the message it answers */
+static void abis_nm_queue_rx_reply(struct gsm_bts *bts,
+				   struct abis_om_fom_hdr *foh)
+{
+	int i;
+
+	for (i = 0; i < ABIS_NM_MAX_WINDOW; i++) {
+		struct abis_nm_inflight *in = &bts->abis_nm_inflight[i];
+
+		if (!in->in_use)
+			continue;
+		if ((foh->msg_type == MT_ACK(in->msg_type)
+		     || foh->msg_type == MT_NACK(in->msg_type))
+		    && nm_inflight_match(in, foh)) {
+			nm_inflight_del(in);
+			nm_queue_flush(bts);
+			return;
+		}
 	}
 
-	bts->abis_nm_pend = wait;
+	/*
+	 * With a single message outstanding we keep treating anything
+	 * the BTS sends as its answer, like we always did.
+	 */
+	if (bts->abis_nm_window <= 1) {
+		abis_nm_queue_send_next(bts);
+		return;
+	}
+
+	nm_queue_flush(bts);
 }
 
 /* Receive a OML NM Message from BTS */
@@ -543,7 +744,7 @@ static int abis_nm_rcvmsg_fom(struct msgb *mb)
 		nack_data.msg = mb;
 		nack_data.mt = mt;
 		osmo_signal_dispatch(SS_NM, S_NM_NACK, &nack_data);
-		abis_nm_queue_send_next(sign_link->trx->bts);
+		abis_nm_queue_rx_reply(sign_link->trx->bts, foh);
 		return 0;
 	}
 #if 0
@@ -590,7 +791,7 @@ static int abis_nm_rcvmsg_fom(struct msgb *mb)
 		break;
 	}
 
-	abis_nm_queue_send_next(sign_link->trx->bts);
+	abis_nm_queue_rx_reply(sign_link->trx->bts, foh);
 	return ret;
 }
 
@@ -605,7 +806,8 @@ static int abis_nm_rcvmsg_manuf(struct msgb *mb)
 	switch (bts_type) {
 	case GSM_BTS_TYPE_NANOBTS:
 		rc = abis_nm_rx_ipacc(mb);
-		abis_nm_queue_send_next(sign_link->trx->bts);
+		abis_nm_queue_rx_reply(sign_link->trx->bts,
+				       nm_foh(msgb_l2(mb)));
 		break;
 	default:
 		LOGP(DNM, LOGL_ERROR, "don't know how to parse OML for this "
@@ -730,8 +932,14 @@ struct abis_nm_sw {
 	uint8_t window_size;
 	uint8_t seg_in_window;
 
-	int fd;
-	FILE *stream;
+	/* the whole image is mapped, segments are copied from there */
+	const uint8_t *image;
+	size_t image_len;
+	/* start of each BS11 line and the end of the last one */
+	unsigned int *line_off;
+	unsigned int nr_segs;
+	unsigned int cur_seg;
+
 	enum sw_state state;
 	int last_seg;
 };
@@ -772,80 +980,56 @@ static int sw_load_init(struct abis_nm_sw *sw)
 	return abis_nm_sendmsg(sw->bts, msg);
 }
 
-static int is_last_line(FILE *stream)
-{
-	char next_seg_buf[256];
-	long pos;
-
-	/* check if we're sending the last line */
-	pos = ftell(stream);
-	if (!fgets(next_seg_buf, sizeof(next_seg_buf)-2, stream)) {
-		fseek(stream, pos, SEEK_SET);
-		return 1;
-	}
-
-	fseek(stream, pos, SEEK_SET);
-	return 0;
-}
-
 /* 6.2.2 / 8.3.2 Load Data Segment */
 static int sw_load_segment(struct abis_nm_sw *sw)
 {
 	struct abis_om_hdr *oh;
-	struct msgb *msg = nm_msgb_alloc();
-	char seg_buf[256];
-	char *line_buf = seg_buf+2;
+	struct msgb *msg;
 	unsigned char *tlv;
+	unsigned int off;
 	int len;
 
+	if (sw->cur_seg >= sw->nr_segs)
+		return -EINVAL;
+
+	msg = nm_msgb_alloc();
 	oh = (struct abis_om_hdr *) msgb_put(msg, ABIS_OM_FOM_HDR_SIZE);
 
 	switch (sw->bts->type) {
 	case GSM_BTS_TYPE_BS11:
-		if (fgets(line_buf, sizeof(seg_buf)-2, sw->stream) == NULL) {
-			perror("fgets reading segment");
-			return -EINVAL;
-		}
-		seg_buf[0] = 0x00;
+		off = sw->line_off[sw->cur_seg];
+		len = sw->line_off[sw->cur_seg + 1] - off;
+		sw->last_seg = sw->cur_seg + 1 == sw->nr_segs;
 
-		/* check if we're sending the last line */
-		sw->last_seg = is_last_line(sw->stream);
-		if (sw->last_seg)
-			seg_buf[1] = 0;
-		else
-			seg_buf[1] = 1 + sw->seg_in_window++;
-
-		len = strlen(line_buf) + 2;
-		tlv = msgb_put(msg, TLV_GROSS_LEN(len));
-		tlv_put(tlv, NM_ATT_BS11_FILE_DATA, len, (uint8_t *)seg_buf);
+		tlv = msgb_put(msg, TLV_GROSS_LEN(len + 2));
+		tlv[0] = NM_ATT_BS11_FILE_DATA;
 		/* BS11 wants CR + LF in excess of the TLV length !?! */
-		tlv[1] -= 2;
+		tlv[1] = len;
+		tlv[2] = 0x00;
+		tlv[3] = sw->last_seg ? 0 : 1 + sw->seg_in_window++;
+		memcpy(&tlv[4], sw->image + off, len);
 
 		/* we only now know the exact length for the OM hdr */
-		len = strlen(line_buf)+2;
+		len += 2;
 		break;
-	case GSM_BTS_TYPE_NANOBTS: {
-		osmo_static_assert(sizeof(seg_buf) >= IPACC_SEGMENT_SIZE, buffer_big_enough);
-		len = read(sw->fd, &seg_buf, IPACC_SEGMENT_SIZE);
-		if (len < 0) {
-			perror("read failed");
-			return -EINVAL;
-		}
-
+	case GSM_BTS_TYPE_NANOBTS:
+		off = sw->cur_seg * IPACC_SEGMENT_SIZE;
+		len = OSMO_MIN(sw->image_len - off, IPACC_SEGMENT_SIZE);
 		if (len != IPACC_SEGMENT_SIZE)
 			sw->last_seg = 1;
 
 		++sw->seg_in_window;
-		msgb_tl16v_put(msg, NM_ATT_IPACC_FILE_DATA, len, (const uint8_t *) seg_buf);
+		msgb_tl16v_put(msg, NM_ATT_IPACC_FILE_DATA, len, sw->image + off);
 		len += 3;
 		break;
-	}
 	default:
 		LOGP(DNM, LOGL_ERROR, "sw_load_segment needs implementation for the BTS.\n");
 		/* FIXME: Other BTS types */
+		msgb_free(msg);
 		return -1;
 	}
 
+	sw->cur_seg += 1;
 	fill_om_fom_hdr(oh, len, NM_MT_LOAD_SEG, sw->obj_class,
 			sw->obj_instance[0], sw->obj_instance[1],
 			sw->obj_instance[2]);
@@ -899,14 +1083,12 @@ struct sdp_firmware {
 static int parse_sdp_header(struct abis_nm_sw *sw)
 {
 	struct sdp_firmware firmware_header;
-	int rc;
-	struct stat stat;
 
-	rc = read(sw->fd, &firmware_header, sizeof(firmware_header));
-	if (rc != sizeof(firmware_header)) {
+	if (sw->image_len < sizeof(firmware_header)) {
 		LOGP(DNM, LOGL_ERROR, "Could not read SDP file header.\n");
 		return -1;
 	}
+	memcpy(&firmware_header, sw->image, sizeof(firmware_header));
 
 	if (strncmp(firmware_header.magic, " SDP", 4) != 0) {
 		LOGP(DNM, LOGL_ERROR, "The magic number1 is wrong.\n");
@@ -921,19 +1103,11 @@ static int parse_sdp_header(struct abis_nm_sw *sw)
 		return -1;
 	}
 
-
-	if (fstat(sw->fd, &stat) == -1) {
-		LOGP(DNM, LOGL_ERROR, "Could not stat the file.\n");
-		return -1;
-	}
-
-	if (ntohl(firmware_header.file_length) != stat.st_size) {
+	if (ntohl(firmware_header.file_length) != sw->image_len) {
 		LOGP(DNM, LOGL_ERROR, "The filesizes do not match.\n");
 		return -1;
 	}
 
-	/* go back to the start as we checked the whole filesize.. */
-	lseek(sw->fd, 0l, SEEK_SET);
 	LOGP(DNM, LOGL_NOTICE, "The ipaccess SDP header is not fully understood.\n"
 			       "There might be checksums in the file that are not\n"
 			       "verified and incomplete firmware might be flashed.\n"
@@ -942,42 +1116,110 @@ static int parse_sdp_header(struct abis_nm_sw *sw)
 	return 0;
 }
 
+/* end of the BS11 line at off, as fgets() into our 256 byte buffer did */
+static unsigned int bs11_line_end(struct abis_nm_sw *sw, unsigned int off)
+{
+	unsigned int max = OSMO_MIN(sw->image_len - off, 253);
+	const uint8_t *nl = memchr(sw->image + off, '\n', max);
+
+	return nl ? nl - sw->image + 1 : off + max;
+}
+
+/* find all lines once, so sending a segment does not need to look ahead */
+static int bs11_index_lines(struct abis_nm_sw *sw)
+{
+	unsigned int off, i;
+
+	sw->nr_segs = 0;
+	for (off = 0; off < sw->image_len; off = bs11_line_end(sw, off))
+		sw->nr_segs += 1;
+
+	sw->line_off = talloc_array(tall_bsc_ctx, unsigned int, sw->nr_segs + 1);
+	if (!sw->line_off)
+		return -ENOMEM;
+
+	for (off = 0, i = 0; off < sw->image_len; off = bs11_line_end(sw, off))
+		sw->line_off[i++] = off;
+	sw->line_off[i] = off;
+
+	return 0;
+}
+
+static void sw_close_file(struct abis_nm_sw *sw)
+{
+	if (sw->image)
+		munmap((void *) sw->image, sw->image_len);
+	talloc_free(sw->line_off);
+
+	sw->image = NULL;
+	sw->image_len = 0;
+	sw->line_off = NULL;
+	sw->nr_segs = 0;
+	sw->cur_seg = 0;
+}
+
 static int sw_open_file(struct abis_nm_sw *sw, const char *fname)
 {
+	char header[256];
 	char file_id[12+1];
 	char file_version[80+1];
-	int rc;
+	struct stat st;
+	void *image;
+	int fd, rc;
 
-	sw->fd = open(fname, O_RDONLY);
-	if (sw->fd < 0)
-		return sw->fd;
+	fd = open(fname, O_RDONLY);
+	if (fd < 0)
+		return fd;
+
+	if (fstat(fd, &st) < 0 || st.st_size == 0) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	/* map the whole image, the segments are sent from there */
+	image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (image == MAP_FAILED) {
+		perror("mmap");
+		return -EIO;
+	}
+	sw->image = image;
+	sw->image_len = st.st_size;
+	sw->line_off = NULL;
+	sw->cur_seg = 0;
 
 	switch (sw->bts->type) {
 	case GSM_BTS_TYPE_BS11:
-		sw->stream = fdopen(sw->fd, "r");
-		if (!sw->stream) {
-			perror("fdopen");
-			return -1;
-		}
 		/* read first line and parse file ID and VERSION */
-		rc = fscanf(sw->stream, "@(#)%12s:%80s\r\n",
+		rc = OSMO_MIN(sw->image_len, sizeof(header) - 1);
+		memcpy(header, sw->image, rc);
+		header[rc] = '\0';
+		rc = sscanf(header, "@(#)%12s:%80s\r\n",
 			    file_id, file_version);
 		if (rc != 2) {
-			perror("parsing header line of software file");
+			LOGP(DNM, LOGL_ERROR, "Could not parse the header "
+			     "line of the software file\n");
+			sw_close_file(sw);
 			return -1;
 		}
 		strcpy((char *)sw->file_id, file_id);
 		sw->file_id_len = strlen(file_id);
 		strcpy((char *)sw->file_version, file_version);
 		sw->file_version_len = strlen(file_version);
-		/* rewind to start of file */
-		rewind(sw->stream);
-		break;	
+
+		/* the header line is sent as the first segment */
+		rc = bs11_index_lines(sw);
+		if (rc < 0) {
+			sw_close_file(sw);
+			return rc;
+		}
+		break;
 	case GSM_BTS_TYPE_NANOBTS:
 		/* TODO: extract that from the filename or content */
 		rc = parse_sdp_header(sw);
 		if (rc < 0) {
 			fprintf(stderr, "Could not parse the ipaccess SDP header\n");
+			sw_close_file(sw);
 			return -1;
 		}
 
@@ -985,27 +1227,18 @@ static int sw_open_file(struct abis_nm_sw *sw, const char *fname)
 		sw->file_id_len = 3;
 		strcpy((char *)sw->file_version, "version");
 		sw->file_version_len = 8;
+
+		/* a last short, maybe empty, segment ends the transfer */
+		sw->nr_segs = sw->image_len / IPACC_SEGMENT_SIZE + 1;
 		break;
 	default:
 		/* We don't know how to treat them yet */
-		close(sw->fd);
+		sw_close_file(sw);
 		return -EINVAL;
 	}
 
 	return 0;
 }
-	
-static void sw_close_file(struct abis_nm_sw *sw)
-{
-	switch (sw->bts->type) {
-	case GSM_BTS_TYPE_BS11:
-		fclose(sw->stream);
-		break;
-	default:
-		close(sw->fd);
-		break;
-	}
-}
 
 /* Fill the window */
 static int sw_fill_window(struct abis_nm_sw *sw)
@@ -1044,7 +1277,7 @@ static int abis_nm_rcvmsg_sw(struct msgb *mb)
 					 sw->cb_data, NULL);
 			rc = sw_fill_window(sw);
 			sw->state = SW_STATE_WAIT_SEGACK;
-			abis_nm_queue_send_next(sign_link->trx->bts);
+			abis_nm_queue_rx_reply(sign_link->trx->bts, foh);
 			break;
 		case NM_MT_LOAD_INIT_NACK:
 			if (sw->forced) {
@@ -1065,7 +1298,7 @@ static int abis_nm_rcvmsg_sw(struct msgb *mb)
 						 sw->cb_data, NULL);
 				sw->state = SW_STATE_ERROR;
 			}
-			abis_nm_queue_send_next(sign_link->trx->bts);
+			abis_nm_queue_rx_reply(sign_link->trx->bts, foh);
 			break;
 		}
 		break;
@@ -1086,7 +1319,7 @@ static int abis_nm_rcvmsg_sw(struct msgb *mb)
 				sw->state = SW_STATE_WAIT_ENDACK;
 				rc = sw_load_end(sw);
 			}
-			abis_nm_queue_send_next(sign_link->trx->bts);
+			abis_nm_queue_rx_reply(sign_link->trx->bts, foh);
 			break;
 		case NM_MT_LOAD_ABORT:
 			if (sw->cbfn)
@@ -1108,7 +1341,7 @@ static int abis_nm_rcvmsg_sw(struct msgb *mb)
 					 NM_MT_LOAD_END_ACK, mb,
 					 sw->cb_data, NULL);
 			rc = 0;
-			abis_nm_queue_send_next(sign_link->trx->bts);
+			abis_nm_queue_rx_reply(sign_link->trx->bts, foh);
 			break;
 		case NM_MT_LOAD_END_NACK:
 			if (sw->forced) {
@@ -1128,7 +1361,7 @@ static int abis_nm_rcvmsg_sw(struct msgb *mb)
 						 NM_MT_LOAD_END_NACK, mb,
 						 sw->cb_data, NULL);
 			}
-			abis_nm_queue_send_next(sign_link->trx->bts);
+			abis_nm_queue_rx_reply(sign_link->trx->bts, foh);
 			break;
 		}
 	case SW_STATE_WAIT_ACTACK:
@@ -1142,7 +1375,7 @@ static int abis_nm_rcvmsg_sw(struct msgb *mb)
 				sw->cbfn(GSM_HOOK_NM_SWLOAD,
 					 NM_MT_ACTIVATE_SW_ACK, mb,
 					 sw->cb_data, NULL);
-			abis_nm_queue_send_next(sign_link->trx->bts);
+			abis_nm_queue_rx_reply(sign_link->trx->bts, foh);
 			break;
 		case NM_MT_ACTIVATE_SW_NACK:
 			DEBUGP(DNM, "Activate Software NACK\n");
@@ -1152,7 +1385,7 @@ static int abis_nm_rcvmsg_sw(struct msgb *mb)
 				sw->cbfn(GSM_HOOK_NM_SWLOAD,
 					 NM_MT_ACTIVATE_SW_NACK, mb,
 					 sw->cb_data, NULL);
-			abis_nm_queue_send_next(sign_link->trx->bts);
+			abis_nm_queue_rx_reply(sign_link->trx->bts, foh);
 			break;
 		}
 	case SW_STATE_NONE:
@@ -1227,20 +1460,17 @@ int abis_nm_software_load(struct gsm_bts *bts, int trx_nr, const char *fname,
 int abis_nm_software_load_status(struct gsm_bts *bts)
 {
 	struct abis_nm_sw *sw = &g_sw;
-	struct stat st;
-	int rc, percent;
+	size_t off;
 
-	rc = fstat(sw->fd, &st);
-	if (rc < 0) {
-		perror("ERROR during stat");
-		return rc;
-	}
+	if (!sw->image_len)
+		return -EINVAL;
 
-	if (sw->stream)
-		percent = (ftell(sw->stream) * 100) / st.st_size;
+	if (sw->line_off)
+		off = sw->line_off[sw->cur_seg];
 	else
-		percent = (lseek(sw->fd, 0, SEEK_CUR) * 100) / st.st_size;
-	return percent;
+		off = OSMO_MIN(sw->cur_seg * IPACC_SEGMENT_SIZE, sw->image_len);
+
+	return (off * 100) / sw->image_len;
 }
 
 /* Activate the specified software into the BTS */
@@ -38,6 +38,7 @@
 #include <openbsc/signal.h>
 #include <openbsc/meas_rep.h>
 #include <openbsc/rtp_proxy.h>
+#include <openbsc/pdu_trace.h>
 #include <osmocom/abis/e1_input.h>
 #include <osmocom/gsm/rsl.h>
 #include <osmocom/core/talloc.h>
@@ -1018,6 +1019,7 @@ static int rsl_rx_meas_res(struct msgb *msg)
 
 	print_meas_rep(mr);
 
+	lchan_commit_meas_rep(msg->lchan);
 	send_lchan_signal(S_LCHAN_MEAS_REP, msg->lchan, mr);
 
 	return 0;
@@ -1881,6 +1883,7 @@ static int abis_rsl_rx_ipacc(struct msgb *msg)
 /* Entry-point where L2 RSL from BTS enters */
 int abis_rsl_rcvmsg(struct msgb *msg)
 {
+	struct e1inp_sign_link *sign_link;
 	struct abis_rsl_common_hdr *rslh;
 	int rc = 0;
 
@@ -1894,6 +1897,11 @@ int abis_rsl_rcvmsg(struct msgb *msg)
 		return -1;
 	}
 
+	sign_link = msg->dst;
+	pdu_trace_record(PDU_TRACE_RSL, PDU_TRACE_RX,
+			 sign_link ? sign_link->trx->bts->nr << 8 | sign_link->trx->nr : 0,
+			 msgb_l2(msg), msgb_l2len(msg));
+
 	rslh = msgb_l2(msg);
 
 	switch (rslh->msg_discr & 0xfe) {
@@ -90,100 +90,6 @@ int bsc_shutdown_net(struct gsm_network *net)
 	return 0;
 }
 
-static int generate_and_rsl_si(struct gsm_bts_trx *trx, enum osmo_sysinfo_type i)
-{
-	struct gsm_bts *bts = trx->bts;
-	int si_len, rc, j;
-
-	/* Only generate SI if this SI is not in "static" (user-defined) mode */
-	if (!(bts->si_mode_static & (1 << i))) {
-		rc = gsm_generate_si(bts, i);
-		if (rc < 0)
-			return rc;
-		si_len = rc;
-	}
-
-	DEBUGP(DRR, "SI%s: %s\n", get_value_string(osmo_sitype_strs, i),
-		osmo_hexdump(GSM_BTS_SI(bts, i), GSM_MACBLOCK_LEN));
-
-	switch (i) {
-	case SYSINFO_TYPE_5:
-	case SYSINFO_TYPE_5bis:
-	case SYSINFO_TYPE_5ter:
-	case SYSINFO_TYPE_6:
-		if (trx->bts->type == GSM_BTS_TYPE_HSL_FEMTO) {
-			/* HSL has mistaken SACCH INFO MODIFY for SACCH FILLING,
-			 * so we need a special workaround here */
-			/* This assumes a combined BCCH and TCH on TS1...7 */
-			for (j = 0; j < 4; j++)
-				rsl_sacch_info_modify(&trx->ts[0].lchan[j],
-						      osmo_sitype2rsl(i),
-						      GSM_BTS_SI(bts, i), si_len);
-			for (j = 1; j < 8; j++) {
-				rsl_sacch_info_modify(&trx->ts[j].lchan[0],
-						      osmo_sitype2rsl(i),
-						      GSM_BTS_SI(bts, i), si_len);
-				rsl_sacch_info_modify(&trx->ts[j].lchan[1],
-						      osmo_sitype2rsl(i),
-						      GSM_BTS_SI(bts, i), si_len);
-			}
-		} else
-			rc = rsl_sacch_filling(trx, osmo_sitype2rsl(i),
-					       GSM_BTS_SI(bts, i), rc);
-		break;
-	default:
-		rc = rsl_bcch_info(trx, osmo_sitype2rsl(i),
-				   GSM_BTS_SI(bts, i), rc);
-		break;
-	}
-
-	return rc;
-}
-
-/* set all system information types */
-static int set_system_infos(struct gsm_bts_trx *trx)
-{
-	int i, rc;
-	struct gsm_bts *bts = trx->bts;
-
-	bts->si_common.cell_sel_par.ms_txpwr_max_ccch =
-			ms_pwr_ctl_lvl(bts->band, bts->ms_max_power);
-	bts->si_common.cell_sel_par.neci = bts->network->neci;
-
-	/* First, we determine which of the SI messages we actually need */
-
-	if (trx == bts->c0) {
-		/* 1...4 are always present on a C0 TRX */
-		for (i = SYSINFO_TYPE_1; i <= SYSINFO_TYPE_4; i++)
-			bts->si_valid |= (1 << i);
-
-		/* 13 is always present on a C0 TRX of a GPRS BTS */
-		if (bts->gprs.mode != BTS_GPRS_NONE)
-			bts->si_valid |= (1 << SYSINFO_TYPE_13);
-	}
-
-	/* 5 and 6 are always present on every TRX */
-	bts->si_valid |= (1 << SYSINFO_TYPE_5);
-	bts->si_valid |= (1 << SYSINFO_TYPE_6);
-
-	/* Second, we generate and send the selected SI via RSL */
-	for (i = SYSINFO_TYPE_1; i < _MAX_SYSINFO_TYPE; i++) {
-		if (!(bts->si_valid & (1 << i)))
-			continue;
-
-		rc = generate_and_rsl_si(trx, i);
-		if (rc < 0)
-			goto err_out;
-	}
-
-	return 0;
-err_out:
-	LOGP(DRR, LOGL_ERROR, "Cannot generate SI %u for BTS %u, most likely "
-		"a problem with neighbor cell list generation\n",
-		i, bts->nr);
-	return rc;
-}
-
 /* Produce a MA as specified in 10.5.2.21 */
 static int generate_ma_for_ts(struct gsm_bts_trx_ts *ts)
 {
@@ -256,7 +162,7 @@ static void bootstrap_rsl(struct gsm_bts_trx *trx)
 		rsl_nokia_si_begin(trx);
 	}
 
-	set_system_infos(trx);
+	gsm_bts_trx_set_system_infos(trx);
 
 	if (trx->bts->type == GSM_BTS_TYPE_NOKIA_SITE) {
 		/* channel unspecific, power reduction in 2 dB steps */
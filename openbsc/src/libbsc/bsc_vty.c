@@ -25,6 +25,7 @@
 #include <osmocom/vty/vty.h>
 #include <osmocom/vty/logging.h>
 #include <osmocom/vty/telnet_interface.h>
+#include <osmocom/vty/misc.h>
 
 #include <arpa/inet.h>
 
@@ -49,6 +50,7 @@
 #include <openbsc/abis_rsl.h>
 #include <openbsc/osmo_msc_data.h>
 #include <openbsc/osmo_bsc_rf.h>
+#include <openbsc/handover.h>
 
 #include "../../bscconfig.h"
 
@@ -225,6 +227,7 @@ static void e1isl_dump_vty(struct vty *vty, struct e1inp_sign_link *e1l)
 static void bts_dump_vty(struct vty *vty, struct gsm_bts *bts)
 {
 	struct pchan_load pl;
+	struct bsc_ho_stats *ho_stats;
 
 	vty_out(vty, "BTS %u is of %s type in band %s, has CI %u LAC %u, "
 		"BSIC %u, TSC %u and %u TRX%s",
@@ -275,6 +278,12 @@ static void bts_dump_vty(struct vty *vty, struct gsm_bts *bts)
 	bts_chan_load(&pl, bts);
 	vty_out(vty, "  Current Channel Load:%s", VTY_NEWLINE);
 	dump_pchan_load_vty(vty, "    ", &pl);
+
+	llist_for_each_entry(ho_stats, &bts->ho_stats, list) {
+		vty_out(vty, "  Handover to BTS %u:%s",
+			ho_stats->target->nr, VTY_NEWLINE);
+		vty_out_rate_ctr_group(vty, "    ", ho_stats->ctrg);
+	}
 }
 
 DEFUN(show_bts, show_bts_cmd, "show bts [number]",
@@ -519,6 +528,8 @@ static void config_write_bts_single(struct vty *vty, struct gsm_bts *bts)
 		vty_out(vty, "  oml e1 tei %u%s", bts->oml_tei, VTY_NEWLINE);
 		break;
 	}
+	if (bts->abis_nm_window != 1)
+		vty_out(vty, "  oml window %d%s", bts->abis_nm_window, VTY_NEWLINE);
 
 	/* if we have a limit, write it */
 	if (bts->paging.free_chans_need >= 0)
@@ -1402,6 +1413,8 @@ DEFUN(cfg_bts_ci,
 	}
 	bts->cell_identity = ci;
 
+	gsm_bts_si_changed(bts, SI_MASK_CELL_ID);
+
 	return CMD_SUCCESS;
 }
 
@@ -1427,6 +1440,8 @@ DEFUN(cfg_bts_lac,
 
 	bts->location_area_code = lac;
 
+	gsm_bts_si_changed(bts, SI_MASK_CELL_ID);
+
 	return CMD_SUCCESS;
 }
 
@@ -1463,6 +1478,7 @@ DEFUN(cfg_bts_bsic,
 		return CMD_WARNING;
 	}
 	bts->bsic = bsic;
+	gsm_bts_rehash(bts);
 
 	return CMD_SUCCESS;
 }
@@ -1577,6 +1593,20 @@ DEFUN(cfg_bts_oml_e1_tei,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_bts_oml_window,
+      cfg_bts_oml_window_cmd,
+      "oml window <1-8>",
+	OML_STR
+      "Number of OML messages that may wait for their ACK at the same time\n"
+      "Window size, 1 for BTS that do not ACK or NACK every message\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->abis_nm_window = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
 DEFUN(cfg_bts_challoc, cfg_bts_challoc_cmd,
       "channel allocator (ascending|descending)",
 	"Channnel Allocator\n" "Channel Allocator\n"
@@ -1603,6 +1633,7 @@ DEFUN(cfg_bts_rach_tx_integer,
 {
 	struct gsm_bts *bts = vty->index;
 	bts->si_common.rach_control.tx_integer = atoi(argv[0]) & 0xf;
+	gsm_bts_si_changed(bts, SI_MASK_RACH);
 	return CMD_SUCCESS;
 }
 
@@ -1614,6 +1645,7 @@ DEFUN(cfg_bts_rach_max_trans,
 {
 	struct gsm_bts *bts = vty->index;
 	bts->si_common.rach_control.max_trans = rach_max_trans_val2raw(atoi(argv[0]));
+	gsm_bts_si_changed(bts, SI_MASK_RACH);
 	return CMD_SUCCESS;
 }
 
@@ -1649,6 +1681,8 @@ DEFUN(cfg_bts_cell_barred, cfg_bts_cell_barred_cmd,
 
 	bts->si_common.rach_control.cell_bar = atoi(argv[0]);
 
+	gsm_bts_si_changed(bts, SI_MASK_RACH);
+
 	return CMD_SUCCESS;
 }
 
@@ -1663,6 +1697,8 @@ DEFUN(cfg_bts_rach_ec_allowed, cfg_bts_rach_ec_allowed_cmd,
 	else
 		bts->si_common.rach_control.t2 &= ~0x4;
 
+	gsm_bts_si_changed(bts, SI_MASK_RACH);
+
 	return CMD_SUCCESS;
 }
 
@@ -1674,6 +1710,8 @@ DEFUN(cfg_bts_ms_max_power, cfg_bts_ms_max_power_cmd,
 
 	bts->ms_max_power = atoi(argv[0]);
 
+	gsm_bts_si_changed(bts, SI_MASK_CELL_SEL);
+
 	return CMD_SUCCESS;
 }
 
@@ -1685,6 +1723,8 @@ DEFUN(cfg_bts_cell_resel_hyst, cfg_bts_cell_resel_hyst_cmd,
 
 	bts->si_common.cell_sel_par.cell_resel_hyst = atoi(argv[0])/2;
 
+	gsm_bts_si_changed(bts, SI_MASK_CELL_SEL);
+
 	return CMD_SUCCESS;
 }
 
@@ -1696,6 +1736,8 @@ DEFUN(cfg_bts_rxlev_acc_min, cfg_bts_rxlev_acc_min_cmd,
 
 	bts->si_common.cell_sel_par.rxlev_acc_min = atoi(argv[0]);
 
+	gsm_bts_si_changed(bts, SI_MASK_CELL_SEL);
+
 	return CMD_SUCCESS;
 }
 
@@ -1708,6 +1750,8 @@ DEFUN(cfg_bts_cell_bar_qualify, cfg_bts_cell_bar_qualify_cmd,
 	bts->si_common.cell_ro_sel_par.present = 1;
 	bts->si_common.cell_ro_sel_par.cbq = atoi(argv[0]);
 
+	gsm_bts_si_changed(bts, SI_MASK_CELL_SEL);
+
 	return CMD_SUCCESS;
 }
 
@@ -1720,6 +1764,8 @@ DEFUN(cfg_bts_cell_resel_ofs, cfg_bts_cell_resel_ofs_cmd,
 	bts->si_common.cell_ro_sel_par.present = 1;
 	bts->si_common.cell_ro_sel_par.cell_resel_off = atoi(argv[0])/2;
 
+	gsm_bts_si_changed(bts, SI_MASK_CELL_SEL);
+
 	return CMD_SUCCESS;
 }
 
@@ -1732,6 +1778,8 @@ DEFUN(cfg_bts_temp_ofs, cfg_bts_temp_ofs_cmd,
 	bts->si_common.cell_ro_sel_par.present = 1;
 	bts->si_common.cell_ro_sel_par.temp_offs = atoi(argv[0])/10;
 
+	gsm_bts_si_changed(bts, SI_MASK_CELL_SEL);
+
 	return CMD_SUCCESS;
 }
 
@@ -1744,6 +1792,8 @@ DEFUN(cfg_bts_temp_ofs_inf, cfg_bts_temp_ofs_inf_cmd,
 	bts->si_common.cell_ro_sel_par.present = 1;
 	bts->si_common.cell_ro_sel_par.temp_offs = 7;
 
+	gsm_bts_si_changed(bts, SI_MASK_CELL_SEL);
+
 	return CMD_SUCCESS;
 }
 
@@ -1756,6 +1806,8 @@ DEFUN(cfg_bts_penalty_time, cfg_bts_penalty_time_cmd,
 	bts->si_common.cell_ro_sel_par.present = 1;
 	bts->si_common.cell_ro_sel_par.penalty_time = (atoi(argv[0])-20)/20;
 
+	gsm_bts_si_changed(bts, SI_MASK_CELL_SEL);
+
 	return CMD_SUCCESS;
 }
 
@@ -1770,6 +1822,8 @@ DEFUN(cfg_bts_penalty_time_rsvd, cfg_bts_penalty_time_rsvd_cmd,
 	bts->si_common.cell_ro_sel_par.present = 1;
 	bts->si_common.cell_ro_sel_par.penalty_time = 31;
 
+	gsm_bts_si_changed(bts, SI_MASK_CELL_SEL);
+
 	return CMD_SUCCESS;
 }
 
@@ -1781,6 +1835,8 @@ DEFUN(cfg_bts_per_loc_upd, cfg_bts_per_loc_upd_cmd,
 
 	bts->si_common.chan_desc.t3212 = atoi(argv[0]) / 6;
 
+	gsm_bts_si_changed(bts, SI_MASK(3));
+
 	return CMD_SUCCESS;
 }
 
@@ -2012,6 +2068,8 @@ DEFUN(cfg_bts_gprs_mode, cfg_bts_gprs_mode_cmd,
 
 	bts->gprs.mode = mode;
 
+	gsm_bts_si_changed(bts, SI_MASK(3) | SI_MASK(4) | SI_MASK(13));
+
 	return CMD_SUCCESS;
 }
 
@@ -2060,6 +2118,8 @@ DEFUN(cfg_bts_si_mode, cfg_bts_si_mode_cmd,
 	else
 		bts->si_mode_static &= ~(1 << type);
 
+	gsm_bts_si_changed(bts, (1 << type));
+
 	return CMD_SUCCESS;
 }
 
@@ -2097,6 +2157,8 @@ DEFUN(cfg_bts_si_static, cfg_bts_si_static_cmd,
 	/* Mark this SI as present */
 	bts->si_valid |= (1 << type);
 
+	gsm_bts_si_changed(bts, (1 << type));
+
 	return CMD_SUCCESS;
 }
 
@@ -2124,6 +2186,8 @@ DEFUN(cfg_bts_neigh_mode, cfg_bts_neigh_mode_cmd,
 
 	bts->neigh_list_manual_mode = mode;
 
+	gsm_bts_si_changed(bts, SI_MASK_NEIGH);
+
 	return CMD_SUCCESS;
 }
 
@@ -2148,6 +2212,8 @@ DEFUN(cfg_bts_neigh, cfg_bts_neigh_cmd,
 	else
 		bitvec_set_bit_pos(bv, arfcn, 0);
 
+	gsm_bts_si_changed(bts, SI_MASK_NEIGH);
+
 	return CMD_SUCCESS;
 }
 
@@ -2172,6 +2238,8 @@ DEFUN(cfg_bts_si5_neigh, cfg_bts_si5_neigh_cmd,
 	else
 		bitvec_set_bit_pos(bv, arfcn, 0);
 
+	gsm_bts_si_changed(bts, SI_MASK(5));
+
 	return CMD_SUCCESS;
 }
 
@@ -2219,6 +2287,8 @@ DEFUN(cfg_trx_arfcn,
 	/* FIXME: check if this ARFCN is supported by this TRX */
 
 	trx->arfcn = arfcn;
+	if (trx == trx->bts->c0)
+		gsm_bts_rehash(trx->bts);
 
 	/* FIXME: patch ARFCN into SYSTEM INFORMATION */
 	/* FIXME: use OML layer to update the ARFCN */
@@ -2651,6 +2721,7 @@ int bsc_vty_init(const struct log_info *cat)
 	install_element(BTS_NODE, &cfg_bts_hsl_oml_cmd);
 	install_element(BTS_NODE, &cfg_bts_oml_e1_cmd);
 	install_element(BTS_NODE, &cfg_bts_oml_e1_tei_cmd);
+	install_element(BTS_NODE, &cfg_bts_oml_window_cmd);
 	install_element(BTS_NODE, &cfg_bts_challoc_cmd);
 	install_element(BTS_NODE, &cfg_bts_rach_tx_integer_cmd);
 	install_element(BTS_NODE, &cfg_bts_rach_max_trans_cmd);
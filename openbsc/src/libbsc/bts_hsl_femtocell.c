@@ -237,6 +237,7 @@ void hsl_drop_oml(struct gsm_bts *bts)
 	line = bts->oml_link->ts->line;
 	e1inp_sign_link_destroy(bts->oml_link);
 	bts->oml_link = NULL;
+	abis_nm_queue_reset(bts);
 
 	e1inp_sign_link_destroy(bts->c0->rsl_link);
 	bts->c0->rsl_link = NULL;
@@ -514,6 +514,7 @@ void ipaccess_drop_oml(struct gsm_bts *bts)
 
 	e1inp_sign_link_destroy(bts->oml_link);
 	bts->oml_link = NULL;
+	abis_nm_queue_reset(bts);
 
 	/* we have issues reconnecting RSL, drop everything. */
 	llist_for_each_entry(trx, &bts->trx_list, list)
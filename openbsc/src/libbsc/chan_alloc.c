@@ -318,11 +318,7 @@ void lchan_free(struct gsm_lchan *lchan)
 	osmo_timer_del(&lchan->T3101);
 
 	/* clear cached measuement reports */
-	lchan->meas_rep_idx = 0;
-	for (i = 0; i < ARRAY_SIZE(lchan->meas_rep); i++) {
-		lchan->meas_rep[i].flags = 0;
-		lchan->meas_rep[i].nr = 0;
-	}
+	lchan_reset_meas_rep(lchan);
 	for (i = 0; i < ARRAY_SIZE(lchan->neigh_meas); i++)
 		lchan->neigh_meas[i].arfcn = 0;
 
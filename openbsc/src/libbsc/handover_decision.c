@@ -70,25 +70,6 @@ static int rxlev_for_cell_in_rep(struct gsm_meas_rep *mr,
 	return -ENODEV;
 }
 
-/* obtain averaged rxlev for given neighbor */
-static int neigh_meas_avg(struct neigh_meas_proc *nmp, int window)
-{
-	unsigned int i, idx;
-	int avg = 0;
-
-	idx = calc_initial_idx(ARRAY_SIZE(nmp->rxlev),
-				nmp->rxlev_cnt % ARRAY_SIZE(nmp->rxlev),
-				window);
-
-	for (i = 0; i < window; i++) {
-		int j = (idx+i) % ARRAY_SIZE(nmp->rxlev);
-
-		avg += nmp->rxlev[j];
-	}
-
-	return avg / window;
-}
-
 /* find empty or evict bad neighbor */
 static struct neigh_meas_proc *find_evict_neigh(struct gsm_lchan *lchan)
 {
@@ -118,12 +99,11 @@ static struct neigh_meas_proc *find_evict_neigh(struct gsm_lchan *lchan)
 /* process neighbor cell measurement reports */
 static void process_meas_neigh(struct gsm_meas_rep *mr)
 {
-	int i, j, idx;
+	int i, j;
 
 	/* for each reported cell, try to update global state */
 	for (j = 0; j < ARRAY_SIZE(mr->lchan->neigh_meas); j++) {
 		struct neigh_meas_proc *nmp = &mr->lchan->neigh_meas[j];
-		unsigned int idx;
 		int rxlev;
 
 		/* skip unused entries */
@@ -131,13 +111,11 @@ static void process_meas_neigh(struct gsm_meas_rep *mr)
 			continue;
 
 		rxlev = rxlev_for_cell_in_rep(mr, nmp->arfcn, nmp->bsic);
-		idx = nmp->rxlev_cnt % ARRAY_SIZE(nmp->rxlev);
 		if (rxlev >= 0) {
-			nmp->rxlev[idx] = rxlev;
+			neigh_meas_add(nmp, rxlev);
 			nmp->last_seen_nr = mr->nr;
 		} else
-			nmp->rxlev[idx] = 0;
-		nmp->rxlev_cnt++;
+			neigh_meas_add(nmp, 0);
 	}
 
 	/* iterate over list of reported cells, check if we did not
@@ -154,9 +132,7 @@ static void process_meas_neigh(struct gsm_meas_rep *mr)
 		nmp->arfcn = mrc->arfcn;
 		nmp->bsic = mrc->bsic;
 
-		idx = nmp->rxlev_cnt % ARRAY_SIZE(nmp->rxlev);
-		nmp->rxlev[idx] = mrc->rxlev;
-		nmp->rxlev_cnt++;
+		neigh_meas_add(nmp, mrc->rxlev);
 		nmp->last_seen_nr = mr->nr;
 
 		mrc->flags |= MRC_F_PROCESSED;
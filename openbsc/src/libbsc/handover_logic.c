@@ -38,46 +38,105 @@
 #include <openbsc/chan_alloc.h>
 #include <openbsc/signal.h>
 #include <osmocom/core/talloc.h>
+#include <osmocom/core/rate_ctr.h>
 #include <openbsc/transaction.h>
 #include <openbsc/rtp_proxy.h>
+#include <openbsc/handover.h>
 
 struct bsc_handover {
-	struct llist_head list;
-
 	struct gsm_lchan *old_lchan;
 	struct gsm_lchan *new_lchan;
 
 	struct osmo_timer_list T3103;
 
+	/* counters of the source/target BTS pair */
+	struct rate_ctr_group *ctrg;
+
 	uint8_t ho_ref;
 };
 
-static LLIST_HEAD(bsc_handovers);
+static const struct rate_ctr_desc ho_ctr_description[] = {
+	[BSC_HO_CTR_ATTEMPTED]	= { "handover.attempted",  "Handovers attempted       " },
+	[BSC_HO_CTR_NO_CHANNEL]	= { "handover.no_channel", "No channel in target cell " },
+	[BSC_HO_CTR_TIMEOUT]	= { "handover.timeout",    "T3103 expired             " },
+	[BSC_HO_CTR_COMPLETED]	= { "handover.completed",  "HO COMPLETE received      " },
+	[BSC_HO_CTR_FAILED]	= { "handover.failed",     "HO FAIL received          " },
+};
+
+static const struct rate_ctr_group_desc ho_ctrg_desc = {
+	.group_name_prefix = "bsc.ho",
+	.group_description = "BSC Handover Statistics",
+	.num_ctr = ARRAY_SIZE(ho_ctr_description),
+	.ctr_desc = ho_ctr_description,
+};
 
+/* The record is referenced by both lchans, so the lookups for the
+ * signals below do not need to search. */
 static struct bsc_handover *bsc_ho_by_new_lchan(struct gsm_lchan *new_lchan)
 {
-	struct bsc_handover *ho;
+	struct bsc_handover *ho = new_lchan ? new_lchan->ho : NULL;
 
-	llist_for_each_entry(ho, &bsc_handovers, list) {
-		if (ho->new_lchan == new_lchan)
-			return ho;
-	}
+	if (ho && ho->new_lchan == new_lchan)
+		return ho;
 
 	return NULL;
 }
 
 static struct bsc_handover *bsc_ho_by_old_lchan(struct gsm_lchan *old_lchan)
 {
-	struct bsc_handover *ho;
+	struct bsc_handover *ho = old_lchan->ho;
 
-	llist_for_each_entry(ho, &bsc_handovers, list) {
-		if (ho->old_lchan == old_lchan)
-			return ho;
-	}
+	if (ho && ho->old_lchan == old_lchan)
+		return ho;
 
 	return NULL;
 }
 
+static void bsc_ho_free(struct bsc_handover *ho)
+{
+	osmo_timer_del(&ho->T3103);
+
+	if (ho->old_lchan->ho == ho)
+		ho->old_lchan->ho = NULL;
+	if (ho->new_lchan->ho == ho)
+		ho->new_lchan->ho = NULL;
+
+	talloc_free(ho);
+}
+
+/* find or create the counters for handovers from one BTS to another */
+static struct rate_ctr_group *bsc_ho_ctrg(struct gsm_bts *src,
+					  struct gsm_bts *dst)
+{
+	struct bsc_ho_stats *stats;
+
+	llist_for_each_entry(stats, &src->ho_stats, list) {
+		if (stats->target == dst)
+			return stats->ctrg;
+	}
+
+	stats = talloc_zero(src, struct bsc_ho_stats);
+	if (!stats)
+		return NULL;
+
+	stats->ctrg = rate_ctr_group_alloc(stats, &ho_ctrg_desc,
+					   (src->nr << 8) | dst->nr);
+	if (!stats->ctrg) {
+		talloc_free(stats);
+		return NULL;
+	}
+
+	stats->target = dst;
+	llist_add_tail(&stats->list, &src->ho_stats);
+	return stats->ctrg;
+}
+
+static void bsc_ho_ctr_inc(struct rate_ctr_group *ctrg, int ctr)
+{
+	if (ctrg)
+		rate_ctr_inc(&ctrg->ctr[ctr]);
+}
+
 /* Hand over the specified logical channel to the specified new BTS.
  * This is the main entry point for the actual handover algorithm,
  * after it has decided it wants to initiate HO to a specific BTS */
@@ -85,18 +144,21 @@ int bsc_handover_start(struct gsm_lchan *old_lchan, struct gsm_bts *bts)
 {
 	struct gsm_lchan *new_lchan;
 	struct bsc_handover *ho;
+	struct rate_ctr_group *ctrg;
 	static uint8_t ho_ref;
 	int rc;
 
 	/* don't attempt multiple handovers for the same lchan at
-	 * the same time */
-	if (bsc_ho_by_old_lchan(old_lchan))
+	 * the same time, nor from a lchan still being handed over to */
+	if (old_lchan->ho)
 		return -EBUSY;
 
 	DEBUGP(DHO, "(old_lchan on BTS %u, new BTS %u)\n",
 		old_lchan->ts->trx->bts->nr, bts->nr);
 
+	ctrg = bsc_ho_ctrg(old_lchan->ts->trx->bts, bts);
 	osmo_counter_inc(bts->network->stats.handover.attempted);
+	bsc_ho_ctr_inc(ctrg, BSC_HO_CTR_ATTEMPTED);
 
 	if (!old_lchan->conn) {
 		LOGP(DHO, LOGL_ERROR, "Old lchan lacks connection data.\n");
@@ -107,6 +169,7 @@ int bsc_handover_start(struct gsm_lchan *old_lchan, struct gsm_bts *bts)
 	if (!new_lchan) {
 		LOGP(DHO, LOGL_NOTICE, "No free channel\n");
 		osmo_counter_inc(bts->network->stats.handover.no_channel);
+		bsc_ho_ctr_inc(ctrg, BSC_HO_CTR_NO_CHANNEL);
 		return -ENOSPC;
 	}
 
@@ -118,6 +181,7 @@ int bsc_handover_start(struct gsm_lchan *old_lchan, struct gsm_bts *bts)
 	}
 	ho->old_lchan = old_lchan;
 	ho->new_lchan = new_lchan;
+	ho->ctrg = ctrg;
 	ho->ho_ref = ho_ref++;
 
 	/* copy some parameters from old lchan */
@@ -143,7 +207,8 @@ int bsc_handover_start(struct gsm_lchan *old_lchan, struct gsm_bts *bts)
 	}
 
 	rsl_lchan_set_state(new_lchan, LCHAN_S_ACT_REQ);
-	llist_add(&ho->list, &bsc_handovers);
+	old_lchan->ho = ho;
+	new_lchan->ho = ho;
 	/* we continue in the SS_LCHAN handler / ho_chan_activ_ack */
 
 	return 0;
@@ -170,9 +235,7 @@ void bsc_clear_handover(struct gsm_subscriber_connection *conn, int free_lchan)
 	if (free_lchan)
 		lchan_release(ho->new_lchan, 0, 1);
 
-	osmo_timer_del(&ho->T3103);
-	llist_del(&ho->list);
-	talloc_free(ho);
+	bsc_ho_free(ho);
 }
 
 /* T3103 expired: Handover has failed without HO COMPLETE or HO FAIL */
@@ -183,12 +246,12 @@ static void ho_T3103_cb(void *_ho)
 
 	DEBUGP(DHO, "HO T3103 expired\n");
 	osmo_counter_inc(net->stats.handover.timeout);
+	bsc_ho_ctr_inc(ho->ctrg, BSC_HO_CTR_TIMEOUT);
 
 	ho->new_lchan->conn->ho_lchan = NULL;
 	ho->new_lchan->conn = NULL;
 	lchan_release(ho->new_lchan, 0, 1);
-	llist_del(&ho->list);
-	talloc_free(ho);
+	bsc_ho_free(ho);
 }
 
 /* RSL has acknowledged activation of the new lchan */
@@ -236,8 +299,7 @@ static int ho_chan_activ_nack(struct gsm_lchan *new_lchan)
 
 	new_lchan->conn->ho_lchan = NULL;
 	new_lchan->conn = NULL;
-	llist_del(&ho->list);
-	talloc_free(ho);
+	bsc_ho_free(ho);
 
 	/* FIXME: maybe we should try to allocate a new LCHAN here? */
 
@@ -263,6 +325,7 @@ static int ho_gsm48_ho_compl(struct gsm_lchan *new_lchan)
 	     ho->old_lchan->ts->trx->arfcn, new_lchan->ts->trx->arfcn);
 
 	osmo_counter_inc(net->stats.handover.completed);
+	bsc_ho_ctr_inc(ho->ctrg, BSC_HO_CTR_COMPLETED);
 
 	osmo_timer_del(&ho->T3103);
 
@@ -282,8 +345,7 @@ static int ho_gsm48_ho_compl(struct gsm_lchan *new_lchan)
 
 	/* do something to re-route the actual speech frames ! */
 
-	llist_del(&ho->list);
-	talloc_free(ho);
+	bsc_ho_free(ho);
 
 	return 0;
 }
@@ -301,16 +363,14 @@ static int ho_gsm48_ho_fail(struct gsm_lchan *old_lchan)
 	}
 
 	osmo_counter_inc(net->stats.handover.failed);
-
-	osmo_timer_del(&ho->T3103);
-	llist_del(&ho->list);
+	bsc_ho_ctr_inc(ho->ctrg, BSC_HO_CTR_FAILED);
 
 	/* release the channel and forget about it */
 	ho->new_lchan->conn->ho_lchan = NULL;
 	ho->new_lchan->conn = NULL;
 	lchan_release(ho->new_lchan, 0, 1);
 
-	talloc_free(ho);
+	bsc_ho_free(ho);
 
 	return 0;
 }
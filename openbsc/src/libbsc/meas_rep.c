@@ -23,32 +23,6 @@
 #include <openbsc/gsm_data.h>
 #include <openbsc/meas_rep.h>
 
-static int get_field(const struct gsm_meas_rep *rep,
-		     enum meas_rep_field field)
-{
-	switch (field) {
-	case MEAS_REP_DL_RXLEV_FULL:
-		return rep->dl.full.rx_lev;
-	case MEAS_REP_DL_RXLEV_SUB:
-		return rep->dl.sub.rx_lev;
-	case MEAS_REP_DL_RXQUAL_FULL:
-		return rep->dl.full.rx_qual;
-	case MEAS_REP_DL_RXQUAL_SUB:
-		return rep->dl.sub.rx_qual;
-	case MEAS_REP_UL_RXLEV_FULL:
-		return rep->ul.full.rx_lev;
-	case MEAS_REP_UL_RXLEV_SUB:
-		return rep->ul.sub.rx_lev;
-	case MEAS_REP_UL_RXQUAL_FULL:
-		return rep->ul.full.rx_qual;
-	case MEAS_REP_UL_RXQUAL_SUB:
-		return rep->ul.sub.rx_qual;
-	}
-
-	return 0;
-}
-
-
 unsigned int calc_initial_idx(unsigned int array_size,
 			      unsigned int meas_rep_idx,
 			      unsigned int num_values)
@@ -71,6 +45,7 @@ unsigned int calc_initial_idx(unsigned int array_size,
 int get_meas_rep_avg(const struct gsm_lchan *lchan,
 		     enum meas_rep_field field, unsigned int num)
 {
+	const struct gsm_meas_rep_sums *sums = &lchan->meas_sums;
 	unsigned int i, idx;
 	int avg = 0;
 
@@ -80,10 +55,13 @@ int get_meas_rep_avg(const struct gsm_lchan *lchan,
 	idx = calc_initial_idx(ARRAY_SIZE(lchan->meas_rep),
 				lchan->meas_rep_idx, num);
 
+	if (!sums->pending && num <= ARRAY_SIZE(lchan->meas_rep))
+		return (sums->sum[field] - sums->sum_before[idx][field]) / num;
+
 	for (i = 0; i < num; i++) {
 		int j = (idx+i) % ARRAY_SIZE(lchan->meas_rep);
 
-		avg += get_field(&lchan->meas_rep[j], field);
+		avg += meas_rep_get_field(&lchan->meas_rep[j], field);
 	}
 
 	return avg / num;
@@ -94,15 +72,26 @@ int meas_rep_n_out_of_m_be(const struct gsm_lchan *lchan,
 			enum meas_rep_field field,
 			unsigned int n, unsigned int m, int be)
 {
+	const struct gsm_meas_rep_sums *sums = &lchan->meas_sums;
 	unsigned int i, idx;
 	int count = 0;
 
 	idx = calc_initial_idx(ARRAY_SIZE(lchan->meas_rep),
 				lchan->meas_rep_idx, m);
 
+	if (!sums->pending && m >= 1 && m <= ARRAY_SIZE(lchan->meas_rep)
+	    && be <= MEAS_REP_MAX_BE) {
+		/* every value is >= 0, including the unused slots */
+		if (be <= 0)
+			return m >= n;
+		count = (uint8_t) (sums->ge[field][be]
+				   - sums->ge_before[idx][field][be]);
+		return count >= n;
+	}
+
 	for (i = 0; i < m; i++) {
 		int j = (idx + i) % ARRAY_SIZE(lchan->meas_rep);
-		int val = get_field(&lchan->meas_rep[j], field);
+		int val = meas_rep_get_field(&lchan->meas_rep[j], field);
 
 		if (val >= be)
 			count++;
@@ -113,3 +102,25 @@ int meas_rep_n_out_of_m_be(const struct gsm_lchan *lchan,
 
 	return 0;
 }
+
+void neigh_meas_add(struct neigh_meas_proc *nmp, uint8_t rxlev)
+{
+	unsigned int idx = nmp->rxlev_cnt % ARRAY_SIZE(nmp->rxlev);
+
+	nmp->rxlev[idx] = rxlev;
+	nmp->rxlev_sum_before[idx] = nmp->rxlev_sum;
+	nmp->rxlev_sum += rxlev;
+	nmp->rxlev_cnt++;
+}
+
+/* obtain averaged rxlev for given neighbor */
+int neigh_meas_avg(const struct neigh_meas_proc *nmp, int window)
+{
+	unsigned int idx;
+
+	idx = calc_initial_idx(ARRAY_SIZE(nmp->rxlev),
+				nmp->rxlev_cnt % ARRAY_SIZE(nmp->rxlev),
+				window);
+
+	return (nmp->rxlev_sum - nmp->rxlev_sum_before[idx]) / window;
+}
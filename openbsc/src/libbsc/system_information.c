@@ -27,6 +27,7 @@
 
 #include <osmocom/core/bitvec.h>
 #include <osmocom/core/utils.h>
+#include <osmocom/gsm/gsm_utils.h>
 #include <osmocom/gsm/sysinfo.h>
 
 #include <openbsc/debug.h>
@@ -514,3 +515,219 @@ int gsm_generate_si(struct gsm_bts *bts, enum osmo_sysinfo_type si_type)
 
 	return gen_si(bts->si_buf[si_type], bts);
 }
+
+/* (re)generate one SI type, the result is the length of the SI */
+static int generate_si(struct gsm_bts *bts, enum osmo_sysinfo_type i)
+{
+	int rc;
+
+	/* Only generate SI if this SI is not in "static" (user-defined) mode */
+	if (bts->si_mode_static & (1 << i))
+		rc = sizeof(bts->si_buf[i]);
+	else
+		rc = gsm_generate_si(bts, i);
+	if (rc < 0)
+		return rc;
+
+	DEBUGP(DRR, "SI%s: %s\n", get_value_string(osmo_sitype_strs, i),
+		osmo_hexdump(GSM_BTS_SI(bts, i), GSM_MACBLOCK_LEN));
+	return rc;
+}
+
+static int rsl_si(struct gsm_bts_trx *trx, enum osmo_sysinfo_type i, int si_len)
+{
+	struct gsm_bts *bts = trx->bts;
+	int rc = 0, j;
+
+	switch (i) {
+	case SYSINFO_TYPE_5:
+	case SYSINFO_TYPE_5bis:
+	case SYSINFO_TYPE_5ter:
+	case SYSINFO_TYPE_6:
+		if (trx->bts->type == GSM_BTS_TYPE_HSL_FEMTO) {
+			/* HSL has mistaken SACCH INFO MODIFY for SACCH FILLING,
+			 * so we need a special workaround here */
+			/* This assumes a combined BCCH and TCH on TS1...7 */
+			for (j = 0; j < 4; j++)
+				rsl_sacch_info_modify(&trx->ts[0].lchan[j],
+						      osmo_sitype2rsl(i),
+						      GSM_BTS_SI(bts, i), si_len);
+			for (j = 1; j < 8; j++) {
+				rsl_sacch_info_modify(&trx->ts[j].lchan[0],
+						      osmo_sitype2rsl(i),
+						      GSM_BTS_SI(bts, i), si_len);
+				rsl_sacch_info_modify(&trx->ts[j].lchan[1],
+						      osmo_sitype2rsl(i),
+						      GSM_BTS_SI(bts, i), si_len);
+			}
+		} else
+			rc = rsl_sacch_filling(trx, osmo_sitype2rsl(i),
+					       GSM_BTS_SI(bts, i), si_len);
+		break;
+	default:
+		rc = rsl_bcch_info(trx, osmo_sitype2rsl(i),
+				   GSM_BTS_SI(bts, i), si_len);
+		break;
+	}
+
+	return rc;
+}
+
+/* FNV-1a of the encoded SI, never 0 as that means "not sent" */
+static uint32_t si_hash(const uint8_t *data, int len)
+{
+	uint32_t hash = 2166136261u;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= data[i];
+		hash *= 16777619u;
+	}
+
+	return hash ? hash : 1;
+}
+
+static void si_update_common(struct gsm_bts *bts)
+{
+	bts->si_common.cell_sel_par.ms_txpwr_max_ccch =
+			ms_pwr_ctl_lvl(bts->band, bts->ms_max_power);
+	bts->si_common.cell_sel_par.neci = bts->network->neci;
+}
+
+/* set all system information types */
+int gsm_bts_trx_set_system_infos(struct gsm_bts_trx *trx)
+{
+	int i, rc;
+	struct gsm_bts *bts = trx->bts;
+
+	si_update_common(bts);
+
+	/* First, we determine which of the SI messages we actually need */
+
+	if (trx == bts->c0) {
+		/* 1...4 are always present on a C0 TRX */
+		for (i = SYSINFO_TYPE_1; i <= SYSINFO_TYPE_4; i++)
+			bts->si_valid |= (1 << i);
+
+		/* 13 is always present on a C0 TRX of a GPRS BTS */
+		if (bts->gprs.mode != BTS_GPRS_NONE)
+			bts->si_valid |= (1 << SYSINFO_TYPE_13);
+	}
+
+	/* 5 and 6 are always present on every TRX */
+	bts->si_valid |= (1 << SYSINFO_TYPE_5);
+	bts->si_valid |= (1 << SYSINFO_TYPE_6);
+
+	/* Second, we generate and send the selected SI via RSL */
+	for (i = SYSINFO_TYPE_1; i < _MAX_SYSINFO_TYPE; i++) {
+		int si_len;
+
+		trx->si_sent_hash[i] = 0;
+		if (!(bts->si_valid & (1 << i)))
+			continue;
+
+		rc = generate_si(bts, i);
+		if (rc < 0)
+			goto err_out;
+		si_len = rc;
+
+		rc = rsl_si(trx, i, si_len);
+		if (rc < 0)
+			goto err_out;
+		trx->si_sent_hash[i] = si_hash(GSM_BTS_SI(bts, i), si_len);
+	}
+
+	return 0;
+err_out:
+	LOGP(DRR, LOGL_ERROR, "Cannot generate SI %u for BTS %u, most likely "
+		"a problem with neighbor cell list generation\n",
+		i, bts->nr);
+	return rc;
+}
+
+int gsm_bts_set_system_infos(struct gsm_bts *bts)
+{
+	struct gsm_bts_trx *trx;
+	uint32_t hash[_MAX_SYSINFO_TYPE];
+	int len[_MAX_SYSINFO_TYPE];
+	uint32_t dirty;
+	int i, rc, sent = 0;
+
+	if (osmo_timer_pending(&bts->si_timer))
+		osmo_timer_del(&bts->si_timer);
+
+	dirty = bts->si_dirty & bts->si_valid;
+	bts->si_dirty = 0;
+	if (!dirty)
+		return 0;
+
+	si_update_common(bts);
+
+	/* regenerate each dirty SI once for the whole BTS */
+	for (i = SYSINFO_TYPE_1; i < _MAX_SYSINFO_TYPE; i++) {
+		if (!(dirty & (1 << i)))
+			continue;
+
+		len[i] = generate_si(bts, i);
+		if (len[i] < 0) {
+			LOGP(DRR, LOGL_ERROR, "Cannot generate SI %u for "
+			     "BTS %u\n", i, bts->nr);
+			dirty &= ~(1 << i);
+			continue;
+		}
+		hash[i] = si_hash(GSM_BTS_SI(bts, i), len[i]);
+	}
+
+	/* and only send what differs from what a TRX has */
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		int nokia_begun = 0;
+
+		if (!trx->rsl_link)
+			continue;
+
+		for (i = SYSINFO_TYPE_1; i < _MAX_SYSINFO_TYPE; i++) {
+			if (!(dirty & (1 << i)))
+				continue;
+			/* only refresh what the TRX carries, 0 is never sent */
+			if (!trx->si_sent_hash[i] || trx->si_sent_hash[i] == hash[i])
+				continue;
+
+			if (bts->type == GSM_BTS_TYPE_NOKIA_SITE && !nokia_begun) {
+				rsl_nokia_si_begin(trx);
+				nokia_begun = 1;
+			}
+
+			rc = rsl_si(trx, i, len[i]);
+			if (rc < 0) {
+				trx->si_sent_hash[i] = 0;
+				continue;
+			}
+			trx->si_sent_hash[i] = hash[i];
+			sent += 1;
+		}
+
+		if (nokia_begun)
+			rsl_nokia_si_end(trx);
+	}
+
+	if (sent)
+		LOGP(DRR, LOGL_INFO, "BTS %u: resent %d SI\n", bts->nr, sent);
+	return sent;
+}
+
+static void si_timer_cb(void *data)
+{
+	gsm_bts_set_system_infos(data);
+}
+
+void gsm_bts_si_changed(struct gsm_bts *bts, uint32_t si_mask)
+{
+	bts->si_dirty |= si_mask;
+
+	if (osmo_timer_pending(&bts->si_timer))
+		return;
+
+	bts->si_timer.cb = si_timer_cb;
+	bts->si_timer.data = bts;
+	osmo_timer_schedule(&bts->si_timer, 1, 0);
+}
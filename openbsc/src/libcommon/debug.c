@@ -232,3 +232,37 @@ void log_set_bvc_filter(struct log_target *target, struct bssgp_bvc_ctx *bctx)
 		target->filter_data[FLT_BVC] = NULL;
 	}
 }
+
+/*
+ * Check if any log target would print a message of the given subsystem
+ * and level. This allows to skip expensive argument formatting like hex
+ * dumps of every message when nobody is going to see them. Context
+ * filters are not evaluated, a message that would be filtered might
+ * still be reported as enabled.
+ */
+int log_level_enabled(int subsys, unsigned int level)
+{
+	struct log_target *tar;
+
+	/* map the library subsystems like logging.c does */
+	if (subsys < 0)
+		subsys = osmo_log_info->num_cat_user - subsys - 1;
+	if (subsys >= osmo_log_info->num_cat)
+		subsys = 0;
+
+	llist_for_each_entry(tar, &osmo_log_target_list, entry) {
+		struct log_category *category = &tar->categories[subsys];
+
+		if (!category->enabled)
+			continue;
+		/* global log level first, the category one otherwise */
+		if (tar->loglevel != 0 && level < tar->loglevel)
+			continue;
+		if (tar->loglevel == 0 && category->loglevel != 0 &&
+		    level < category->loglevel)
+			continue;
+		return 1;
+	}
+
+	return 0;
+}
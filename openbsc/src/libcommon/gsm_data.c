@@ -74,6 +74,7 @@ struct gsm_network *gsm_network_init(uint16_t country_code, uint16_t network_cod
 				     int (*mncc_recv)(struct gsm_network *, struct msgb *))
 {
 	struct gsm_network *net;
+	int i;
 
 	net = talloc_zero(tall_bsc_ctx, struct gsm_network);
 	if (!net)
@@ -107,6 +108,8 @@ struct gsm_network *gsm_network_init(uint16_t country_code, uint16_t network_cod
 	INIT_LLIST_HEAD(&net->trans_list);
 	INIT_LLIST_HEAD(&net->upqueue);
 	INIT_LLIST_HEAD(&net->bts_list);
+	for (i = 0; i < ARRAY_SIZE(net->bts_hash); i++)
+		INIT_LLIST_HEAD(&net->bts_hash[i]);
 
 	net->stats.chreq.total = osmo_counter_alloc("net.chreq.total");
 	net->stats.chreq.no_channel = osmo_counter_alloc("net.chreq.no_channel");
@@ -168,6 +171,22 @@ struct gsm_bts *gsm_bts_num(struct gsm_network *net, int num)
 	return NULL;
 }
 
+static unsigned int bts_neigh_hash(uint16_t arfcn, uint8_t bsic)
+{
+	uint32_t key = (arfcn << 6) | (bsic & 0x3f);
+
+	return (key * 2654435761u) >> 24;
+}
+
+void gsm_bts_rehash(struct gsm_bts *bts)
+{
+	struct llist_head *bucket;
+
+	bucket = &bts->network->bts_hash[bts_neigh_hash(bts->c0->arfcn, bts->bsic)];
+	llist_del(&bts->hash_list);
+	llist_add_tail(&bts->hash_list, bucket);
+}
+
 /* Get reference to a neighbor cell on a given BCCH ARFCN */
 struct gsm_bts *gsm_bts_neighbor(const struct gsm_bts *bts,
 				 uint16_t arfcn, uint8_t bsic)
@@ -178,7 +197,8 @@ struct gsm_bts *gsm_bts_neighbor(const struct gsm_bts *bts,
 	 * now we simply assume that each ARFCN will only be used by one
 	 * cell */
 
-	llist_for_each_entry(neigh, &bts->network->bts_list, list) {
+	llist_for_each_entry(neigh, &bts->network->bts_hash[bts_neigh_hash(arfcn, bsic)],
+			     hash_list) {
 		if (neigh->c0->arfcn == arfcn &&
 		    neigh->bsic == bsic)
 			return neigh;
@@ -297,15 +317,53 @@ const char *bts_gprs_mode_name(enum bts_gprs_mode mode)
 	return get_value_string(bts_gprs_mode_names, mode);
 }
 
+/* add the last report to the running sums used by get_meas_rep_avg() */
+void lchan_commit_meas_rep(struct gsm_lchan *lchan)
+{
+	struct gsm_meas_rep_sums *sums = &lchan->meas_sums;
+	unsigned int idx;
+	int field, val, be;
+
+	if (!sums->pending)
+		return;
+	sums->pending = 0;
+
+	idx = (lchan->meas_rep_idx + ARRAY_SIZE(lchan->meas_rep) - 1)
+					% ARRAY_SIZE(lchan->meas_rep);
+
+	for (field = 0; field < MEAS_REP_NUM_FIELDS; field++) {
+		val = meas_rep_get_field(&lchan->meas_rep[idx], field);
+
+		sums->sum_before[idx][field] = sums->sum[field];
+		sums->sum[field] += val;
+
+		memcpy(sums->ge_before[idx][field], sums->ge[field],
+		       sizeof(sums->ge[field]));
+		for (be = 1; be <= MEAS_REP_MAX_BE && be <= val; be++)
+			sums->ge[field][be] += 1;
+	}
+}
+
+void lchan_reset_meas_rep(struct gsm_lchan *lchan)
+{
+	lchan->meas_rep_idx = 0;
+	memset(lchan->meas_rep, 0, sizeof(lchan->meas_rep));
+	memset(&lchan->meas_sums, 0, sizeof(lchan->meas_sums));
+}
+
 struct gsm_meas_rep *lchan_next_meas_rep(struct gsm_lchan *lchan)
 {
 	struct gsm_meas_rep *meas_rep;
 
+	/* the previous report is complete by now */
+	lchan_commit_meas_rep(lchan);
+
 	meas_rep = &lchan->meas_rep[lchan->meas_rep_idx];
 	memset(meas_rep, 0, sizeof(*meas_rep));
 	meas_rep->lchan = lchan;
 	lchan->meas_rep_idx = (lchan->meas_rep_idx + 1)
 					% ARRAY_SIZE(lchan->meas_rep);
+	lchan->meas_sums.pending = 1;
 
 	return meas_rep;
 }
@@ -397,8 +455,12 @@ struct gsm_bts *gsm_bts_alloc_register(struct gsm_network *net, enum gsm_bts_typ
 	bts->si_common.rach_control.t2 = 4; /* no emergency calls */
 
 	llist_add_tail(&bts->list, &net->bts_list);
+	INIT_LLIST_HEAD(&bts->hash_list);
+	gsm_bts_rehash(bts);
 
 	INIT_LLIST_HEAD(&bts->abis_queue);
+	bts->abis_nm_window = 1;
+	INIT_LLIST_HEAD(&bts->ho_stats);
 
 	return bts;
 }
@@ -0,0 +1,272 @@
+/* Always-on binary trace of signalling PDUs */
+
+/* (C) 2012 by the OpenBSC project
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/gsmtap.h>
+
+#include <openbsc/pdu_trace.h>
+
+/*
+ * The ring consists of fixed size slots. Recording a PDU is a copy of
+ * at most snaplen bytes and some bookkeeping, nothing is formatted and
+ * nothing is allocated. The pcap file is only built when requested.
+ */
+struct pdu_trace_entry {
+	struct timeval tv;
+	uint32_t entity;
+	uint16_t caplen;
+	uint16_t len;
+	uint8_t proto;
+	uint8_t dir;
+};
+
+static struct {
+	struct pdu_trace_entry *entries;
+	uint8_t *data;
+	unsigned int nr_entries;
+	unsigned int snaplen;
+	unsigned int next;
+	unsigned long long recorded;
+} trace;
+
+/* pcap file format, using raw IPv4 as link type */
+#define PCAP_MAGIC		0xa1b2c3d4
+#define PCAP_LINKTYPE_RAW	101
+
+/* UDP ports wireshark uses to pick the dissector */
+#define UDP_PORT_IPA		3006
+#define UDP_PORT_NS		23000
+
+struct pcap_file_hdr {
+	uint32_t magic;
+	uint16_t version_major;
+	uint16_t version_minor;
+	int32_t thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t linktype;
+};
+
+struct pcap_rec_hdr {
+	uint32_t ts_sec;
+	uint32_t ts_usec;
+	uint32_t incl_len;
+	uint32_t orig_len;
+};
+
+int pdu_trace_init(void *ctx, unsigned int nr_entries, unsigned int snaplen)
+{
+	talloc_free(trace.entries);
+	talloc_free(trace.data);
+	memset(&trace, 0, sizeof(trace));
+
+	if (nr_entries == 0 || snaplen == 0)
+		return 0;
+
+	trace.entries = talloc_zero_array(ctx, struct pdu_trace_entry, nr_entries);
+	trace.data = talloc_size(ctx, nr_entries * snaplen);
+	if (!trace.entries || !trace.data) {
+		talloc_free(trace.entries);
+		talloc_free(trace.data);
+		memset(&trace, 0, sizeof(trace));
+		return -ENOMEM;
+	}
+
+	trace.nr_entries = nr_entries;
+	trace.snaplen = snaplen;
+	return 0;
+}
+
+void pdu_trace_record(uint8_t proto, uint8_t dir, uint32_t entity,
+		      const uint8_t *data, unsigned int len)
+{
+	struct pdu_trace_entry *entry;
+	unsigned int caplen;
+
+	if (!trace.nr_entries)
+		return;
+
+	entry = &trace.entries[trace.next];
+	caplen = len > trace.snaplen ? trace.snaplen : len;
+
+	gettimeofday(&entry->tv, NULL);
+	entry->entity = entity;
+	entry->caplen = caplen;
+	entry->len = len > 0xffff ? 0xffff : len;
+	entry->proto = proto;
+	entry->dir = dir;
+	memcpy(&trace.data[trace.next * trace.snaplen], data, caplen);
+
+	if (++trace.next == trace.nr_entries)
+		trace.next = 0;
+	trace.recorded += 1;
+}
+
+void pdu_trace_clear(void)
+{
+	trace.next = 0;
+	trace.recorded = 0;
+}
+
+void pdu_trace_get_stats(struct pdu_trace_stats *stats)
+{
+	stats->entries = trace.nr_entries;
+	stats->snaplen = trace.snaplen;
+	stats->recorded = trace.recorded;
+	stats->used = trace.recorded < trace.nr_entries ?
+			trace.recorded : trace.nr_entries;
+}
+
+static uint16_t ip_checksum(const uint8_t *hdr, unsigned int len)
+{
+	uint32_t sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < len; i += 2)
+		sum += (hdr[i] << 8) | hdr[i + 1];
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return ~sum & 0xffff;
+}
+
+/*
+ * Wrap the PDU into IPv4/UDP so wireshark can decode it. The entity
+ * ends up in the addresses, 127.x.y.z is the peer and 127.0.0.1 us.
+ */
+static int write_entry(FILE *file, struct pdu_trace_entry *entry,
+		       const uint8_t *data)
+{
+	uint8_t hdr[20 + 8 + sizeof(struct gsmtap_hdr)];
+	struct pcap_rec_hdr rec;
+	uint32_t peer, local;
+	uint16_t port, csum;
+	unsigned int hdr_len = 20 + 8;
+	unsigned int len;
+
+	switch (entry->proto) {
+	case PDU_TRACE_RSL:
+		port = GSMTAP_UDP_PORT;
+		hdr_len += sizeof(struct gsmtap_hdr);
+		break;
+	case PDU_TRACE_IPA:
+		port = UDP_PORT_IPA;
+		break;
+	case PDU_TRACE_NS:
+		port = UDP_PORT_NS;
+		break;
+	default:
+		return 0;
+	}
+
+	memset(hdr, 0, sizeof(hdr));
+	len = hdr_len + entry->caplen;
+	peer = htonl(0x7f000000 | ((entry->entity + 2) & 0x00ffffff));
+	local = htonl(0x7f000001);
+
+	/* IPv4 */
+	hdr[0] = 0x45;
+	hdr[2] = len >> 8;
+	hdr[3] = len & 0xff;
+	hdr[8] = 64;
+	hdr[9] = 17;
+	if (entry->dir == PDU_TRACE_RX) {
+		memcpy(&hdr[12], &peer, 4);
+		memcpy(&hdr[16], &local, 4);
+	} else {
+		memcpy(&hdr[12], &local, 4);
+		memcpy(&hdr[16], &peer, 4);
+	}
+	csum = ip_checksum(hdr, 20);
+	hdr[10] = csum >> 8;
+	hdr[11] = csum & 0xff;
+
+	/* UDP without checksum */
+	hdr[20] = port >> 8;
+	hdr[21] = port & 0xff;
+	hdr[22] = port >> 8;
+	hdr[23] = port & 0xff;
+	hdr[24] = (len - 20) >> 8;
+	hdr[25] = (len - 20) & 0xff;
+
+	if (entry->proto == PDU_TRACE_RSL) {
+		struct gsmtap_hdr *gh = (struct gsmtap_hdr *) &hdr[28];
+		gh->version = GSMTAP_VERSION;
+		gh->hdr_len = sizeof(*gh) / 4;
+		gh->type = GSMTAP_TYPE_ABIS;
+	}
+
+	rec.ts_sec = entry->tv.tv_sec;
+	rec.ts_usec = entry->tv.tv_usec;
+	rec.incl_len = len;
+	rec.orig_len = hdr_len + entry->len;
+
+	if (fwrite(&rec, sizeof(rec), 1, file) != 1
+	    || fwrite(hdr, hdr_len, 1, file) != 1
+	    || fwrite(data, entry->caplen, 1, file) != 1)
+		return -EIO;
+
+	return 0;
+}
+
+int pdu_trace_write_pcap(const char *filename)
+{
+	struct pcap_file_hdr fhdr;
+	unsigned int i, used, idx;
+	FILE *file;
+	int rc = 0;
+
+	file = fopen(filename, "w");
+	if (!file)
+		return -errno;
+
+	memset(&fhdr, 0, sizeof(fhdr));
+	fhdr.magic = PCAP_MAGIC;
+	fhdr.version_major = 2;
+	fhdr.version_minor = 4;
+	fhdr.snaplen = 65535;
+	fhdr.linktype = PCAP_LINKTYPE_RAW;
+	if (fwrite(&fhdr, sizeof(fhdr), 1, file) != 1) {
+		fclose(file);
+		return -EIO;
+	}
+
+	/* oldest entry first */
+	used = trace.recorded < trace.nr_entries ?
+			trace.recorded : trace.nr_entries;
+	idx = used < trace.nr_entries ? 0 : trace.next;
+
+	for (i = 0; i < used && rc == 0; ++i) {
+		rc = write_entry(file, &trace.entries[idx],
+				 &trace.data[idx * trace.snaplen]);
+		if (++idx == trace.nr_entries)
+			idx = 0;
+	}
+
+	if (fclose(file) != 0 && rc == 0)
+		rc = -EIO;
+	return rc;
+}
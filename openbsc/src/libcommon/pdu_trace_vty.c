@@ -0,0 +1,81 @@
+/* VTY interface for the binary PDU trace */
+
+/* (C) 2012 by the OpenBSC project
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include <openbsc/pdu_trace.h>
+
+#include <osmocom/vty/command.h>
+#include <osmocom/vty/vty.h>
+
+#define PDU_TRACE_STR "Binary trace of signalling PDUs\n"
+
+DEFUN(show_pdu_trace, show_pdu_trace_cmd,
+      "show pdu-trace",
+      SHOW_STR PDU_TRACE_STR)
+{
+	struct pdu_trace_stats stats;
+
+	pdu_trace_get_stats(&stats);
+	if (!stats.entries) {
+		vty_out(vty, "PDU trace is disabled%s", VTY_NEWLINE);
+		return CMD_SUCCESS;
+	}
+
+	vty_out(vty, "PDU trace with %u entries of %u bytes, %u in use%s",
+		stats.entries, stats.snaplen, stats.used, VTY_NEWLINE);
+	vty_out(vty, " %llu PDUs recorded since start/clear%s",
+		stats.recorded, VTY_NEWLINE);
+	return CMD_SUCCESS;
+}
+
+DEFUN(write_pdu_trace, write_pdu_trace_cmd,
+      "write pdu-trace FILENAME",
+      "Write running configuration or other data\n"
+      PDU_TRACE_STR "Name of the pcap file to write\n")
+{
+	int rc;
+
+	rc = pdu_trace_write_pcap(argv[0]);
+	if (rc < 0) {
+		vty_out(vty, "%% Failed to write %s: %s%s",
+			argv[0], strerror(-rc), VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(clear_pdu_trace, clear_pdu_trace_cmd,
+      "clear pdu-trace",
+      "Clear data\n" PDU_TRACE_STR)
+{
+	pdu_trace_clear();
+	return CMD_SUCCESS;
+}
+
+int pdu_trace_vty_init(void)
+{
+	install_element_ve(&show_pdu_trace_cmd);
+	install_element(ENABLE_NODE, &write_pdu_trace_cmd);
+	install_element(ENABLE_NODE, &clear_pdu_trace_cmd);
+
+	return 0;
+}
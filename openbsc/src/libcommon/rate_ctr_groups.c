@@ -0,0 +1,67 @@
+/* Walk the list of rate counter groups */
+/*
+ * (C) 2012 by the OpenBSC project
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stddef.h>
+
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/rate_ctr.h>
+
+#include <openbsc/rate_ctr_groups.h>
+
+/*
+ * libosmocore keeps the groups in a private list and offers no way to
+ * walk it. rate_ctr_group_alloc() adds a new group at the head of that
+ * list, so right after allocating a group of our own its predecessor
+ * is the list head. The anchor group has no counters and is skipped.
+ */
+static const struct rate_ctr_group_desc anchor_desc = {
+	.group_name_prefix = "bsc.anchor",
+	.group_description = "Anchor into the list of counter groups",
+	.num_ctr = 0,
+	.ctr_desc = NULL,
+};
+
+static struct llist_head *groups;
+
+int bsc_rate_ctr_for_each_group(int (*cb)(struct rate_ctr_group *ctrg,
+					  void *data),
+				void *data)
+{
+	struct rate_ctr_group *ctrg;
+	int rc;
+
+	if (!groups) {
+		ctrg = rate_ctr_group_alloc(NULL, &anchor_desc, 0);
+		if (!ctrg)
+			return -1;
+		groups = ctrg->list.prev;
+	}
+
+	/* the oldest group is at the tail */
+	llist_for_each_entry_reverse(ctrg, groups, list) {
+		if (ctrg->desc == &anchor_desc)
+			continue;
+		rc = cb(ctrg, data);
+		if (rc != 0)
+			return rc;
+	}
+
+	return 0;
+}
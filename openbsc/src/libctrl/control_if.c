@@ -23,6 +23,7 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -42,6 +43,7 @@
 #include <openbsc/debug.h>
 #include <openbsc/gsm_data.h>
 #include <openbsc/ipaccess.h>
+#include <openbsc/rate_ctr_groups.h>
 #include <openbsc/socket.h>
 #include <osmocom/abis/subchan_demux.h>
 
@@ -112,9 +114,9 @@ int ctrl_cmd_handle(struct ctrl_cmd *cmd, void *data)
 	if (!request)
 		goto err;
 
-	for (i=0;i<strlen(request);i++) {
-		if (request[i] == '.')
-			request[i] = ' ';
+	for (token = request; *token; token++) {
+		if (*token == '.')
+			*token = ' ';
 	}
 
 	vline = cmd_make_strvec(request);
@@ -359,55 +361,118 @@ static uint64_t get_rate_ctr_value(const struct rate_ctr *ctr, int intv)
 	}
 }
 
-static char *get_all_rate_ctr_in_group(const struct rate_ctr_group *ctrg, int intv)
+/*
+ * The counter dumps can contain thousands of lines. Append them to a
+ * buffer that keeps track of its length and grows geometrically instead
+ * of using talloc_asprintf_append, which needs to walk the whole string
+ * on every call.
+ */
+struct ctr_reply {
+	void *ctx;
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+static int ctr_reply_init(struct ctr_reply *rep, void *ctx, size_t size)
+{
+	rep->ctx = ctx;
+	rep->len = 0;
+	rep->size = size;
+	rep->buf = talloc_size(ctx, size);
+	if (!rep->buf)
+		return -1;
+	rep->buf[0] = '\0';
+	return 0;
+}
+
+static int ctr_reply_append(struct ctr_reply *rep, const char *fmt, ...)
+{
+	va_list ap;
+	int rc;
+
+	while (1) {
+		va_start(ap, fmt);
+		rc = vsnprintf(rep->buf + rep->len, rep->size - rep->len, fmt, ap);
+		va_end(ap);
+		if (rc < 0)
+			return -1;
+
+		if (rep->len + rc < rep->size) {
+			rep->len += rc;
+			return 0;
+		}
+
+		rep->size = (rep->len + rc + 1) * 2;
+		rep->buf = talloc_realloc_size(rep->ctx, rep->buf, rep->size);
+		if (!rep->buf)
+			return -1;
+	}
+}
+
+static int get_all_rate_ctr_in_group(struct ctr_reply *rep,
+				     const struct rate_ctr_group *ctrg, int intv)
 {
 	int i;
-	char *counters = talloc_strdup(tall_bsc_ctx, "");
-	if (!counters)
-		return NULL;
 
 	for (i=0;i<ctrg->desc->num_ctr;i++) {
-		counters = talloc_asprintf_append(counters, "\n%s.%u.%s %"PRIu64,
+		if (ctr_reply_append(rep, "\n%s.%u.%s %"PRIu64,
 			ctrg->desc->group_name_prefix, ctrg->idx,
 			ctrg->desc->ctr_desc[i].name,
-			get_rate_ctr_value(&ctrg->ctr[i], intv));
-		if (!counters)
-			return NULL;
+			get_rate_ctr_value(&ctrg->ctr[i], intv)) != 0)
+			return -1;
 	}
-	return counters;
+	return 0;
 }
 
-static int get_rate_ctr_group(const char *ctr_group, int intv, struct ctrl_cmd *cmd)
+/* a line is usually less than 64 bytes, avoid reallocations */
+#define CTR_REPLY_SIZE(ctrg)	(64 + (ctrg)->desc->num_ctr * 64)
+
+struct ctr_group_dump {
+	const char *name;
+	int intv;
+	int found;
+	struct ctr_reply *rep;
+};
+
+static int dump_rate_ctr_group(struct rate_ctr_group *ctrg, void *data)
 {
-	int i;
-	char *counters;
-	struct rate_ctr_group *ctrg;
+	struct ctr_group_dump *dump = data;
 
-	cmd->reply = talloc_asprintf(cmd, "All counters in group %s", ctr_group);
-	if (!cmd->reply)
-		goto oom;
+	if (strcmp(ctrg->desc->group_name_prefix, dump->name) != 0)
+		return 0;
 
-	for (i=0;;i++) {
-		ctrg = rate_ctr_get_group_by_name_idx(ctr_group, i);
-		if (!ctrg)
-			break;
+	dump->found += 1;
+	return get_all_rate_ctr_in_group(dump->rep, ctrg, dump->intv);
+}
 
-		counters = get_all_rate_ctr_in_group(ctrg, intv);
-		if (!counters)
-			goto oom;
+static int get_rate_ctr_group(const char *ctr_group, int intv, struct ctrl_cmd *cmd)
+{
+	struct ctr_reply rep;
+	struct ctr_group_dump dump = {
+		.name = ctr_group,
+		.intv = intv,
+		.found = 0,
+		.rep = &rep,
+	};
+
+	if (ctr_reply_init(&rep, cmd, 64) != 0)
+		goto oom;
+	if (ctr_reply_append(&rep, "All counters in group %s", ctr_group) != 0)
+		goto oom;
 
-		cmd->reply = talloc_asprintf_append(cmd->reply, "%s", counters);
-		talloc_free(counters);
-		if (!cmd->reply)
-			goto oom;
-	}
+	/* one walk over all groups, the instances are in allocation order */
+	if (bsc_rate_ctr_for_each_group(dump_rate_ctr_group, &dump) != 0)
+		goto oom;
 
 	/* We found no counter group by that name */
-	if (i == 0) {
+	if (dump.found == 0) {
+		talloc_free(rep.buf);
 		cmd->reply = talloc_asprintf(cmd, "No counter group with name %s.", ctr_group);
 		return CTRL_CMD_ERROR;
 	}
 
+	cmd->reply = rep.buf;
 	return CTRL_CMD_REPLY;
 oom:
 	cmd->reply = "OOM.";
@@ -416,25 +481,33 @@ oom:
 
 static int get_rate_ctr_group_idx(const struct rate_ctr_group *ctrg, int intv, struct ctrl_cmd *cmd)
 {
-	char *counters;
+	struct ctr_reply rep;
 
-	counters = get_all_rate_ctr_in_group(ctrg, intv);
-	if (!counters)
+	if (ctr_reply_init(&rep, cmd, CTR_REPLY_SIZE(ctrg)) != 0)
 		goto oom;
-
-	cmd->reply = talloc_asprintf(cmd, "All counters in %s.%u%s",
-			ctrg->desc->group_name_prefix, ctrg->idx, counters);
-	talloc_free(counters);
-	if (!cmd->reply)
+	if (ctr_reply_append(&rep, "All counters in %s.%u",
+			ctrg->desc->group_name_prefix, ctrg->idx) != 0)
+		goto oom;
+	if (get_all_rate_ctr_in_group(&rep, ctrg, intv) != 0)
 		goto oom;
 
+	cmd->reply = rep.buf;
 	return CTRL_CMD_REPLY;
 oom:
 	cmd->reply = "OOM.";
 	return CTRL_CMD_ERROR;
 }
 
-/* rate_ctr */
+/*
+ * rate_ctr.<interval>.<group>			all counters of all instances
+ * rate_ctr.<interval>.<group>.<idx>		all counters of one instance
+ * rate_ctr.<interval>.<group>.<idx>.<name>	a single counter
+ *
+ * The first two forms are the bulk query, one line per counter. The
+ * groups are looked up on every request as there is no notification
+ * when a group is allocated or freed. All instances of a group are
+ * collected in a single walk over the list.
+ */
 CTRL_CMD_DEFINE(rate_ctr, "rate_ctr *");
 static int get_rate_ctr(struct ctrl_cmd *cmd, void *data)
 {
@@ -24,6 +24,8 @@
 
 #include <errno.h>
 #include <stdint.h>
+#include <string.h>
+#include <time.h>
 
 #include <netinet/in.h>
 
@@ -75,12 +77,52 @@ LLIST_HEAD(bssgp_bvc_ctxts);
 static int _bssgp_tx_dl_ud(struct bssgp_flow_control *fc, struct msgb *msg,
 			   uint32_t llc_pdu_len, void *priv);
 
+/* The BVC contexts are never freed, so simple chains are enough */
+#define BVC_HASH_SIZE	1024
+
+static struct bssgp_bvc_ctx *bvci_hash[BVC_HASH_SIZE];
+static struct bssgp_bvc_ctx *cell_hash[BVC_HASH_SIZE];
+
+static inline unsigned int bvci_hash_key(uint16_t bvci, uint16_t nsei)
+{
+	return (bvci ^ (nsei << 3) ^ (nsei >> 7)) & (BVC_HASH_SIZE - 1);
+}
+
+static inline unsigned int cell_hash_key(const struct gprs_ra_id *raid,
+					 uint16_t cid)
+{
+	return (cid ^ (raid->lac << 2) ^ raid->rac) & (BVC_HASH_SIZE - 1);
+}
+
+static void cell_unhash(struct bssgp_bvc_ctx *ctx)
+{
+	struct bssgp_bvc_ctx **pp;
+
+	pp = &cell_hash[cell_hash_key(&ctx->ra_id, ctx->cell_id)];
+	for (; *pp; pp = &(*pp)->cell_hnext) {
+		if (*pp == ctx) {
+			*pp = ctx->cell_hnext;
+			break;
+		}
+	}
+	ctx->cell_hnext = NULL;
+}
+
+static void cell_hash_add(struct bssgp_bvc_ctx *ctx)
+{
+	unsigned int key = cell_hash_key(&ctx->ra_id, ctx->cell_id);
+
+	ctx->cell_hnext = cell_hash[key];
+	cell_hash[key] = ctx;
+}
+
 /* Find a BTS Context based on parsed RA ID and Cell ID */
 struct bssgp_bvc_ctx *btsctx_by_raid_cid(const struct gprs_ra_id *raid, uint16_t cid)
 {
 	struct bssgp_bvc_ctx *bctx;
 
-	llist_for_each_entry(bctx, &bssgp_bvc_ctxts, list) {
+	for (bctx = cell_hash[cell_hash_key(raid, cid)]; bctx;
+	     bctx = bctx->cell_hnext) {
 		if (!memcmp(&bctx->ra_id, raid, sizeof(bctx->ra_id)) &&
 		    bctx->cell_id == cid)
 			return bctx;
@@ -93,7 +135,8 @@ struct bssgp_bvc_ctx *btsctx_by_bvci_nsei(uint16_t bvci, uint16_t nsei)
 {
 	struct bssgp_bvc_ctx *bctx;
 
-	llist_for_each_entry(bctx, &bssgp_bvc_ctxts, list) {
+	for (bctx = bvci_hash[bvci_hash_key(bvci, nsei)]; bctx;
+	     bctx = bctx->bvci_hnext) {
 		if (bctx->nsei == nsei && bctx->bvci == bvci)
 			return bctx;
 	}
@@ -113,10 +156,16 @@ struct bssgp_bvc_ctx *btsctx_alloc(uint16_t bvci, uint16_t nsei)
 	idx = ((bvci & 0xffff) << 16) | (nsei & 0xffff);
 
 	ctx->ctrg = rate_ctr_group_alloc(ctx, &bssgp_ctrg_desc, idx);
-	ctx->fc.out_cb = &_bssgp_tx_dl_ud;
+	bssgp_fc_init(&ctx->fc, 0, 0, BSSGP_FC_BVC_QUEUE_DEPTH,
+		      &_bssgp_tx_dl_ud);
 
 	llist_add(&ctx->list, &bssgp_bvc_ctxts);
 
+	idx = bvci_hash_key(bvci, nsei);
+	ctx->bvci_hnext = bvci_hash[idx];
+	bvci_hash[idx] = ctx;
+	cell_hash_add(ctx);
+
 	return ctx;
 }
 
@@ -288,8 +337,10 @@ static int bssgp_rx_bvc_reset(struct msgb *msg, struct tlv_parsed *tp,
 			return -EINVAL;
 		}
 		/* actually extract RAC / CID */
+		cell_unhash(bctx);
 		bctx->cell_id = bssgp_parse_cell_id(&bctx->ra_id,
 						TLVP_VAL(tp, BSSGP_IE_CELL_ID));
+		cell_hash_add(bctx);
 		LOGP(DBSSGP, LOGL_NOTICE, "Cell %u-%u-%u-%u CI %u on BVCI %u\n",
 			bctx->ra_id.mcc, bctx->ra_id.mnc, bctx->ra_id.lac,
 			bctx->ra_id.rac, bctx->cell_id, bvci);
@@ -482,8 +533,6 @@ static int bssgp_rx_llc_disc(struct msgb *msg, struct tlv_parsed *tp,
 
 /* One element (msgb) in a BSSGP Flow Control queue */
 struct bssgp_fc_queue_element {
-	/* linked list of queue elements */
-	struct llist_head list;
 	/* The message that we have enqueued */
 	struct msgb *msg;
 	/* Length of the LLC PDU part of the contained message */
@@ -492,149 +541,359 @@ struct bssgp_fc_queue_element {
 	void *priv;
 };
 
-static int fc_queue_timer_cfg(struct bssgp_flow_control *fc);
-static int bssgp_fc_needs_queueing(struct bssgp_flow_control *fc, uint32_t pdu_len);
+/*
+ * All flow control instances with queued PDUs share one timer wheel
+ * that is driven by a single osmo_timer. The first level has a slot
+ * for each tick of the next 2.56 seconds, the second level one for
+ * each 2.56 seconds after that. Instances further away are parked in
+ * the last slot and simply re-checked when it expires. The timer is
+ * only armed for the next tick that has something to do.
+ */
+#define FC_TICK_US		10000
+#define FC_WHEEL_L0_BITS	8
+#define FC_WHEEL_L0_SIZE	(1 << FC_WHEEL_L0_BITS)
+#define FC_WHEEL_L1_SIZE	64
+
+static struct {
+	struct llist_head l0[FC_WHEEL_L0_SIZE];
+	struct llist_head l1[FC_WHEEL_L1_SIZE];
+	/* the last tick that has been processed */
+	uint64_t tick;
+	/* no slot before this tick has anything to do */
+	uint64_t wake;
+	unsigned int pending;
+	int running;
+	struct osmo_timer_list timer;
+} fc_wheel;
+
+static void fc_timer_cb(struct bssgp_flow_control *fc);
+
+static uint64_t fc_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 
-static void fc_timer_cb(void *data)
+static __attribute__((constructor)) void on_dso_load_bssgp_fc(void)
 {
-	struct bssgp_flow_control *fc = data;
-	struct bssgp_fc_queue_element *fcqe;
-	struct timeval time_now;
+	int i;
 
-	/* if the queue is empty, we return without sending something
-	 * and without re-starting the timer */
-	if (llist_empty(&fc->queue))
-		return;
+	for (i = 0; i < FC_WHEEL_L0_SIZE; i++)
+		INIT_LLIST_HEAD(&fc_wheel.l0[i]);
+	for (i = 0; i < FC_WHEEL_L1_SIZE; i++)
+		INIT_LLIST_HEAD(&fc_wheel.l1[i]);
+}
 
-	/* get the first entry from the queue */
-	fcqe = llist_entry(&fc->queue.next, struct bssgp_fc_queue_element,
-			   list);
+/* returns the tick at which the wheel needs to look at the instance */
+static uint64_t fc_wheel_insert(struct bssgp_flow_control *fc)
+{
+	uint64_t rounds;
 
-	if (bssgp_fc_needs_queueing(fc, fcqe->llc_pdu_len)) {
-		LOGP(DBSSGP, LOGL_NOTICE, "BSSGP-FC: fc_timer_cb() but still "
-			"not able to send PDU of %u bytes\n", fcqe->llc_pdu_len);
-		/* make sure we re-start the timer */
-		fc_queue_timer_cfg(fc);
-		return;
+	if (fc->wheel_expire - fc_wheel.tick < FC_WHEEL_L0_SIZE) {
+		llist_add_tail(&fc->wheel_list,
+			&fc_wheel.l0[fc->wheel_expire % FC_WHEEL_L0_SIZE]);
+		return fc->wheel_expire;
 	}
 
-	/* remove from the queue */
-	llist_del(&fcqe->list);
+	rounds = (fc->wheel_expire >> FC_WHEEL_L0_BITS)
+			- (fc_wheel.tick >> FC_WHEEL_L0_BITS);
+	if (rounds >= FC_WHEEL_L1_SIZE) {
+		rounds = FC_WHEEL_L1_SIZE - 1;
+		fc->wheel_expire = ((fc_wheel.tick >> FC_WHEEL_L0_BITS) + rounds)
+					<< FC_WHEEL_L0_BITS;
+	}
+	llist_add_tail(&fc->wheel_list,
+		&fc_wheel.l1[(fc->wheel_expire >> FC_WHEEL_L0_BITS)
+				% FC_WHEEL_L1_SIZE]);
+	/* it is moved down to the first level at the start of its round */
+	return (fc->wheel_expire >> FC_WHEEL_L0_BITS) << FC_WHEEL_L0_BITS;
+}
 
-	/* record the time we transmitted this PDU */
-	gettimeofday(&time_now, NULL);
-	fc->time_last_pdu = time_now;
+/* find the next tick with a non-empty slot */
+static uint64_t fc_wheel_next(void)
+{
+	uint64_t tick, round = fc_wheel.tick >> FC_WHEEL_L0_BITS;
+	unsigned int i;
+
+	for (i = 1; i < FC_WHEEL_L0_SIZE; i++) {
+		tick = fc_wheel.tick + i;
+		if (tick % FC_WHEEL_L0_SIZE == 0 &&
+		    !llist_empty(&fc_wheel.l1[(tick >> FC_WHEEL_L0_BITS)
+						% FC_WHEEL_L1_SIZE]))
+			return tick;
+		if (!llist_empty(&fc_wheel.l0[tick % FC_WHEEL_L0_SIZE]))
+			return tick;
+	}
 
-	/* call the output callback for this FC instance */
-	fc->out_cb(fcqe->priv, fcqe->msg, fcqe->llc_pdu_len, NULL);
+	for (i = 1; i < FC_WHEEL_L1_SIZE; i++) {
+		if (!llist_empty(&fc_wheel.l1[(round + i) % FC_WHEEL_L1_SIZE]))
+			return (round + i) << FC_WHEEL_L0_BITS;
+	}
 
-	/* we expect that out_cb will in the end free the msgb once
-	 * it is no longer needed */
+	return UINT64_MAX;
+}
 
-	/* but we have to free the queue element ourselves */
-	talloc_free(fcqe);
+/* arm the timer for the given tick unless it fires earlier anyway */
+static void fc_wheel_wake(uint64_t tick)
+{
+	uint64_t now, usecs = 0;
 
-	/* re-configure the timer for the next PDU */
-	fc_queue_timer_cfg(fc);
+	if (osmo_timer_pending(&fc_wheel.timer) && fc_wheel.wake <= tick)
+		return;
+
+	fc_wheel.wake = tick;
+	now = fc_now_us();
+	if (tick * FC_TICK_US > now)
+		usecs = tick * FC_TICK_US - now;
+	osmo_timer_schedule(&fc_wheel.timer, usecs / 1000000, usecs % 1000000);
 }
 
-/* configure/schedule the flow control timer to expire once the bucket
- * will have leaked a sufficient number of bytes to transmit the next
- * PDU in the queue */
-static int fc_queue_timer_cfg(struct bssgp_flow_control *fc)
+static void fc_wheel_del(struct bssgp_flow_control *fc)
 {
-	struct bssgp_fc_queue_element *fcqe;
-	uint32_t msecs;
+	if (llist_empty(&fc->wheel_list))
+		return;
 
-	if (llist_empty(&fc->queue))
-		return 0;
+	llist_del_init(&fc->wheel_list);
+	fc_wheel.pending -= 1;
+	if (!fc_wheel.pending)
+		osmo_timer_del(&fc_wheel.timer);
+}
 
-	fcqe = llist_entry(&fc->queue.next, struct bssgp_fc_queue_element,
-			   list);
+static void fc_wheel_run(void *data)
+{
+	uint64_t now = fc_now_us() / FC_TICK_US;
+	struct bssgp_flow_control *fc, *fc2;
+	struct llist_head *slot;
+
+	/* the ticks before the wake up have empty slots */
+	if (fc_wheel.wake > fc_wheel.tick + 1)
+		fc_wheel.tick = fc_wheel.wake - 1 < now ? fc_wheel.wake - 1 : now;
+
+	fc_wheel.running = 1;
+	while (fc_wheel.tick < now && fc_wheel.pending) {
+		fc_wheel.tick += 1;
+
+		/* move the next 2.56 seconds down to the first level */
+		if (fc_wheel.tick % FC_WHEEL_L0_SIZE == 0) {
+			slot = &fc_wheel.l1[(fc_wheel.tick >> FC_WHEEL_L0_BITS)
+						% FC_WHEEL_L1_SIZE];
+			llist_for_each_entry_safe(fc, fc2, slot, wheel_list) {
+				llist_del(&fc->wheel_list);
+				fc_wheel_insert(fc);
+			}
+		}
 
-	/* Calculate the point in time at which we will have leaked
-	 * a sufficient number of bytes from the bucket to transmit
-	 * the first PDU in the queue */
-	msecs = (fcqe->llc_pdu_len * 1000) / fc->bucket_leak_rate;
-	/* FIXME: add that time to fc->time_last_pdu and subtract it from
-	 * current time */
+		slot = &fc_wheel.l0[fc_wheel.tick % FC_WHEEL_L0_SIZE];
+		while (!llist_empty(slot)) {
+			fc = llist_entry(slot->next, struct bssgp_flow_control,
+					 wheel_list);
+			fc_wheel_del(fc);
+			fc_timer_cb(fc);
+		}
+	}
 
-	fc->timer.data = fc;
-	fc->timer.cb = &fc_timer_cb;
-	osmo_timer_schedule(&fc->timer, msecs / 1000, (msecs % 1000) * 1000);
+	fc_wheel.running = 0;
 
-	return 0;
+	if (fc_wheel.pending)
+		fc_wheel_wake(fc_wheel_next());
 }
 
-/* Enqueue a PDU in the flow control queue for delayed transmission */
-static int fc_enqueue(struct bssgp_flow_control *fc, struct msgb *msg,
-		      uint32_t llc_pdu_len, void *priv)
+/* (re-)schedule a flow control instance for the given tick */
+static void fc_wheel_add(struct bssgp_flow_control *fc, uint64_t expire)
 {
-	struct bssgp_fc_queue_element *fcqe;
+	uint64_t wake;
 
-	fcqe = talloc_zero(fc, struct bssgp_fc_queue_element);
-	if (!fcqe)
-		return -ENOMEM;
-	fcqe->msg = msg;
-	fcqe->llc_pdu_len = llc_pdu_len;
-	fcqe->priv = priv;
+	fc_wheel_del(fc);
 
-	llist_add_tail(&fcqe->list, &fc->queue);
+	if (!fc_wheel.pending) {
+		/* the wheel was idle, catch up with the clock */
+		fc_wheel.tick = fc_now_us() / FC_TICK_US;
+		fc_wheel.timer.cb = fc_wheel_run;
+	}
 
-	/* re-configure the timer for dequeueing the pdu */
-	fc_queue_timer_cfg(fc);
+	if (expire <= fc_wheel.tick)
+		expire = fc_wheel.tick + 1;
+	fc->wheel_expire = expire;
+	wake = fc_wheel_insert(fc);
+	fc_wheel.pending += 1;
 
-	return 0;
+	/* fc_wheel_run() re-arms the timer once it is done */
+	if (!fc_wheel.running)
+		fc_wheel_wake(wake);
+}
+
+/* number of bytes that have leaked since the last PDU was sent */
+static uint32_t fc_leaked(struct bssgp_flow_control *fc, uint64_t now)
+{
+	uint64_t elapsed = now - fc->time_last_pdu;
+
+	/* more than an hour drains any bucket and would overflow */
+	if (elapsed > 3600ULL * 1000000)
+		return UINT32_MAX;
+
+	return (elapsed * fc->bucket_leak_rate) / 1000000;
 }
 
 /* According to Section 8.2 */
-static int bssgp_fc_needs_queueing(struct bssgp_flow_control *fc, uint32_t pdu_len)
+static int fc_bucket_full(struct bssgp_flow_control *fc, uint32_t pdu_len,
+			  uint64_t now)
 {
-	struct timeval time_now, time_diff;
 	int64_t bucket_predicted;
-	uint32_t csecs_elapsed, leaked;
 
-	/* if we already have pending messages in the queue, we
-	 * definietly have to enqueue the new message, too */
-	if (fc->queue_depth)
-		return 1;
+	/* no flow control parameters received yet */
+	if (!fc->bucket_size_max && !fc->bucket_leak_rate)
+		return 0;
 
 	/* B' = B + L(p) - (Tc - Tp)*R */
-
-	/* compute number of centi-seconds that have elapsed since transmitting
-	 * the last PDU (Tc - Tp) */
-	gettimeofday(&time_now, NULL);
-	timersub(&time_now, &fc->time_last_pdu, &time_diff);
-	csecs_elapsed = time_diff.tv_sec*100 + time_diff.tv_usec/10000;
-
-	/* compute number of bytes that have leaked in the elapsed number
-	 * of centi-seconds */
-	leaked = csecs_elapsed * (fc->bucket_leak_rate / 100);
-	/* add the current PDU length to the last bucket level */
-	bucket_predicted = fc->bucket_counter + pdu_len;
-	/* ... and subtract the number of leaked bytes */
-	bucket_predicted -= leaked;
+	bucket_predicted = (int64_t) fc->bucket_counter + pdu_len;
+	bucket_predicted -= fc_leaked(fc, now);
 
 	if (bucket_predicted < pdu_len) {
 		/* this is just to make sure the bucket doesn't underflow */
-		bucket_predicted = pdu_len;
-		goto pass;
+		fc->bucket_counter = pdu_len;
+		return 0;
 	}
 
 	if (bucket_predicted <= fc->bucket_size_max) {
 		/* the bucket is not full yet, we can pass the packet */
 		fc->bucket_counter = bucket_predicted;
-		goto pass;
+		return 0;
 	}
 
 	/* bucket is full, PDU needs to be delayed */
 	return 1;
+}
+
+static int bssgp_fc_needs_queueing(struct bssgp_flow_control *fc,
+				   uint32_t pdu_len, uint64_t now)
+{
+	/* if we already have pending messages in the queue, we
+	 * definietly have to enqueue the new message, too */
+	if (fc->queue_depth)
+		return 1;
+
+	return fc_bucket_full(fc, pdu_len, now);
+}
+
+/* schedule the flow control instance for the point in time at which
+ * the bucket will have leaked a sufficient number of bytes to transmit
+ * the first PDU in the queue */
+static void fc_queue_timer_cfg(struct bssgp_flow_control *fc)
+{
+	struct bssgp_fc_queue_element *fcqe;
+	uint64_t need, usecs;
+
+	if (!fc->queue_depth)
+		return;
+
+	if (!fc->bucket_leak_rate) {
+		/* nothing leaks, wait for new parameters from the peer */
+		if (fc->bucket_size_max) {
+			fc_wheel_del(fc);
+			return;
+		}
+		/* no flow control at all, the queue can go out now */
+		fc_wheel_add(fc, 0);
+		return;
+	}
+
+	fcqe = &fc->queue[fc->queue_head];
+	need = (uint64_t) fc->bucket_counter + fcqe->llc_pdu_len;
+	if (need > fc->bucket_size_max)
+		need -= fc->bucket_size_max;
+	else
+		need = 0;
+	/* an empty bucket always passes the PDU */
+	if (need > fc->bucket_counter + 1ULL)
+		need = fc->bucket_counter + 1ULL;
+
+	usecs = (need * 1000000 + fc->bucket_leak_rate - 1)
+			/ fc->bucket_leak_rate;
+	fc_wheel_add(fc, (fc->time_last_pdu + usecs + FC_TICK_US - 1)
+				/ FC_TICK_US);
+}
+
+static void fc_timer_cb(struct bssgp_flow_control *fc)
+{
+	struct bssgp_fc_queue_element *fcqe;
+	uint64_t now;
+
+	now = fc_now_us();
+
+	/* send as many PDUs as the bucket allows by now */
+	while (fc->queue_depth) {
+		/* get the first entry from the queue */
+		fcqe = &fc->queue[fc->queue_head];
+		if (fc_bucket_full(fc, fcqe->llc_pdu_len, now))
+			break;
+
+		/* remove from the queue */
+		fc->queue_head = (fc->queue_head + 1) % fc->max_queue_depth;
+		fc->queue_depth -= 1;
+
+		/* record the time we transmitted this PDU */
+		fc->time_last_pdu = now;
+
+		/* call the output callback for this FC instance, we expect
+		 * that out_cb will in the end free the msgb */
+		fc->out_cb(fcqe->priv, fcqe->msg, fcqe->llc_pdu_len, NULL);
+	}
+
+	/* re-configure the timer for the next PDU */
+	fc_queue_timer_cfg(fc);
+}
+
+/* Enqueue a PDU in the flow control queue for delayed transmission */
+static int fc_enqueue(struct bssgp_flow_control *fc, struct msgb *msg,
+		      uint32_t llc_pdu_len, void *priv)
+{
+	struct bssgp_fc_queue_element *fcqe;
+
+	if (fc->queue_depth >= fc->max_queue_depth) {
+		LOGP(DBSSGP, LOGL_NOTICE, "BSSGP-FC: queue of %u PDUs is "
+			"full, dropping PDU of %u bytes\n", fc->queue_depth,
+			llc_pdu_len);
+		msgb_free(msg);
+		return -ENOSPC;
+	}
+
+	/* the ring is only allocated once PDUs need to be queued */
+	if (!fc->queue) {
+		fc->queue = talloc_array(bssgp_tall_ctx,
+					 struct bssgp_fc_queue_element,
+					 fc->max_queue_depth);
+		if (!fc->queue) {
+			msgb_free(msg);
+			return -ENOMEM;
+		}
+	}
+
+	fcqe = &fc->queue[(fc->queue_head + fc->queue_depth)
+				% fc->max_queue_depth];
+	fcqe->msg = msg;
+	fcqe->llc_pdu_len = llc_pdu_len;
+	fcqe->priv = priv;
+	fc->queue_depth += 1;
+
+	/* the first PDU in the queue decides when to look again */
+	if (fc->queue_depth == 1)
+		fc_queue_timer_cfg(fc);
 
-pass:
-	/* if we reach here, the PDU can pass */
 	return 0;
 }
 
+/* The peer sent new parameters, the queued PDUs may be due at a
+ * different time now, e.g. when the leak rate was zero so far */
+static void fc_set_params(struct bssgp_flow_control *fc,
+			  uint32_t bucket_size_max, uint32_t bucket_leak_rate)
+{
+	fc->bucket_size_max = bucket_size_max;
+	fc->bucket_leak_rate = bucket_leak_rate;
+	fc_queue_timer_cfg(fc);
+}
+
 /* output callback for BVC flow control */
 static int _bssgp_tx_dl_ud(struct bssgp_flow_control *fc, struct msgb *msg,
 			   uint32_t llc_pdu_len, void *priv)
@@ -648,18 +907,46 @@ static int _bssgp_tx_dl_ud(struct bssgp_flow_control *fc, struct msgb *msg,
 int bssgp_fc_in(struct bssgp_flow_control *fc, struct msgb *msg,
 		uint32_t llc_pdu_len, void *priv)
 {
-	struct timeval time_now;
+	uint64_t now = fc_now_us();
 
-	if (bssgp_fc_needs_queueing(fc, llc_pdu_len)) {
+	if (bssgp_fc_needs_queueing(fc, llc_pdu_len, now)) {
 		return fc_enqueue(fc, msg, llc_pdu_len, priv);
 	} else {
 		/* record the time we transmitted this PDU */
-		gettimeofday(&time_now, NULL);
-		fc->time_last_pdu = time_now;
+		fc->time_last_pdu = now;
 		return fc->out_cb(priv, msg, llc_pdu_len, NULL);
 	}
 }
 
+void bssgp_fc_init(struct bssgp_flow_control *fc,
+		   uint32_t bucket_size_max, uint32_t bucket_leak_rate,
+		   uint32_t max_queue_depth,
+		   int (*out_cb)(struct bssgp_flow_control *fc, struct msgb *msg,
+				 uint32_t llc_pdu_len, void *priv))
+{
+	memset(fc, 0, sizeof(*fc));
+	fc->bucket_size_max = bucket_size_max;
+	fc->bucket_leak_rate = bucket_leak_rate;
+	fc->max_queue_depth = max_queue_depth;
+	fc->out_cb = out_cb;
+	INIT_LLIST_HEAD(&fc->wheel_list);
+}
+
+void bssgp_fc_flush(struct bssgp_flow_control *fc)
+{
+	fc_wheel_del(fc);
+
+	while (fc->queue_depth) {
+		msgb_free(fc->queue[fc->queue_head].msg);
+		fc->queue_head = (fc->queue_head + 1) % fc->max_queue_depth;
+		fc->queue_depth -= 1;
+	}
+
+	talloc_free(fc->queue);
+	fc->queue = NULL;
+	fc->queue_head = 0;
+}
+
 /* Initialize the Flow Control parameters for a new MS according to
  * default values for the BVC specified by BVCI and NSEI */
 int bssgp_fc_ms_init(struct bssgp_flow_control *fc_ms, uint16_t bvci,
@@ -670,8 +957,7 @@ int bssgp_fc_ms_init(struct bssgp_flow_control *fc_ms, uint16_t bvci,
 	ctx = btsctx_by_bvci_nsei(bvci, nsei);
 	if (!ctx)
 		return -ENODEV;
-	fc_ms->bucket_size_max = ctx->bmax_default_ms;
-	fc_ms->bucket_leak_rate = ctx->r_default_ms;
+	fc_set_params(fc_ms, ctx->bmax_default_ms, ctx->r_default_ms);
 
 	return 0;
 }
@@ -693,12 +979,10 @@ static int bssgp_rx_fc_bvc(struct msgb *msg, struct tlv_parsed *tp,
 		return bssgp_tx_status(BSSGP_CAUSE_MISSING_MAND_IE, NULL, msg);
 	}
 
-	/* 11.3.5 */
-	bctx->fc.bucket_size_max = 100 *
-		ntohs(*(uint16_t *)TLVP_VAL(tp, BSSGP_IE_BVC_BUCKET_SIZE));
-	/* 11.3.4 */
-	bctx->fc.bucket_leak_rate = 100 *
-		ntohs(*(uint16_t *)TLVP_VAL(tp, BSSGP_IE_BUCKET_LEAK_RATE));
+	/* 11.3.5 and 11.3.4 */
+	fc_set_params(&bctx->fc,
+		100 * ntohs(*(uint16_t *)TLVP_VAL(tp, BSSGP_IE_BVC_BUCKET_SIZE)),
+		100 * ntohs(*(uint16_t *)TLVP_VAL(tp, BSSGP_IE_BUCKET_LEAK_RATE)));
 	/* 11.3.2 */
 	bctx->bmax_default_ms = 100 *
 		ntohs(*(uint16_t *)TLVP_VAL(tp, BSSGP_IE_BMAX_DEFAULT_MS));
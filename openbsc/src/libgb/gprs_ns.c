@@ -51,10 +51,12 @@
  *  o There are no BLOCK and UNBLOCK timers (yet?)
  */
 
+#define _GNU_SOURCE	/* recvmmsg() and sendmmsg() */
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
 #include <stdint.h>
+#include <sys/socket.h>
 
 #include <arpa/inet.h>
 
@@ -64,12 +66,20 @@
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/select.h>
 #include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/utils.h>
 #include <openbsc/debug.h>
 #include <openbsc/signal.h>
 #include <openbsc/gprs_ns.h>
 #include <openbsc/gprs_bssgp.h>
 #include <openbsc/gprs_ns_frgre.h>
 #include <openbsc/socket.h>
+#include <openbsc/pdu_trace.h>
+
+#include "../../bscconfig.h"
+
+/* NS and BSSGP keep their per message state in msgb->cb */
+osmo_static_assert(sizeof(struct openbsc_msgb_cb) <=
+		   sizeof(((struct msgb *)0)->cb), openbsc_msgb_cb_size);
 
 static const struct tlv_definition ns_att_tlvdef = {
 	.def = {
@@ -88,6 +98,7 @@ enum ns_ctr {
 	NS_CTR_BYTES_OUT,
 	NS_CTR_BLOCKED,
 	NS_CTR_DEAD,
+	NS_CTR_TX_DROPPED,
 };
 
 static const struct rate_ctr_desc nsvc_ctr_description[] = {
@@ -97,6 +108,7 @@ static const struct rate_ctr_desc nsvc_ctr_description[] = {
 	{ "bytes.out",	"Bytes at NS Level   (Out)" },
 	{ "blocked",	"NS-VC Block count        " },
 	{ "dead",	"NS-VC gone dead count    " },
+	{ "tx.dropped",	"Tx queue overflow drops  " },
 };
 
 static const struct rate_ctr_group_desc nsvc_ctrg_desc = {
@@ -106,22 +118,55 @@ static const struct rate_ctr_group_desc nsvc_ctrg_desc = {
 	.ctr_desc = nsvc_ctr_description,
 };
 
+static inline unsigned int ns_hash16(uint16_t val)
+{
+	return (val ^ (val >> 8)) & (NS_HASH_SIZE - 1);
+}
+
+static inline unsigned int ns_hash_addr(const struct sockaddr_in *sin)
+{
+	uint32_t val = ntohl(sin->sin_addr.s_addr) ^ ntohs(sin->sin_port);
+
+	val ^= val >> 16;
+	return ns_hash16(val);
+}
+
+/* Put the NSVC into the buckets matching its current identifiers */
+void nsvc_rehash(struct gprs_nsvc *nsvc)
+{
+	struct gprs_ns_inst *nsi = nsvc->nsi;
+
+	/* the unknown NSVC is not part of the lookup tables */
+	if (nsvc == nsi->unknown_nsvc)
+		return;
+
+	llist_del(&nsvc->nsvci_hentry);
+	llist_del(&nsvc->nsei_hentry);
+	llist_del(&nsvc->addr_hentry);
+	llist_add(&nsvc->nsvci_hentry, &nsi->nsvci_hash[ns_hash16(nsvc->nsvci)]);
+	llist_add(&nsvc->nsei_hentry, &nsi->nsei_hash[ns_hash16(nsvc->nsei)]);
+	llist_add(&nsvc->addr_hentry,
+		  &nsi->addr_hash[ns_hash_addr(&nsvc->ip.bts_addr)]);
+}
+
 /* Lookup struct gprs_nsvc based on NSVCI */
 struct gprs_nsvc *nsvc_by_nsvci(struct gprs_ns_inst *nsi, uint16_t nsvci)
 {
 	struct gprs_nsvc *nsvc;
-	llist_for_each_entry(nsvc, &nsi->gprs_nsvcs, list) {
+	llist_for_each_entry(nsvc, &nsi->nsvci_hash[ns_hash16(nsvci)],
+			     nsvci_hentry) {
 		if (nsvc->nsvci == nsvci)
 			return nsvc;
 	}
 	return NULL;
 }
 
-/* Lookup struct gprs_nsvc based on NSVCI */
+/* Lookup struct gprs_nsvc based on NSEI */
 struct gprs_nsvc *nsvc_by_nsei(struct gprs_ns_inst *nsi, uint16_t nsei)
 {
 	struct gprs_nsvc *nsvc;
-	llist_for_each_entry(nsvc, &nsi->gprs_nsvcs, list) {
+	llist_for_each_entry(nsvc, &nsi->nsei_hash[ns_hash16(nsei)],
+			     nsei_hentry) {
 		if (nsvc->nsei == nsei)
 			return nsvc;
 	}
@@ -133,7 +178,8 @@ static struct gprs_nsvc *nsvc_by_rem_addr(struct gprs_ns_inst *nsi,
 					  struct sockaddr_in *sin)
 {
 	struct gprs_nsvc *nsvc;
-	llist_for_each_entry(nsvc, &nsi->gprs_nsvcs, list) {
+	llist_for_each_entry(nsvc, &nsi->addr_hash[ns_hash_addr(sin)],
+			     addr_hentry) {
 		if (nsvc->ip.bts_addr.sin_addr.s_addr ==
 					sin->sin_addr.s_addr &&
 		    nsvc->ip.bts_addr.sin_port == sin->sin_port)
@@ -158,17 +204,32 @@ struct gprs_nsvc *nsvc_create(struct gprs_ns_inst *nsi, uint16_t nsvci)
 	nsvc->timer.cb = gprs_ns_timer_cb;
 	nsvc->timer.data = nsvc;
 	nsvc->ctrg = rate_ctr_group_alloc(nsvc, &nsvc_ctrg_desc, nsvci);
+	INIT_LLIST_HEAD(&nsvc->tx_queue);
+	INIT_LLIST_HEAD(&nsvc->tx_list);
+	INIT_LLIST_HEAD(&nsvc->nsvci_hentry);
+	INIT_LLIST_HEAD(&nsvc->nsei_hentry);
+	INIT_LLIST_HEAD(&nsvc->addr_hentry);
 
 	llist_add(&nsvc->list, &nsi->gprs_nsvcs);
+	nsvc_rehash(nsvc);
 
 	return nsvc;
 }
 
 void nsvc_delete(struct gprs_nsvc *nsvc)
 {
+	struct msgb *msg;
+
 	if (osmo_timer_pending(&nsvc->timer))
 		osmo_timer_del(&nsvc->timer);
+	while ((msg = msgb_dequeue(&nsvc->tx_queue)))
+		msgb_free(msg);
+	if (!llist_empty(&nsvc->tx_list))
+		llist_del(&nsvc->tx_list);
 	llist_del(&nsvc->list);
+	llist_del(&nsvc->nsvci_hentry);
+	llist_del(&nsvc->nsei_hentry);
+	llist_del(&nsvc->addr_hentry);
 	talloc_free(nsvc);
 }
 
@@ -217,6 +278,10 @@ static int gprs_ns_tx(struct gprs_nsvc *nsvc, struct msgb *msg)
 	rate_ctr_inc(&nsvc->ctrg->ctr[NS_CTR_PKTS_OUT]);
 	rate_ctr_add(&nsvc->ctrg->ctr[NS_CTR_BYTES_OUT], msgb_l2len(msg));
 
+	/* the NS header is at the start of every PDU we send */
+	pdu_trace_record(PDU_TRACE_NS, PDU_TRACE_TX, nsvc->nsei,
+			 msg->data, msg->len);
+
 	switch (nsvc->ll) {
 	case GPRS_NS_LL_UDP:
 		ret = nsip_sendmsg(nsvc, msg);
@@ -624,6 +689,7 @@ static int gprs_ns_rx_reset(struct gprs_nsvc *nsvc, struct msgb *msg)
 
 	nsvc->nsei = ntohs(*nsei);
 	nsvc->nsvci = ntohs(*nsvci);
+	nsvc_rehash(nsvc);
 
 	/* start the test procedure */
 	gprs_ns_tx_simple(nsvc, NS_PDUT_ALIVE);
@@ -681,6 +747,8 @@ int gprs_ns_rcvmsg(struct gprs_ns_inst *nsi, struct msgb *msg,
 
 	/* look up the NSVC based on source address */
 	nsvc = nsvc_by_rem_addr(nsi, saddr);
+	pdu_trace_record(PDU_TRACE_NS, PDU_TRACE_RX, nsvc ? nsvc->nsei : 0xffff,
+			 msgb_l2(msg), msgb_l2len(msg));
 	if (!nsvc) {
 		struct tlv_parsed tp;
 		uint16_t nsei;
@@ -739,6 +807,7 @@ int gprs_ns_rcvmsg(struct gprs_ns_inst *nsi, struct msgb *msg,
 		}
 		/* Update the remote peer IP address/port */
 		nsvc->ip.bts_addr = *saddr;
+		nsvc_rehash(nsvc);
 	} else
 		msgb_nsei(msg) = nsvc->nsei;
 
@@ -826,9 +895,16 @@ int gprs_ns_rcvmsg(struct gprs_ns_inst *nsi, struct msgb *msg,
 struct gprs_ns_inst *gprs_ns_instantiate(gprs_ns_cb_t *cb)
 {
 	struct gprs_ns_inst *nsi = talloc_zero(tall_bsc_ctx, struct gprs_ns_inst);
+	unsigned int i;
 
 	nsi->cb = cb;
 	INIT_LLIST_HEAD(&nsi->gprs_nsvcs);
+	for (i = 0; i < NS_HASH_SIZE; i++) {
+		INIT_LLIST_HEAD(&nsi->nsvci_hash[i]);
+		INIT_LLIST_HEAD(&nsi->nsei_hash[i]);
+		INIT_LLIST_HEAD(&nsi->addr_hash[i]);
+	}
+	INIT_LLIST_HEAD(&nsi->nsip.tx_pending);
 	nsi->timeout[NS_TOUT_TNS_BLOCK] = 3;
 	nsi->timeout[NS_TOUT_TNS_BLOCK_RETRIES] = 3;
 	nsi->timeout[NS_TOUT_TNS_RESET] = 3;
@@ -841,14 +917,25 @@ struct gprs_ns_inst *gprs_ns_instantiate(gprs_ns_cb_t *cb)
 	 * messages to non-existant/unknown NS-VC's */
 	nsi->unknown_nsvc = nsvc_create(nsi, 0xfffe);
 	llist_del(&nsi->unknown_nsvc->list);
+	llist_del_init(&nsi->unknown_nsvc->nsvci_hentry);
+	llist_del_init(&nsi->unknown_nsvc->nsei_hentry);
+	llist_del_init(&nsi->unknown_nsvc->addr_hentry);
 
 	return nsi;
 }
 
 void gprs_ns_destroy(struct gprs_ns_inst *nsi)
 {
+	unsigned int i;
+
 	/* FIXME: clear all timers */
 
+	/* receive buffers live in the msgb context, not below the NSI */
+	for (i = 0; i < ARRAY_SIZE(nsi->nsip.rx_msg); i++) {
+		if (nsi->nsip.rx_msg[i])
+			msgb_free(nsi->nsip.rx_msg[i]);
+	}
+
 	/* recursively free the NSI and all its NSVCs */
 	talloc_free(nsi);
 }
@@ -857,6 +944,71 @@ void gprs_ns_destroy(struct gprs_ns_inst *nsi)
 /* NS-over-IP code, according to 3GPP TS 48.016 Chapter 6.2
  * We don't support Size Procedure, Configuration Procedure, ChangeWeight Procedure */
 
+#ifdef HAVE_RECVMMSG
+/* Read up to NS_RX_BATCH NS-over-IP messages with a single syscall */
+static int handle_nsip_read(struct osmo_fd *bfd)
+{
+	struct gprs_ns_inst *nsi = bfd->data;
+	struct mmsghdr mmsg[NS_RX_BATCH];
+	struct iovec iov[NS_RX_BATCH];
+	struct sockaddr_in saddr[NS_RX_BATCH];
+	int i, num, rc = 0;
+
+	memset(mmsg, 0, sizeof(mmsg));
+
+	/* buffers that were not filled last time are kept for this round */
+	for (i = 0; i < NS_RX_BATCH; i++) {
+		struct msgb *msg = nsi->nsip.rx_msg[i];
+
+		if (!msg) {
+			msg = gprs_ns_msgb_alloc();
+			if (!msg)
+				break;
+			nsi->nsip.rx_msg[i] = msg;
+		}
+
+		iov[i].iov_base = msg->data;
+		iov[i].iov_len = NS_ALLOC_SIZE - NS_ALLOC_HEADROOM;
+		mmsg[i].msg_hdr.msg_iov = &iov[i];
+		mmsg[i].msg_hdr.msg_iovlen = 1;
+		mmsg[i].msg_hdr.msg_name = &saddr[i];
+		mmsg[i].msg_hdr.msg_namelen = sizeof(saddr[i]);
+	}
+	if (i == 0)
+		return -ENOMEM;
+
+	num = recvmmsg(bfd->fd, mmsg, i, MSG_DONTWAIT, NULL);
+	if (num < 0) {
+		if (errno == EAGAIN)
+			return 0;
+		LOGP(DNS, LOGL_ERROR, "recv error %s during NSIP recv\n",
+			strerror(errno));
+		return num;
+	}
+
+	for (i = 0; i < num; i++) {
+		struct msgb *msg = nsi->nsip.rx_msg[i];
+
+		nsi->nsip.rx_msg[i] = NULL;
+		if (mmsg[i].msg_len == 0) {
+			msgb_free(msg);
+			continue;
+		}
+
+		msg->l2h = msg->data;
+		msgb_put(msg, mmsg[i].msg_len);
+
+		rc = gprs_ns_rcvmsg(nsi, msg, &saddr[i], GPRS_NS_LL_UDP);
+
+		if (rc == GPRS_NS_RX_KEPT)
+			rc = 0;
+		else
+			msgb_free(msg);
+	}
+
+	return rc;
+}
+#else
 /* Read a single NS-over-IP message */
 static struct msgb *read_nsip_msg(struct osmo_fd *bfd, int *error,
 				  struct sockaddr_in *saddr)
@@ -902,27 +1054,120 @@ static int handle_nsip_read(struct osmo_fd *bfd)
 
 	error = gprs_ns_rcvmsg(nsi, msg, &saddr, GPRS_NS_LL_UDP);
 
-	msgb_free(msg);
+	if (error == GPRS_NS_RX_KEPT)
+		error = 0;
+	else
+		msgb_free(msg);
 
 	return error;
 }
+#endif
+
+/* Send as much of the transmit queue of a NS-VC as the socket takes,
+ * returns -EAGAIN if the socket is full */
+static int nsip_drain_nsvc(struct gprs_nsvc *nsvc)
+{
+	struct gprs_ns_inst *nsi = nsvc->nsi;
+	struct sockaddr_in *daddr = &nsvc->ip.bts_addr;
+	struct msgb *msg;
+	int i, num;
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr mmsg[NS_TX_BATCH];
+	struct iovec iov[NS_TX_BATCH];
+#endif
+
+	while (!llist_empty(&nsvc->tx_queue)) {
+#ifdef HAVE_SENDMMSG
+		memset(mmsg, 0, sizeof(mmsg));
+		i = 0;
+		llist_for_each_entry(msg, &nsvc->tx_queue, list) {
+			if (i >= NS_TX_BATCH)
+				break;
+			iov[i].iov_base = msg->data;
+			iov[i].iov_len = msg->len;
+			mmsg[i].msg_hdr.msg_iov = &iov[i];
+			mmsg[i].msg_hdr.msg_iovlen = 1;
+			mmsg[i].msg_hdr.msg_name = daddr;
+			mmsg[i].msg_hdr.msg_namelen = sizeof(*daddr);
+			i++;
+		}
+		num = sendmmsg(nsi->nsip.fd.fd, mmsg, i, MSG_DONTWAIT);
+#else
+		msg = llist_entry(nsvc->tx_queue.next, struct msgb, list);
+		num = sendto(nsi->nsip.fd.fd, msg->data, msg->len,
+			     MSG_DONTWAIT, (struct sockaddr *)daddr,
+			     sizeof(*daddr));
+		if (num >= 0)
+			num = 1;
+#endif
+		if (num < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return -EAGAIN;
+			/* drop the PDU at the head so we make progress */
+			LOGP(DNS, LOGL_ERROR, "NSEI=%u error %s during NSIP "
+				"send\n", nsvc->nsei, strerror(errno));
+			rate_ctr_inc(&nsvc->ctrg->ctr[NS_CTR_TX_DROPPED]);
+			num = 1;
+		}
+
+		for (i = 0; i < num; i++) {
+			msg = msgb_dequeue(&nsvc->tx_queue);
+			nsvc->tx_queue_len--;
+			msgb_free(msg);
+		}
+	}
+
+	return 0;
+}
 
 static int handle_nsip_write(struct osmo_fd *bfd)
 {
-	/* FIXME: actually send the data here instead of nsip_sendmsg() */
-	return -EIO;
+	struct gprs_ns_inst *nsi = bfd->data;
+	struct gprs_nsvc *nsvc, *nsvc2;
+
+	llist_for_each_entry_safe(nsvc, nsvc2, &nsi->nsip.tx_pending, tx_list) {
+		/* socket buffer full, wait until it is writable again */
+		if (nsip_drain_nsvc(nsvc) == -EAGAIN)
+			return 0;
+		llist_del_init(&nsvc->tx_list);
+	}
+
+	bfd->when &= ~BSC_FD_WRITE;
+
+	return 0;
 }
 
+/* Queue a NS-over-IP PDU, all PDUs queued during one select loop
+ * iteration are then written in batches once the socket is writable */
 static int nsip_sendmsg(struct gprs_nsvc *nsvc, struct msgb *msg)
 {
 	int rc;
 	struct gprs_ns_inst *nsi = nsvc->nsi;
 	struct sockaddr_in *daddr = &nsvc->ip.bts_addr;
 
-	rc = sendto(nsi->nsip.fd.fd, msg->data, msg->len, 0,
-		  (struct sockaddr *)daddr, sizeof(*daddr));
+	/* the fake NS-VC changes its remote address for every PDU */
+	if (nsvc == nsi->unknown_nsvc) {
+		rc = sendto(nsi->nsip.fd.fd, msg->data, msg->len, 0,
+			  (struct sockaddr *)daddr, sizeof(*daddr));
+		msgb_free(msg);
+		return rc;
+	}
+
+	if (nsvc->tx_queue_len >= NS_TX_QUEUE_MAX) {
+		LOGP(DNS, LOGL_NOTICE, "NSEI=%u transmit queue full, "
+			"dropping PDU\n", nsvc->nsei);
+		rate_ctr_inc(&nsvc->ctrg->ctr[NS_CTR_TX_DROPPED]);
+		msgb_free(msg);
+		return -ENOBUFS;
+	}
+
+	rc = msg->len;
+	msgb_enqueue(&nsvc->tx_queue, msg);
+	nsvc->tx_queue_len++;
 
-	talloc_free(msg);
+	if (llist_empty(&nsvc->tx_list))
+		llist_add_tail(&nsvc->tx_list, &nsi->nsip.tx_pending);
+	nsi->nsip.fd.when |= BSC_FD_WRITE;
 
 	return rc;
 }
@@ -985,6 +1230,7 @@ struct gprs_nsvc *nsip_connect(struct gprs_ns_inst *nsi,
 	nsvc->ip.bts_addr = *dest;
 	nsvc->nsei = nsei;
 	nsvc->nsvci = nsvci;
+	nsvc_rehash(nsvc);
 	nsvc->remote_end_is_sgsn = 1;
 
 	gprs_nsvc_reset(nsvc, NS_CAUSE_OM_INTERVENTION);
@@ -224,6 +224,8 @@ static int handle_nsfrgre_read(struct osmo_fd *bfd)
 	}
 
 	rc = gprs_ns_rcvmsg(nsi, msg, &saddr, GPRS_NS_LL_FR_GRE);
+	if (rc == GPRS_NS_RX_KEPT)
+		return 0;
 out:
 	msgb_free(msg);
 
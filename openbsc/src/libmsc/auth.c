@@ -25,15 +25,23 @@
 #include <openbsc/auth.h>
 #include <openbsc/gsm_data.h>
 
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/timer.h>
 #include <osmocom/gsm/comp128.h>
 
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 
 
+/* The algorithms work on an array of tuples so the pool can fill all
+ * tuples of a subscriber in one go, the key is only checked once. */
 static int
-_use_xor(struct gsm_auth_info *ainfo, struct gsm_auth_tuple *atuple)
+_use_xor(struct gsm_auth_info *ainfo, struct gsm_auth_tuple *atuple,
+	 unsigned int num)
 {
 	int i, l = ainfo->a3a8_ki_len;
+	unsigned int n;
 
 	if ((l > A38_XOR_MAX_KEY_LEN) || (l < A38_XOR_MIN_KEY_LEN)) {
 		LOGP(DMM, LOGL_ERROR, "Invalid XOR key (len=%d) %s\n",
@@ -42,17 +50,22 @@ _use_xor(struct gsm_auth_info *ainfo, struct gsm_auth_tuple *atuple)
 		return -1;
 	}
 
-	for (i=0; i<4; i++)
-		atuple->sres[i] = atuple->rand[i] ^ ainfo->a3a8_ki[i];
-	for (i=4; i<12; i++)
-		atuple->kc[i-4] = atuple->rand[i] ^ ainfo->a3a8_ki[i];
+	for (n = 0; n < num; n++, atuple++) {
+		for (i=0; i<4; i++)
+			atuple->sres[i] = atuple->rand[i] ^ ainfo->a3a8_ki[i];
+		for (i=4; i<12; i++)
+			atuple->kc[i-4] = atuple->rand[i] ^ ainfo->a3a8_ki[i];
+	}
 
 	return 0;
 }
 
 static int
-_use_comp128_v1(struct gsm_auth_info *ainfo, struct gsm_auth_tuple *atuple)
+_use_comp128_v1(struct gsm_auth_info *ainfo, struct gsm_auth_tuple *atuple,
+		unsigned int num)
 {
+	unsigned int n;
+
 	if (ainfo->a3a8_ki_len != A38_COMP128_KEY_LEN) {
 		LOGP(DMM, LOGL_ERROR, "Invalid COMP128v1 key (len=%d) %s\n",
 			ainfo->a3a8_ki_len,
@@ -60,11 +73,275 @@ _use_comp128_v1(struct gsm_auth_info *ainfo, struct gsm_auth_tuple *atuple)
 		return -1;
 	}
 
-	comp128(ainfo->a3a8_ki, atuple->rand, atuple->sres, atuple->kc);
+	for (n = 0; n < num; n++, atuple++)
+		comp128(ainfo->a3a8_ki, atuple->rand, atuple->sres, atuple->kc);
 
 	return 0;
 }
 
+/* Fill rand, sres and kc of num tuples. Returns 0 on success, 1 if the
+ * subscriber does not use authentication and -1 for a bad key */
+static int
+_gen_tuples(struct gsm_auth_info *ainfo, struct gsm_auth_tuple *atuple,
+	    unsigned int num)
+{
+	unsigned int n, i;
+
+	for (n = 0; n < num; n++)
+		for (i = 0; i < sizeof(atuple[n].rand); i++)
+			atuple[n].rand[i] = random() & 0xff;
+
+	switch (ainfo->auth_algo) {
+	case AUTH_ALGO_NONE:
+		return 1;
+
+	case AUTH_ALGO_XOR:
+		return _use_xor(ainfo, atuple, num);
+
+	case AUTH_ALGO_COMP128v1:
+		return _use_comp128_v1(ainfo, atuple, num);
+
+	default:
+		DEBUGP(DMM, "Unsupported auth type algo_id=%d\n",
+			ainfo->auth_algo);
+		return -1;
+	}
+}
+
+/*
+ * Pool of precomputed tuples for the recently seen subscribers. The
+ * entries and tuples are preallocated, the least recently used entry
+ * is recycled. A timer tops up the entries in batches after the
+ * location updatings, reading the keys of a whole batch with a single
+ * query. The pool lives in memory only, a restart simply refills it.
+ * Each entry remembers the key its tuples were computed with, the key
+ * can be changed in the HLR behind our back.
+ */
+#define AUTH_POOL_HASH_BITS	8
+#define AUTH_POOL_HASH_SIZE	(1 << AUTH_POOL_HASH_BITS)
+#define AUTH_POOL_REFILL_BATCH	32
+#define AUTH_POOL_REFILL_USEC	100000
+
+struct auth_pool_entry {
+	struct llist_head hash_list;
+	struct llist_head lru_list;
+	unsigned long long subscr_id;
+	struct gsm_auth_tuple *tuples;
+	unsigned int head;
+	unsigned int count;
+	/* the algorithm and Ki the tuples were computed with */
+	struct gsm_auth_info key;
+	/* no usable key at the last refill, wait for the next LU */
+	int no_key;
+};
+
+static struct {
+	struct auth_pool_entry *entries;
+	struct gsm_auth_tuple *tuples;
+	unsigned int nr_entries;
+	unsigned int nr_tuples;
+	/* most recently used first */
+	struct llist_head lru;
+	struct llist_head hash[AUTH_POOL_HASH_SIZE];
+	struct osmo_timer_list refill_timer;
+	struct auth_pool_stats stats;
+} pool;
+
+static struct llist_head *pool_bucket(unsigned long long subscr_id)
+{
+	return &pool.hash[((uint32_t) subscr_id * 2654435761u)
+				>> (32 - AUTH_POOL_HASH_BITS)];
+}
+
+static struct auth_pool_entry *pool_find(unsigned long long subscr_id)
+{
+	struct auth_pool_entry *entry;
+
+	llist_for_each_entry(entry, pool_bucket(subscr_id), hash_list)
+		if (entry->subscr_id == subscr_id)
+			return entry;
+	return NULL;
+}
+
+static int pool_key_matches(struct auth_pool_entry *entry,
+			    struct gsm_auth_info *ainfo)
+{
+	return entry->key.auth_algo == ainfo->auth_algo &&
+	       entry->key.a3a8_ki_len == ainfo->a3a8_ki_len &&
+	       !memcmp(entry->key.a3a8_ki, ainfo->a3a8_ki, ainfo->a3a8_ki_len);
+}
+
+/* the tuples left were computed with an old key, throw them away */
+static void pool_drop_stale(struct auth_pool_entry *entry,
+			    struct gsm_auth_info *ainfo)
+{
+	if (entry->count && !pool_key_matches(entry, ainfo)) {
+		LOGP(DMM, LOGL_INFO, "Key of subscriber %llu changed, "
+			"dropping %u precomputed tuples\n",
+			entry->subscr_id, entry->count);
+		pool.stats.stale += entry->count;
+		entry->head = 0;
+		entry->count = 0;
+	}
+	entry->key = *ainfo;
+}
+
+static void pool_refill_timer_cb(void *data)
+{
+	struct auth_pool_entry *batch[AUTH_POOL_REFILL_BATCH];
+	struct gsm_auth_info ainfo[AUTH_POOL_REFILL_BATCH];
+	unsigned long long ids[AUTH_POOL_REFILL_BATCH];
+	struct auth_pool_entry *entry;
+	unsigned int i, n = 0, pos, more = 0;
+
+	/* the most recently seen subscribers are topped up first */
+	llist_for_each_entry(entry, &pool.lru, lru_list) {
+		if (entry->no_key || entry->count == pool.nr_tuples)
+			continue;
+		if (n == AUTH_POOL_REFILL_BATCH) {
+			more = 1;
+			break;
+		}
+		ids[n] = entry->subscr_id;
+		batch[n++] = entry;
+	}
+
+	if (db_get_authinfo_for_subscr_ids(ainfo, ids, n) != 0) {
+		LOGP(DMM, LOGL_ERROR, "Failed to read keys for the auth pool\n");
+		return;
+	}
+
+	for (i = 0; i < n; ++i) {
+		entry = batch[i];
+		pool_drop_stale(entry, &ainfo[i]);
+
+		/* fill the free part of the ring, it may wrap around */
+		while (entry->count < pool.nr_tuples) {
+			unsigned int len;
+
+			pos = (entry->head + entry->count) % pool.nr_tuples;
+			len = pool.nr_tuples - entry->count;
+			if (pos + len > pool.nr_tuples)
+				len = pool.nr_tuples - pos;
+
+			if (_gen_tuples(&ainfo[i], &entry->tuples[pos], len)) {
+				entry->no_key = 1;
+				break;
+			}
+			entry->count += len;
+			pool.stats.generated += len;
+		}
+	}
+
+	if (more)
+		osmo_timer_schedule(&pool.refill_timer, 0,
+				    AUTH_POOL_REFILL_USEC);
+}
+
+static void pool_schedule_refill(void)
+{
+	if (!osmo_timer_pending(&pool.refill_timer))
+		osmo_timer_schedule(&pool.refill_timer, 0,
+				    AUTH_POOL_REFILL_USEC);
+}
+
+/* look up the subscriber's entry, recycling the oldest one if asked to */
+static struct auth_pool_entry *pool_get(unsigned long long subscr_id,
+					int create)
+{
+	struct auth_pool_entry *entry;
+
+	if (!pool.nr_entries)
+		return NULL;
+
+	entry = pool_find(subscr_id);
+	if (!entry && !create)
+		return NULL;
+	if (!entry) {
+		entry = llist_entry(pool.lru.prev, struct auth_pool_entry,
+				    lru_list);
+		llist_del(&entry->hash_list);
+		llist_add(&entry->hash_list, pool_bucket(subscr_id));
+		entry->subscr_id = subscr_id;
+		entry->head = 0;
+		entry->count = 0;
+		entry->no_key = 0;
+	}
+
+	llist_del(&entry->lru_list);
+	llist_add(&entry->lru_list, &pool.lru);
+	return entry;
+}
+
+int auth_pool_init(void *ctx, unsigned int subscribers, unsigned int tuples)
+{
+	unsigned int i;
+
+	osmo_timer_del(&pool.refill_timer);
+	talloc_free(pool.entries);
+	talloc_free(pool.tuples);
+	memset(&pool, 0, sizeof(pool));
+
+	INIT_LLIST_HEAD(&pool.lru);
+	for (i = 0; i < AUTH_POOL_HASH_SIZE; ++i)
+		INIT_LLIST_HEAD(&pool.hash[i]);
+	pool.refill_timer.cb = pool_refill_timer_cb;
+
+	if (subscribers == 0 || tuples == 0)
+		return 0;
+
+	pool.entries = talloc_zero_array(ctx, struct auth_pool_entry,
+					 subscribers);
+	pool.tuples = talloc_zero_array(ctx, struct gsm_auth_tuple,
+					subscribers * tuples);
+	if (!pool.entries || !pool.tuples) {
+		talloc_free(pool.entries);
+		talloc_free(pool.tuples);
+		pool.entries = NULL;
+		pool.tuples = NULL;
+		return -ENOMEM;
+	}
+
+	pool.nr_entries = subscribers;
+	pool.nr_tuples = tuples;
+
+	/* unused entries are unhashed and at the tail of the LRU */
+	for (i = 0; i < subscribers; ++i) {
+		struct auth_pool_entry *entry = &pool.entries[i];
+
+		entry->tuples = &pool.tuples[i * tuples];
+		entry->no_key = 1;
+		INIT_LLIST_HEAD(&entry->hash_list);
+		llist_add_tail(&entry->lru_list, &pool.lru);
+	}
+
+	return 0;
+}
+
+/* drop the precomputed tuples, e.g. after the key has been changed */
+void auth_pool_flush_subscr(unsigned long long subscr_id)
+{
+	struct auth_pool_entry *entry;
+
+	if (!pool.nr_entries)
+		return;
+
+	entry = pool_find(subscr_id);
+	if (!entry)
+		return;
+
+	entry->head = 0;
+	entry->count = 0;
+	entry->no_key = 0;
+}
+
+void auth_pool_get_stats(struct auth_pool_stats *stats)
+{
+	*stats = pool.stats;
+	stats->subscribers = pool.nr_entries;
+	stats->tuples = pool.nr_tuples;
+}
+
 /* Return values 
  *  -1 -> Internal error
  *   0 -> Not available
@@ -75,16 +352,28 @@ int auth_get_tuple_for_subscr(struct gsm_auth_tuple *atuple,
                               struct gsm_subscriber *subscr, int key_seq)
 {
 	struct gsm_auth_info ainfo;
-	int i, rc;
+	struct auth_pool_entry *entry;
+	int rc;
+
+	entry = pool_get(subscr->id, 0);
 
 	/* Get subscriber info (if any) */
 	rc = db_get_authinfo_for_subscr(&ainfo, subscr);
 	if (rc < 0) {
 		LOGP(DMM, LOGL_NOTICE,
 			"No retrievable Ki for subscriber, skipping auth\n");
+		if (entry && rc == -ENOENT) {
+			entry->head = 0;
+			entry->count = 0;
+			entry->no_key = 1;
+		}
 		return rc == -ENOENT ? AUTH_NOT_AVAIL : -1;
 	}
 
+	/* The precomputed tuples are only good for the current key */
+	if (entry)
+		pool_drop_stale(entry, &ainfo);
+
 	/* If possible, re-use the last tuple and skip auth */
 	rc = db_get_lastauthtuple_for_subscr(atuple, subscr);
 	if ((rc == 0) &&
@@ -100,33 +389,41 @@ int auth_get_tuple_for_subscr(struct gsm_auth_tuple *atuple,
 	/* Generate a new one */
 	atuple->use_count = 1;
 	atuple->key_seq = (atuple->key_seq + 1) % 7;
-        for (i=0; i<sizeof(atuple->rand); i++)
-                atuple->rand[i] = random() & 0xff;
 
-	switch (ainfo.auth_algo) {
-	case AUTH_ALGO_NONE:
-		DEBUGP(DMM, "No authentication for subscriber\n");
-		return 0;
+	if (entry && entry->count) {
+		struct gsm_auth_tuple *pooled = &entry->tuples[entry->head];
 
-	case AUTH_ALGO_XOR:
-		if (_use_xor(&ainfo, atuple))
-			return 0;
-		break;
+		memcpy(atuple->rand, pooled->rand, sizeof(atuple->rand));
+		memcpy(atuple->sres, pooled->sres, sizeof(atuple->sres));
+		memcpy(atuple->kc, pooled->kc, sizeof(atuple->kc));
+		entry->head = (entry->head + 1) % pool.nr_tuples;
+		entry->count -= 1;
+		pool.stats.hits += 1;
+	} else {
+		if (pool.nr_entries)
+			pool.stats.misses += 1;
 
-	case AUTH_ALGO_COMP128v1:
-		if (_use_comp128_v1(&ainfo, atuple))
+		rc = _gen_tuples(&ainfo, atuple, 1);
+		if (rc > 0) {
+			DEBUGP(DMM, "No authentication for subscriber\n");
+			return 0;
+		} else if (rc < 0)
 			return 0;
-		break;
 
-	default:
-		DEBUGP(DMM, "Unsupported auth type algo_id=%d\n",
-			ainfo.auth_algo);
-		return 0;
+		/* the key is usable (again), precompute from now on */
+		if (!entry)
+			entry = pool_get(subscr->id, 1);
+		if (entry) {
+			entry->key = ainfo;
+			entry->no_key = 0;
+		}
 	}
 
+	if (entry && entry->count < pool.nr_tuples && !entry->no_key)
+		pool_schedule_refill();
+
         db_sync_lastauthtuple_for_subscr(atuple, subscr);
 
 	DEBUGP(DMM, "Need to do authentication and ciphering\n");
 	return AUTH_DO_AUTH_THAN_CIPH;
 }
-
@@ -33,15 +33,19 @@
 #include <openbsc/gsm_04_11.h>
 #include <openbsc/db.h>
 #include <openbsc/debug.h>
+#include <openbsc/rate_ctr_groups.h>
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/statistics.h>
 #include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/timer.h>
 
 static char *db_basename = NULL;
 static char *db_dirname = NULL;
 static dbi_conn conn;
 
+static int db_transaction(const char *stmt);
+
 static char *create_stmts[] = {
 	"CREATE TABLE IF NOT EXISTS Meta ("
 		"id INTEGER PRIMARY KEY AUTOINCREMENT, "
@@ -247,6 +251,7 @@ int db_prepare(void)
 
 int db_fini(void)
 {
+	db_sms_flush();
 	dbi_conn_close(conn);
 	dbi_shutdown();
 
@@ -377,6 +382,59 @@ int db_get_authinfo_for_subscr(struct gsm_auth_info *ainfo,
 	return 0;
 }
 
+/* read the keys of several subscribers with a single query, subscribers
+ * without an entry in AuthKeys are returned as AUTH_ALGO_NONE */
+int db_get_authinfo_for_subscr_ids(struct gsm_auth_info *ainfo,
+				   const unsigned long long *ids,
+				   unsigned int num)
+{
+	char id_list[DB_AUTHINFO_BATCH * 21];
+	dbi_result result;
+	const unsigned char *a3a8_ki;
+	unsigned long long id;
+	unsigned int i, len = 0;
+
+	if (num == 0)
+		return 0;
+	if (num > DB_AUTHINFO_BATCH)
+		return -EINVAL;
+
+	for (i = 0; i < num; ++i) {
+		memset(&ainfo[i], 0, sizeof(ainfo[i]));
+		ainfo[i].auth_algo = AUTH_ALGO_NONE;
+		len += snprintf(id_list + len, sizeof(id_list) - len,
+				"%s%llu", i ? "," : "", ids[i]);
+	}
+
+	result = dbi_conn_queryf(conn,
+			"SELECT * FROM AuthKeys WHERE subscriber_id IN (%s)",
+			id_list);
+	if (!result)
+		return -EIO;
+
+	while (dbi_result_next_row(result)) {
+		id = dbi_result_get_ulonglong(result, "subscriber_id");
+		for (i = 0; i < num; ++i)
+			if (ids[i] == id)
+				break;
+		if (i == num)
+			continue;
+
+		ainfo[i].auth_algo =
+			dbi_result_get_ulonglong(result, "algorithm_id");
+		ainfo[i].a3a8_ki_len =
+			dbi_result_get_field_length(result, "a3a8_ki");
+		a3a8_ki = dbi_result_get_binary(result, "a3a8_ki");
+		if (ainfo[i].a3a8_ki_len > sizeof(ainfo[i].a3a8_ki))
+			ainfo[i].a3a8_ki_len = sizeof(ainfo[i].a3a8_ki);
+		memcpy(ainfo[i].a3a8_ki, a3a8_ki, ainfo[i].a3a8_ki_len);
+	}
+
+	dbi_result_free(result);
+
+	return 0;
+}
+
 int db_sync_authinfo_for_subscr(struct gsm_auth_info *ainfo,
                                 struct gsm_subscriber *subscr)
 {
@@ -1017,11 +1075,14 @@ int db_sms_store(struct gsm_sms *sms)
 	if (!result)
 		return -EIO;
 
+	sms->id = dbi_conn_sequence_last(conn, NULL);
 	dbi_result_free(result);
 	return 0;
 }
 
-static struct gsm_sms *sms_from_result(struct gsm_network *net, dbi_result result)
+/* receiver can be passed in by callers that already know it */
+static struct gsm_sms *sms_from_result(struct gsm_network *net, dbi_result result,
+				       struct gsm_subscriber *receiver)
 {
 	struct gsm_sms *sms = sms_alloc();
 	long long unsigned int sender_id, receiver_id;
@@ -1034,10 +1095,17 @@ static struct gsm_sms *sms_from_result(struct gsm_network *net, dbi_result resul
 	sms->id = dbi_result_get_ulonglong(result, "id");
 
 	sender_id = dbi_result_get_ulonglong(result, "sender_id");
-	sms->sender = subscr_get_by_id(net, sender_id);
-
 	receiver_id = dbi_result_get_ulonglong(result, "receiver_id");
-	sms->receiver = subscr_get_by_id(net, receiver_id);
+
+	if (receiver && receiver->id == receiver_id)
+		sms->receiver = subscr_get(receiver);
+	else
+		sms->receiver = subscr_get_by_id(net, receiver_id);
+
+	if (sms->receiver && sender_id == receiver_id)
+		sms->sender = subscr_get(sms->receiver);
+	else
+		sms->sender = subscr_get_by_id(net, sender_id);
 
 	/* FIXME: validity */
 	/* FIXME: those should all be get_uchar, but sqlite3 is braindead */
@@ -1074,6 +1142,8 @@ struct gsm_sms *db_sms_get(struct gsm_network *net, unsigned long long id)
 	dbi_result result;
 	struct gsm_sms *sms;
 
+	db_sms_flush();
+
 	result = dbi_conn_queryf(conn,
 		"SELECT * FROM SMS WHERE SMS.id = %llu", id);
 	if (!result)
@@ -1084,7 +1154,7 @@ struct gsm_sms *db_sms_get(struct gsm_network *net, unsigned long long id)
 		return NULL;
 	}
 
-	sms = sms_from_result(net, result);
+	sms = sms_from_result(net, result, NULL);
 
 	dbi_result_free(result);
 
@@ -1097,6 +1167,8 @@ struct gsm_sms *db_sms_get_unsent(struct gsm_network *net, unsigned long long mi
 	dbi_result result;
 	struct gsm_sms *sms;
 
+	db_sms_flush();
+
 	result = dbi_conn_queryf(conn,
 		"SELECT SMS.* "
 			"FROM SMS JOIN Subscriber ON "
@@ -1113,7 +1185,7 @@ struct gsm_sms *db_sms_get_unsent(struct gsm_network *net, unsigned long long mi
 		return NULL;
 	}
 
-	sms = sms_from_result(net, result);
+	sms = sms_from_result(net, result, NULL);
 
 	dbi_result_free(result);
 
@@ -1127,6 +1199,8 @@ struct gsm_sms *db_sms_get_unsent_by_subscr(struct gsm_network *net,
 	dbi_result result;
 	struct gsm_sms *sms;
 
+	db_sms_flush();
+
 	result = dbi_conn_queryf(conn,
 		"SELECT SMS.* "
 			"FROM SMS JOIN Subscriber ON "
@@ -1143,7 +1217,7 @@ struct gsm_sms *db_sms_get_unsent_by_subscr(struct gsm_network *net,
 		return NULL;
 	}
 
-	sms = sms_from_result(net, result);
+	sms = sms_from_result(net, result, NULL);
 
 	dbi_result_free(result);
 
@@ -1156,6 +1230,8 @@ struct gsm_sms *db_sms_get_unsent_for_subscr(struct gsm_subscriber *subscr)
 	dbi_result result;
 	struct gsm_sms *sms;
 
+	db_sms_flush();
+
 	result = dbi_conn_queryf(conn,
 		"SELECT SMS.* "
 			"FROM SMS JOIN Subscriber ON "
@@ -1172,50 +1248,190 @@ struct gsm_sms *db_sms_get_unsent_for_subscr(struct gsm_subscriber *subscr)
 		return NULL;
 	}
 
-	sms = sms_from_result(subscr->net, result);
+	sms = sms_from_result(subscr->net, result, subscr);
 
 	dbi_result_free(result);
 
 	return sms;
 }
 
-/* mark a given SMS as read */
-int db_sms_mark_sent(struct gsm_sms *sms)
+/* retrieve an SMS by id if it is still unsent and not failed too often */
+struct gsm_sms *db_sms_get_unsent_by_id(struct gsm_network *net,
+					unsigned long long id,
+					unsigned int failed)
 {
 	dbi_result result;
+	struct gsm_sms *sms;
+
+	db_sms_flush();
 
 	result = dbi_conn_queryf(conn,
-		"UPDATE SMS "
-		"SET sent = datetime('now') "
-		"WHERE id = %llu", sms->id);
-	if (!result) {
-		LOGP(DDB, LOGL_ERROR, "Failed to mark SMS %llu as sent.\n", sms->id);
-		return 1;
+		"SELECT * FROM SMS "
+			"WHERE id = %llu AND sent IS NULL "
+				"AND deliver_attempts < %u",
+		id, failed);
+	if (!result)
+		return NULL;
+
+	if (!dbi_result_next_row(result)) {
+		dbi_result_free(result);
+		return NULL;
 	}
 
+	sms = sms_from_result(net, result, NULL);
+
 	dbi_result_free(result);
-	return 0;
+
+	return sms;
 }
 
-/* increase the number of attempted deliveries */
-int db_sms_inc_deliver_attempts(struct gsm_sms *sms)
+/* walk all unsent SMS with ID >= min_id that did not fail too often,
+ * ordered by receiver and SMS id, with a single query */
+int db_sms_for_each_unsent(unsigned long long min_id, unsigned int failed,
+			   int (*cb)(unsigned long long sms_id,
+				     unsigned long long receiver_id,
+				     int attached, void *data),
+			   void *data)
 {
 	dbi_result result;
+	int rc = 0;
+
+	db_sms_flush();
 
 	result = dbi_conn_queryf(conn,
-		"UPDATE SMS "
-		"SET deliver_attempts = deliver_attempts + 1 "
-		"WHERE id = %llu", sms->id);
-	if (!result) {
-		LOGP(DDB, LOGL_ERROR, "Failed to inc deliver attempts for "
-			"SMS %llu.\n", sms->id);
-		return 1;
+		"SELECT SMS.id, SMS.receiver_id, Subscriber.lac "
+			"FROM SMS JOIN Subscriber ON "
+				"SMS.receiver_id = Subscriber.id "
+			"WHERE SMS.id >= %llu AND SMS.sent IS NULL "
+				"AND SMS.deliver_attempts < %u "
+			"ORDER BY SMS.receiver_id, SMS.id",
+		min_id, failed);
+	if (!result)
+		return -EIO;
+
+	while (rc == 0 && dbi_result_next_row(result)) {
+		rc = cb(dbi_result_get_ulonglong(result, "id"),
+			dbi_result_get_ulonglong(result, "receiver_id"),
+			dbi_result_get_uint(result, "lac") > 0, data);
 	}
 
 	dbi_result_free(result);
+	return rc;
+}
+
+/*
+ * Marking an SMS as sent and counting delivery attempts happens for
+ * every delivery. The updates are collected and written within one
+ * transaction, at the latest a second later or before the SMS table
+ * is read again. A failed transaction is rolled back and the updates
+ * are kept for the next attempt.
+ */
+#define SMS_UPDATE_BATCH	128
+
+enum sms_update_type {
+	SMS_UPDATE_SENT,
+	SMS_UPDATE_ATTEMPT,
+};
+
+static struct {
+	unsigned long long id;
+	enum sms_update_type type;
+} sms_updates[SMS_UPDATE_BATCH];
+static unsigned int sms_updates_len;
+
+static void sms_update_timer_cb(void *data)
+{
+	db_sms_flush();
+}
+
+static struct osmo_timer_list sms_update_timer = {
+	.cb = sms_update_timer_cb,
+};
+
+int db_sms_flush(void)
+{
+	dbi_result result;
+	unsigned int i;
+	int rc = 0;
+
+	if (osmo_timer_pending(&sms_update_timer))
+		osmo_timer_del(&sms_update_timer);
+
+	if (sms_updates_len == 0)
+		return 0;
+
+	if (db_transaction("BEGIN TRANSACTION") != 0)
+		goto retry;
+
+	for (i = 0; i < sms_updates_len && rc == 0; i++) {
+		unsigned long long id = sms_updates[i].id;
+
+		if (sms_updates[i].type == SMS_UPDATE_SENT)
+			result = dbi_conn_queryf(conn,
+				"UPDATE SMS "
+				"SET sent = datetime('now') "
+				"WHERE id = %llu", id);
+		else
+			result = dbi_conn_queryf(conn,
+				"UPDATE SMS "
+				"SET deliver_attempts = deliver_attempts + 1 "
+				"WHERE id = %llu", id);
+		if (!result) {
+			LOGP(DDB, LOGL_ERROR, "Failed to %s SMS %llu.\n",
+			     sms_updates[i].type == SMS_UPDATE_SENT ?
+				"mark as sent" : "inc deliver attempts for",
+			     id);
+			rc = -EIO;
+			break;
+		}
+		dbi_result_free(result);
+	}
+
+	if (rc == 0)
+		rc = db_transaction("COMMIT");
+	if (rc != 0) {
+		db_transaction("ROLLBACK");
+		goto retry;
+	}
+
+	sms_updates_len = 0;
+	return 0;
+
+retry:
+	osmo_timer_schedule(&sms_update_timer, 1, 0);
+	return -EIO;
+}
+
+static int sms_update_queue(struct gsm_sms *sms, enum sms_update_type type)
+{
+	if (sms_updates_len == SMS_UPDATE_BATCH && db_sms_flush() != 0) {
+		LOGP(DDB, LOGL_ERROR, "Failed to queue the update of SMS %llu.\n",
+		     sms->id);
+		return -EIO;
+	}
+
+	sms_updates[sms_updates_len].id = sms->id;
+	sms_updates[sms_updates_len].type = type;
+	sms_updates_len += 1;
+
+	if (!osmo_timer_pending(&sms_update_timer))
+		osmo_timer_schedule(&sms_update_timer, 1, 0);
+
 	return 0;
 }
 
+/* mark a given SMS as read */
+int db_sms_mark_sent(struct gsm_sms *sms)
+{
+	return sms_update_queue(sms, SMS_UPDATE_SENT);
+}
+
+/* increase the number of attempted deliveries */
+int db_sms_inc_deliver_attempts(struct gsm_sms *sms)
+{
+	return sms_update_queue(sms, SMS_UPDATE_ATTEMPT);
+}
+
 int db_apdu_blob_store(struct gsm_subscriber *subscr,
 			uint8_t apdu_id_flags, uint8_t len,
 			uint8_t *apdu)
@@ -1240,6 +1456,21 @@ int db_apdu_blob_store(struct gsm_subscriber *subscr,
 	return 0;
 }
 
+/* BEGIN/COMMIT, groups several statements into one sync */
+static int db_transaction(const char *stmt)
+{
+	dbi_result result;
+
+	result = dbi_conn_query(conn, stmt);
+	if (!result) {
+		LOGP(DDB, LOGL_ERROR, "Failed to execute %s.\n", stmt);
+		return -EIO;
+	}
+
+	dbi_result_free(result);
+	return 0;
+}
+
 int db_store_counter(struct osmo_counter *ctr)
 {
 	dbi_result result;
@@ -1289,13 +1520,70 @@ int db_store_rate_ctr_group(struct rate_ctr_group *ctrg)
 {
 	unsigned int i;
 	char *q_prefix;
+	int rc = 0;
 
 	dbi_conn_quote_string_copy(conn, ctrg->desc->group_name_prefix, &q_prefix);
 
-	for (i = 0; i < ctrg->desc->num_ctr; i++)
-		db_store_rate_ctr(ctrg, i, q_prefix);
+	for (i = 0; i < ctrg->desc->num_ctr && rc == 0; i++)
+		rc = db_store_rate_ctr(ctrg, i, q_prefix);
 
 	free(q_prefix);
 
+	return rc;
+}
+
+static int _db_store_counter(struct osmo_counter *counter, void *data)
+{
+	return db_store_counter(counter);
+}
+
+static int _db_store_rate_ctr_group(struct rate_ctr_group *ctrg, void *data)
+{
+	return db_store_rate_ctr_group(ctrg);
+}
+
+/* store a snapshot of all counters and rate counter groups within a
+ * single transaction */
+int db_store_counters(void)
+{
+	int rc;
+
+	if (db_transaction("BEGIN TRANSACTION") != 0)
+		return -EIO;
+
+	/* the iterations stop at the first failed insert */
+	rc = osmo_counters_for_each(_db_store_counter, NULL);
+	if (rc == 0)
+		rc = bsc_rate_ctr_for_each_group(_db_store_rate_ctr_group, NULL);
+
+	if (rc == 0)
+		rc = db_transaction("COMMIT");
+	if (rc != 0) {
+		db_transaction("ROLLBACK");
+		return -EIO;
+	}
+
+	return 0;
+}
+
+/* remove counter snapshots older than the given number of days */
+int db_prune_counters(unsigned int days)
+{
+	dbi_result result;
+
+	result = dbi_conn_queryf(conn,
+		"DELETE FROM Counters "
+		"WHERE timestamp < datetime('now', '-%u days')", days);
+	if (!result)
+		return -EIO;
+	dbi_result_free(result);
+
+	result = dbi_conn_queryf(conn,
+		"DELETE FROM RateCounters "
+		"WHERE timestamp < datetime('now', '-%u days')", days);
+	if (!result)
+		return -EIO;
+	dbi_result_free(result);
+
 	return 0;
 }
@@ -55,16 +55,54 @@ struct gsm_sms_pending {
 	int no_detach;
 };
 
+/*
+ * The unsent SMS of one receiver, ordered by SMS id. Only the ids are
+ * kept in memory, the SMS is read from the database when it is sent.
+ */
+struct sms_queue_rcpt {
+	struct llist_head entry;	/* smsq->rcpts, ordered by subscr_id */
+	struct llist_head hentry;	/* smsq->rcpt_hash */
+
+	unsigned long long subscr_id;
+	int attached;
+
+	struct llist_head sms;		/* struct sms_queue_entry */
+};
+
+struct sms_queue_entry {
+	struct llist_head entry;
+	unsigned long long sms_id;
+};
+
+#define SMSQ_RCPT_HASH_SIZE	1024
+
+/* SMS that failed this often are no longer taken from the queue */
+#define SMSQ_MAX_ATTEMPTS	10
+
+/* SMS can be inserted into the database by other programs, they are
+ * picked up by looking for new ids this often */
+#define SMSQ_RESCAN_SEC		60
+
 struct gsm_sms_queue {
 	struct osmo_timer_list resend_pending;
 	struct osmo_timer_list push_queue;
+	struct osmo_timer_list rescan;
 	struct gsm_network *network;
 	int max_fail;
 	int max_pending;
 	int pending;
 
 	struct llist_head pending_sms;
-	unsigned long long last_subscr_id;
+
+	/* receivers with unsent SMS and where the next round starts */
+	struct llist_head rcpts;
+	struct llist_head rcpt_hash[SMSQ_RCPT_HASH_SIZE];
+	struct sms_queue_rcpt *next_rcpt;
+	unsigned int nr_rcpts;
+	unsigned int queued;
+
+	/* the highest SMS id seen by a scan of the database */
+	unsigned long long scanned_id;
 };
 
 static int sms_subscr_cb(unsigned int, unsigned int, void *, void *);
@@ -108,6 +146,198 @@ static int sms_subscriber_is_pending(struct gsm_sms_queue *smsq,
 	return sms_subscriber_find_pending(smsq, subscr) != NULL;
 }
 
+static int sms_subscriber_id_is_pending(struct gsm_sms_queue *smsq,
+					unsigned long long subscr_id)
+{
+	struct gsm_sms_pending *pending;
+
+	llist_for_each_entry(pending, &smsq->pending_sms, entry) {
+		if (pending->subscr->id == subscr_id)
+			return 1;
+	}
+
+	return 0;
+}
+
+static struct llist_head *rcpt_bucket(struct gsm_sms_queue *smsq,
+				      unsigned long long subscr_id)
+{
+	return &smsq->rcpt_hash[subscr_id & (SMSQ_RCPT_HASH_SIZE - 1)];
+}
+
+static struct sms_queue_rcpt *rcpt_find(struct gsm_sms_queue *smsq,
+					unsigned long long subscr_id)
+{
+	struct sms_queue_rcpt *rcpt;
+
+	llist_for_each_entry(rcpt, rcpt_bucket(smsq, subscr_id), hentry) {
+		if (rcpt->subscr_id == subscr_id)
+			return rcpt;
+	}
+
+	return NULL;
+}
+
+static struct sms_queue_rcpt *rcpt_find_or_alloc(struct gsm_sms_queue *smsq,
+						 unsigned long long subscr_id)
+{
+	struct sms_queue_rcpt *rcpt, *prev;
+
+	rcpt = rcpt_find(smsq, subscr_id);
+	if (rcpt)
+		return rcpt;
+
+	rcpt = talloc_zero(smsq, struct sms_queue_rcpt);
+	if (!rcpt)
+		return NULL;
+
+	rcpt->subscr_id = subscr_id;
+	INIT_LLIST_HEAD(&rcpt->sms);
+	llist_add(&rcpt->hentry, rcpt_bucket(smsq, subscr_id));
+
+	/* keep the list ordered, new receivers usually go to the end */
+	llist_for_each_entry_reverse(prev, &smsq->rcpts, entry) {
+		if (prev->subscr_id < subscr_id)
+			break;
+	}
+	llist_add(&rcpt->entry, &prev->entry);
+
+	smsq->nr_rcpts += 1;
+	return rcpt;
+}
+
+static void rcpt_free(struct gsm_sms_queue *smsq, struct sms_queue_rcpt *rcpt)
+{
+	struct sms_queue_entry *entry;
+
+	if (smsq->next_rcpt == rcpt) {
+		if (rcpt->entry.next == &smsq->rcpts)
+			smsq->next_rcpt = NULL;
+		else
+			smsq->next_rcpt = llist_entry(rcpt->entry.next,
+						struct sms_queue_rcpt, entry);
+	}
+
+	llist_for_each_entry(entry, &rcpt->sms, entry)
+		smsq->queued -= 1;
+
+	llist_del(&rcpt->entry);
+	llist_del(&rcpt->hentry);
+	smsq->nr_rcpts -= 1;
+	talloc_free(rcpt);
+}
+
+static int rcpt_add_sms(struct gsm_sms_queue *smsq, struct sms_queue_rcpt *rcpt,
+			unsigned long long sms_id)
+{
+	struct sms_queue_entry *entry, *prev;
+
+	/* ids are handed out in ascending order, so new SMS usually go to
+	 * the end. A rescan can find SMS that were already added. */
+	llist_for_each_entry_reverse(prev, &rcpt->sms, entry) {
+		if (prev->sms_id == sms_id)
+			return 0;
+		if (prev->sms_id < sms_id)
+			break;
+	}
+
+	entry = talloc_zero(rcpt, struct sms_queue_entry);
+	if (!entry)
+		return -1;
+
+	entry->sms_id = sms_id;
+	llist_add(&entry->entry, &prev->entry);
+	smsq->queued += 1;
+	return 0;
+}
+
+static void rcpt_del_sms(struct gsm_sms_queue *smsq, struct sms_queue_rcpt *rcpt,
+			 struct sms_queue_entry *entry)
+{
+	llist_del(&entry->entry);
+	talloc_free(entry);
+	smsq->queued -= 1;
+
+	if (llist_empty(&rcpt->sms))
+		rcpt_free(smsq, rcpt);
+}
+
+/* forget a SMS that was delivered */
+static void sms_queue_remove(struct gsm_sms_queue *smsq, struct gsm_sms *sms)
+{
+	struct sms_queue_rcpt *rcpt;
+	struct sms_queue_entry *entry;
+
+	if (!sms->receiver)
+		return;
+
+	rcpt = rcpt_find(smsq, sms->receiver->id);
+	if (!rcpt)
+		return;
+
+	llist_for_each_entry(entry, &rcpt->sms, entry) {
+		if (entry->sms_id == sms->id) {
+			rcpt_del_sms(smsq, rcpt, entry);
+			return;
+		}
+	}
+}
+
+static void sms_queue_set_attached(struct gsm_sms_queue *smsq,
+				   unsigned long long subscr_id, int attached)
+{
+	struct sms_queue_rcpt *rcpt;
+
+	rcpt = rcpt_find(smsq, subscr_id);
+	if (rcpt)
+		rcpt->attached = attached;
+}
+
+static int sms_queue_load_cb(unsigned long long sms_id,
+			     unsigned long long receiver_id,
+			     int attached, void *data)
+{
+	struct gsm_sms_queue *smsq = data;
+	struct sms_queue_rcpt *rcpt;
+
+	if (sms_id > smsq->scanned_id)
+		smsq->scanned_id = sms_id;
+
+	rcpt = rcpt_find_or_alloc(smsq, receiver_id);
+	if (!rcpt)
+		return -1;
+
+	rcpt->attached = attached;
+	return rcpt_add_sms(smsq, rcpt, sms_id);
+}
+
+/* pick up the SMS that were added to the database behind our back */
+static unsigned int sms_queue_scan(struct gsm_sms_queue *smsq)
+{
+	unsigned int queued = smsq->queued;
+
+	if (db_sms_for_each_unsent(smsq->scanned_id + 1, SMSQ_MAX_ATTEMPTS,
+				   sms_queue_load_cb, smsq) < 0)
+		LOGP(DSMS, LOGL_ERROR, "Failed to load the new SMS.\n");
+
+	if (smsq->queued == queued)
+		return 0;
+
+	LOGP(DSMS, LOGL_NOTICE, "SMSqueue found %u new SMS\n",
+	     smsq->queued - queued);
+	return smsq->queued - queued;
+}
+
+static void sms_queue_rescan(void *_data)
+{
+	struct gsm_sms_queue *smsq = _data;
+
+	if (sms_queue_scan(smsq))
+		sms_queue_trigger(smsq);
+
+	osmo_timer_schedule(&smsq->rescan, SMSQ_RESCAN_SEC, 0);
+}
+
 static struct gsm_sms_pending *sms_pending_from(struct gsm_sms_queue *smsq,
 						struct gsm_sms *sms)
 {
@@ -160,6 +390,7 @@ static void sms_pending_failed(struct gsm_sms_pending *pending, int paging_error
 		     "Subscriber %llu is not reachable. Setting LAC=0.\n", pending->subscr->id);
 		pending->subscr->lac = GSM_LAC_RESERVED_DETACHED;
 		db_sync_subscriber(pending->subscr);
+		sms_queue_set_attached(smsq, pending->subscr->id, 0);
 
 		/* Workaround a failing sync */
 		db_subscriber_update(pending->subscr);
@@ -198,25 +429,84 @@ static void sms_resend_pending(void *_data)
 	}
 }
 
-static struct gsm_sms *take_next_sms(struct gsm_sms_queue *smsq)
+/* the receiver to look at next, the rounds wrap around at the end */
+static struct sms_queue_rcpt *next_rcpt(struct gsm_sms_queue *smsq)
+{
+	struct sms_queue_rcpt *rcpt = smsq->next_rcpt;
+
+	if (!rcpt) {
+		if (llist_empty(&smsq->rcpts))
+			return NULL;
+		rcpt = llist_entry(smsq->rcpts.next, struct sms_queue_rcpt, entry);
+	}
+
+	if (rcpt->entry.next == &smsq->rcpts)
+		smsq->next_rcpt = NULL;
+	else
+		smsq->next_rcpt = llist_entry(rcpt->entry.next,
+					      struct sms_queue_rcpt, entry);
+	return rcpt;
+}
+
+/* load the oldest SMS of a receiver that can still be sent */
+static struct gsm_sms *rcpt_first_sms(struct gsm_sms_queue *smsq,
+				      struct sms_queue_rcpt *rcpt)
 {
+	struct sms_queue_entry *entry;
 	struct gsm_sms *sms;
 
-	sms = db_sms_get_unsent_by_subscr(smsq->network, smsq->last_subscr_id, 10);
-	if (sms) {
-		smsq->last_subscr_id = sms->receiver->id + 1;
-		return sms;
+	while (1) {
+		entry = llist_entry(rcpt->sms.next, struct sms_queue_entry, entry);
+		sms = db_sms_get_unsent_by_id(smsq->network, entry->sms_id,
+					      SMSQ_MAX_ATTEMPTS);
+		if (sms && sms->receiver)
+			break;
+
+		/* sent, failed too often or gone. This frees the receiver
+		 * together with its last SMS. */
+		if (sms)
+			sms_free(sms);
+		if (entry->entry.next == &rcpt->sms) {
+			rcpt_del_sms(smsq, rcpt, entry);
+			return NULL;
+		}
+		rcpt_del_sms(smsq, rcpt, entry);
+	}
+
+	if (sms->receiver->lac == GSM_LAC_RESERVED_DETACHED) {
+		rcpt->attached = 0;
+		sms_free(sms);
+		return NULL;
 	}
 
-	/* need to wrap around */
-	smsq->last_subscr_id = 0;
-	sms = db_sms_get_unsent_by_subscr(smsq->network,
-					  smsq->last_subscr_id, 10);
-	if (sms)
-		smsq->last_subscr_id = sms->receiver->id + 1;
 	return sms;
 }
 
+static struct gsm_sms *take_next_sms(struct gsm_sms_queue *smsq)
+{
+	struct sms_queue_rcpt *rcpt;
+	unsigned int i, nr_rcpts = smsq->nr_rcpts;
+
+	for (i = 0; i < nr_rcpts; i++) {
+		struct gsm_sms *sms;
+
+		rcpt = next_rcpt(smsq);
+		if (!rcpt)
+			break;
+
+		if (!rcpt->attached)
+			continue;
+		if (sms_subscriber_id_is_pending(smsq, rcpt->subscr_id))
+			continue;
+
+		sms = rcpt_first_sms(smsq, rcpt);
+		if (sms)
+			return sms;
+	}
+
+	return NULL;
+}
+
 /**
  * I will submit up to max_pending - pending SMS to the
  * subsystem.
@@ -292,6 +582,15 @@ static void sms_submit_pending(void *_data)
 	LOGP(DSMS, LOGL_DEBUG, "SMSqueue added %d messages in %d rounds\n", attempted, rounds);
 }
 
+/* a kick also looks for SMS added by others, at most once a second */
+static void sms_push_queue(void *_data)
+{
+	struct gsm_sms_queue *smsq = _data;
+
+	sms_queue_scan(smsq);
+	sms_submit_pending(smsq);
+}
+
 /*
  * Kick off the queue again.
  */
@@ -307,6 +606,8 @@ int sms_queue_trigger(struct gsm_sms_queue *smsq)
 int sms_queue_start(struct gsm_network *network, int max_pending)
 {
 	struct gsm_sms_queue *sms = talloc_zero(network, struct gsm_sms_queue);
+	unsigned int i;
+
 	if (!sms) {
 		LOGP(DMSC, LOGL_ERROR, "Failed to create the SMS queue.\n");
 		return -1;
@@ -317,13 +618,24 @@ int sms_queue_start(struct gsm_network *network, int max_pending)
 
 	network->sms_queue = sms;
 	INIT_LLIST_HEAD(&sms->pending_sms);
+	INIT_LLIST_HEAD(&sms->rcpts);
+	for (i = 0; i < SMSQ_RCPT_HASH_SIZE; i++)
+		INIT_LLIST_HEAD(&sms->rcpt_hash[i]);
 	sms->max_fail = 1;
 	sms->network = network;
 	sms->max_pending = max_pending;
 	sms->push_queue.data = sms;
-	sms->push_queue.cb = sms_submit_pending;
+	sms->push_queue.cb = sms_push_queue;
 	sms->resend_pending.data = sms;
 	sms->resend_pending.cb = sms_resend_pending;
+	sms->rescan.data = sms;
+	sms->rescan.cb = sms_queue_rescan;
+
+	if (db_sms_for_each_unsent(0, SMSQ_MAX_ATTEMPTS, sms_queue_load_cb, sms) < 0)
+		LOGP(DSMS, LOGL_ERROR, "Failed to load the unsent SMS.\n");
+	LOGP(DSMS, LOGL_NOTICE, "SMSqueue loaded %u SMS for %u receivers\n",
+	     sms->queued, sms->nr_rcpts);
+	osmo_timer_schedule(&sms->rescan, SMSQ_RESCAN_SEC, 0);
 
 	sms_submit_pending(sms);
 
@@ -375,13 +687,36 @@ static int sub_ready_for_sm(struct gsm_network *net, struct gsm_subscriber *subs
 static int sms_subscr_cb(unsigned int subsys, unsigned int signal,
 			 void *handler_data, void *signal_data)
 {
+	struct gsm_network *net = handler_data;
 	struct gsm_subscriber *subscr = signal_data;
 
-	if (signal != S_SUBSCR_ATTACHED)
+	switch (signal) {
+	case S_SUBSCR_ATTACHED:
+		sms_queue_set_attached(net->sms_queue, subscr->id, 1);
+		/* this is readyForSM */
+		return sub_ready_for_sm(net, subscr);
+	case S_SUBSCR_DETACHED:
+		sms_queue_set_attached(net->sms_queue, subscr->id, 0);
+		break;
+	}
+
+	return 0;
+}
+
+/* add a SMS that was just stored in the database */
+int sms_queue_add(struct gsm_sms_queue *smsq, struct gsm_sms *sms)
+{
+	struct sms_queue_rcpt *rcpt;
+
+	if (!sms->receiver || !sms->id)
 		return 0;
 
-	/* this is readyForSM */
-	return sub_ready_for_sm(handler_data, subscr);
+	rcpt = rcpt_find_or_alloc(smsq, sms->receiver->id);
+	if (!rcpt)
+		return -1;
+
+	rcpt->attached = sms->receiver->lac != GSM_LAC_RESERVED_DETACHED;
+	return rcpt_add_sms(smsq, rcpt, sms->id);
 }
 
 static int sms_sms_cb(unsigned int subsys, unsigned int signal,
@@ -393,6 +728,8 @@ static int sms_sms_cb(unsigned int subsys, unsigned int signal,
 
 	/* We got a new SMS and maybe should launch the queue again. */
 	if (signal == S_SMS_SUBMITTED || signal == S_SMS_SMMA) {
+		if (signal == S_SMS_SUBMITTED && sig_sms->sms)
+			sms_queue_add(network->sms_queue, sig_sms->sms);
 		sms_queue_trigger(network->sms_queue);
 		return 0;
 	}
@@ -400,6 +737,10 @@ static int sms_sms_cb(unsigned int subsys, unsigned int signal,
 	if (!sig_sms->sms)
 		return -1;
 
+	/* delivered SMS are gone, no matter who sent them */
+	if (signal == S_SMS_DELIVERED)
+		sms_queue_remove(network->sms_queue, sig_sms->sms);
+
 
 	/*
 	 * Find the entry of our queue. The SMS subsystem will submit
@@ -474,6 +815,8 @@ int sms_queue_stats(struct gsm_sms_queue *smsq, struct vty *vty)
 
 	vty_out(vty, "SMSqueue with max_pending: %d pending: %d%s",
 		smsq->max_pending, smsq->pending, VTY_NEWLINE);
+	vty_out(vty, " %u unsent SMS for %u receivers%s",
+		smsq->queued, smsq->nr_rcpts, VTY_NEWLINE);
 
 	llist_for_each_entry(pending, &smsq->pending_sms, entry)
 		vty_out(vty, " SMS Pending for Subscriber: %llu SMS: %llu Failed: %d.%s",
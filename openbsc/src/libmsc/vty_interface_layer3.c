@@ -38,6 +38,7 @@
 #include <osmocom/gsm/gsm_utils.h>
 #include <osmocom/core/utils.h>
 #include <openbsc/db.h>
+#include <openbsc/auth.h>
 #include <osmocom/core/talloc.h>
 #include <openbsc/signal.h>
 #include <openbsc/debug.h>
@@ -156,6 +157,7 @@ static int _send_sms_str(struct gsm_subscriber *receiver, char *str,
 		return CMD_WARNING;
 	}
 
+	sms_queue_add(receiver->net->sms_queue, sms);
 	sms_free(sms);
 	sms_queue_trigger(receiver->net->sms_queue);
 	return CMD_SUCCESS;
@@ -605,6 +607,7 @@ DEFUN(ena_subscr_a3a8,
 
 	/* the last tuple probably invalid with the new auth settings */
 	db_sync_lastauthtuple_for_subscr(NULL, subscr);
+	auth_pool_flush_subscr(subscr->id);
 	subscr_put(subscr);
 
 	if (rc) {
@@ -708,6 +711,27 @@ DEFUN(show_stats,
 	return CMD_SUCCESS;
 }
 
+DEFUN(show_auth_pool,
+      show_auth_pool_cmd,
+      "show auth-pool",
+      SHOW_STR "Display statistics of the precomputed auth tuples\n")
+{
+	struct auth_pool_stats stats;
+
+	auth_pool_get_stats(&stats);
+	if (!stats.subscribers) {
+		vty_out(vty, "Auth tuple pool is disabled%s", VTY_NEWLINE);
+		return CMD_SUCCESS;
+	}
+
+	vty_out(vty, "Auth tuple pool for %u subscribers, %u tuples each%s",
+		stats.subscribers, stats.tuples, VTY_NEWLINE);
+	vty_out(vty, " %llu generated, %llu hits, %llu misses, %llu stale%s",
+		stats.generated, stats.hits, stats.misses, stats.stale,
+		VTY_NEWLINE);
+	return CMD_SUCCESS;
+}
+
 DEFUN(show_smsqueue,
       show_smsqueue_cmd,
       "show sms-queue",
@@ -763,6 +787,19 @@ DEFUN(smsqueue_fail,
 	return CMD_SUCCESS;
 }
 
+DEFUN(ena_counters_prune,
+      ena_counters_prune_cmd,
+      "database prune-counters <1-3650>",
+      "Database\n" "Remove stored counter snapshots\n"
+      "Keep the snapshots of this many days\n")
+{
+	if (db_prune_counters(atoi(argv[0])) != 0) {
+		vty_out(vty, "%% Failed to prune the counters%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	return CMD_SUCCESS;
+}
 
 DEFUN(cfg_mncc_int, cfg_mncc_int_cmd,
       "mncc-int", "Configure internal MNCC handler")
@@ -843,6 +880,7 @@ int bsc_vty_init_extra(void)
 	install_element_ve(&subscriber_update_cmd);
 	install_element_ve(&show_stats_cmd);
 	install_element_ve(&show_smsqueue_cmd);
+	install_element_ve(&show_auth_pool_cmd);
 
 	install_element(ENABLE_NODE, &ena_subscr_name_cmd);
 	install_element(ENABLE_NODE, &ena_subscr_extension_cmd);
@@ -857,6 +895,7 @@ int bsc_vty_init_extra(void)
 	install_element(ENABLE_NODE, &smsqueue_clear_cmd);
 	install_element(ENABLE_NODE, &smsqueue_fail_cmd);
 	install_element(ENABLE_NODE, &subscriber_send_pending_sms_cmd);
+	install_element(ENABLE_NODE, &ena_counters_prune_cmd);
 
 	install_element(CONFIG_NODE, &cfg_mncc_int_cmd);
 	install_node(&mncc_int_node, config_write_mncc_int);
@@ -46,23 +46,64 @@ static const uint8_t gsm_fr_map[] = {
 	3, 3, 3, 3
 };
 
+#define GSM_FR_BITS	260
+#define GSM_FR_BYTES	33
+
+/* position in the TRAU d-bits of each bit of a GSM FR frame */
+static uint16_t gsm_fr_bit_pos[GSM_FR_BITS];
+static int gsm_fr_bit_pos_valid;
+
 struct map_entry {
-	struct llist_head list;
+	/* entries in ss_map_src_hash and ss_map_dst_hash */
+	struct llist_head src_list;
+	struct llist_head dst_list;
 	struct gsm_e1_subslot src, dst;
 };
 
 struct upqueue_entry {
 	struct llist_head list;
+	/* entry in ss_upqueue_hash */
+	struct llist_head hash_list;
 	struct gsm_network *net;
 	struct gsm_e1_subslot src;
 	uint32_t callref;
 };
 
-static LLIST_HEAD(ss_map);
+#define SS_HASH_SIZE	256
+
+static struct llist_head ss_map_src_hash[SS_HASH_SIZE];
+static struct llist_head ss_map_dst_hash[SS_HASH_SIZE];
+static struct llist_head ss_upqueue_hash[SS_HASH_SIZE];
 static LLIST_HEAD(ss_upqueue);
 
 void *tall_map_ctx, *tall_upq_ctx;
 
+static __attribute__((constructor)) void on_dso_load_trau_mux(void)
+{
+	int i;
+
+	for (i = 0; i < SS_HASH_SIZE; i++) {
+		INIT_LLIST_HEAD(&ss_map_src_hash[i]);
+		INIT_LLIST_HEAD(&ss_map_dst_hash[i]);
+		INIT_LLIST_HEAD(&ss_upqueue_hash[i]);
+	}
+}
+
+static struct llist_head *ss_bucket(struct llist_head *hash,
+				    const struct gsm_e1_subslot *ss)
+{
+	uint32_t key = (ss->e1_nr << 16) | (ss->e1_ts << 8) | ss->e1_ts_ss;
+
+	return &hash[(key * 2654435761u) >> 24];
+}
+
+static int ss_equal(const struct gsm_e1_subslot *a,
+		    const struct gsm_e1_subslot *b)
+{
+	return a->e1_nr == b->e1_nr && a->e1_ts == b->e1_ts
+		&& a->e1_ts_ss == b->e1_ts_ss;
+}
+
 /* map one particular subslot to another subslot */
 int trau_mux_map(const struct gsm_e1_subslot *src,
 		 const struct gsm_e1_subslot *dst)
@@ -86,7 +127,8 @@ int trau_mux_map(const struct gsm_e1_subslot *src,
 
 	memcpy(&me->src, src, sizeof(me->src));
 	memcpy(&me->dst, dst, sizeof(me->dst));
-	llist_add(&me->list, &ss_map);
+	llist_add(&me->src_list, ss_bucket(ss_map_src_hash, &me->src));
+	llist_add(&me->dst_list, ss_bucket(ss_map_dst_hash, &me->dst));
 
 	return 0;
 }
@@ -103,27 +145,43 @@ int trau_mux_map_lchan(const struct gsm_lchan *src,
 }
 
 
+/* look-up an enty in the TRAU mux map, an entry maps both ways */
+static struct map_entry *lookup_map_entry(const struct gsm_e1_subslot *ss)
+{
+	struct map_entry *me;
+
+	llist_for_each_entry(me, ss_bucket(ss_map_src_hash, ss), src_list) {
+		if (ss_equal(&me->src, ss))
+			return me;
+	}
+	llist_for_each_entry(me, ss_bucket(ss_map_dst_hash, ss), dst_list) {
+		if (ss_equal(&me->dst, ss))
+			return me;
+	}
+	return NULL;
+}
+
 /* unmap one particular subslot from another subslot */
 int trau_mux_unmap(const struct gsm_e1_subslot *ss, uint32_t callref)
 {
-	struct map_entry *me, *me2;
+	struct map_entry *me;
 	struct upqueue_entry *ue, *ue2;
 
-	if (ss)
-		llist_for_each_entry_safe(me, me2, &ss_map, list) {
-			if (!memcmp(&me->src, ss, sizeof(*ss)) ||
-			    !memcmp(&me->dst, ss, sizeof(*ss))) {
-				llist_del(&me->list);
-				return 0;
-			}
-		}
-	llist_for_each_entry_safe(ue, ue2, &ss_upqueue, list) {
-		if (ue->callref == callref) {
-			llist_del(&ue->list);
+	if (ss) {
+		me = lookup_map_entry(ss);
+		if (me) {
+			llist_del(&me->src_list);
+			llist_del(&me->dst_list);
+			talloc_free(me);
 			return 0;
 		}
-		if (ss && !memcmp(&ue->src, ss, sizeof(*ss))) {
+	}
+	llist_for_each_entry_safe(ue, ue2, &ss_upqueue, list) {
+		if (ue->callref == callref ||
+		    (ss && ss_equal(&ue->src, ss))) {
 			llist_del(&ue->list);
+			llist_del(&ue->hash_list);
+			talloc_free(ue);
 			return 0;
 		}
 	}
@@ -134,15 +192,13 @@ int trau_mux_unmap(const struct gsm_e1_subslot *ss, uint32_t callref)
 static struct gsm_e1_subslot *
 lookup_trau_mux_map(const struct gsm_e1_subslot *src)
 {
-	struct map_entry *me;
+	struct map_entry *me = lookup_map_entry(src);
 
-	llist_for_each_entry(me, &ss_map, list) {
-		if (!memcmp(&me->src, src, sizeof(*src)))
-			return &me->dst;
-		if (!memcmp(&me->dst, src, sizeof(*src)))
-			return &me->src;
-	}
-	return NULL;
+	if (!me)
+		return NULL;
+	if (ss_equal(&me->src, src))
+		return &me->dst;
+	return &me->src;
 }
 
 /* look-up an enty in the TRAU upqueue */
@@ -151,13 +207,77 @@ lookup_trau_upqueue(const struct gsm_e1_subslot *src)
 {
 	struct upqueue_entry *ue;
 
-	llist_for_each_entry(ue, &ss_upqueue, list) {
-		if (!memcmp(&ue->src, src, sizeof(*src)))
+	llist_for_each_entry(ue, ss_bucket(ss_upqueue_hash, src), hash_list) {
+		if (ss_equal(&ue->src, src))
 			return ue;
 	}
 	return NULL;
 }
 
+static void gsm_fr_bit_pos_init(void)
+{
+	int i = 0, k, l, o = 0;
+
+	/* the bits of each parameter are sent MSB first */
+	for (l = 0; l < ARRAY_SIZE(gsm_fr_map); l++) {
+		for (k = gsm_fr_map[l] - 1; k >= 0; k--)
+			gsm_fr_bit_pos[i++] = o + k;
+		o += gsm_fr_map[l];
+	}
+	gsm_fr_bit_pos_valid = 1;
+}
+
+/* pack the d-bits into a GSM FR frame, a byte at a time */
+static void gsm_fr_pack(uint8_t *data, const uint8_t *d_bits)
+{
+	const uint16_t *pos = gsm_fr_bit_pos;
+	int i;
+
+	if (!gsm_fr_bit_pos_valid)
+		gsm_fr_bit_pos_init();
+
+	/* the frame starts with the 0xd signature */
+	data[0] = 0xd << 4 | d_bits[pos[0]] << 3 | d_bits[pos[1]] << 2
+		| d_bits[pos[2]] << 1 | d_bits[pos[3]];
+	pos += 4;
+
+	for (i = 1; i < GSM_FR_BYTES; i++, pos += 8)
+		data[i] = d_bits[pos[0]] << 7 | d_bits[pos[1]] << 6
+			| d_bits[pos[2]] << 5 | d_bits[pos[3]] << 4
+			| d_bits[pos[4]] << 3 | d_bits[pos[5]] << 2
+			| d_bits[pos[6]] << 1 | d_bits[pos[7]];
+}
+
+/* and unpack a GSM FR frame into the d-bits */
+static void gsm_fr_unpack(uint8_t *d_bits, const uint8_t *data)
+{
+	const uint16_t *pos = gsm_fr_bit_pos;
+	uint8_t byte;
+	int i;
+
+	if (!gsm_fr_bit_pos_valid)
+		gsm_fr_bit_pos_init();
+
+	byte = data[0];
+	d_bits[pos[0]] = (byte >> 3) & 1;
+	d_bits[pos[1]] = (byte >> 2) & 1;
+	d_bits[pos[2]] = (byte >> 1) & 1;
+	d_bits[pos[3]] = byte & 1;
+	pos += 4;
+
+	for (i = 1; i < GSM_FR_BYTES; i++, pos += 8) {
+		byte = data[i];
+		d_bits[pos[0]] = byte >> 7;
+		d_bits[pos[1]] = (byte >> 6) & 1;
+		d_bits[pos[2]] = (byte >> 5) & 1;
+		d_bits[pos[3]] = (byte >> 4) & 1;
+		d_bits[pos[4]] = (byte >> 3) & 1;
+		d_bits[pos[5]] = (byte >> 2) & 1;
+		d_bits[pos[6]] = (byte >> 1) & 1;
+		d_bits[pos[7]] = byte & 1;
+	}
+}
+
 static const uint8_t c_bits_check[] = { 0, 0, 0, 1, 0 };
 
 /* we get called by subchan_demux */
@@ -179,8 +299,6 @@ int trau_mux_input(struct gsm_e1_subslot *src_e1_ss,
 	if (!dst_e1_ss) {
 		struct msgb *msg;
 		struct gsm_data_frame *frame;
-		unsigned char *data;
-		int i, j, k, l, o;
 		/* frame shall be sent to upqueue */
 		if (!(ue = lookup_trau_upqueue(src_e1_ss)))
 			return -EINVAL;
@@ -189,33 +307,18 @@ int trau_mux_input(struct gsm_e1_subslot *src_e1_ss,
 		if (memcmp(tf.c_bits, c_bits_check, sizeof(c_bits_check)))
 			DEBUGPC(DLMUX, "illegal trau (C1-C5) %s\n",
 				osmo_hexdump(tf.c_bits, sizeof(c_bits_check)));
-		msg = msgb_alloc(sizeof(struct gsm_data_frame) + 33,
+		msg = msgb_alloc(sizeof(struct gsm_data_frame) + GSM_FR_BYTES,
 				 "GSM-DATA");
 		if (!msg)
 			return -ENOMEM;
 
 		frame = (struct gsm_data_frame *)msg->data;
 		memset(frame, 0, sizeof(struct gsm_data_frame));
-		data = frame->data;
-		data[0] = 0xd << 4;
 		/* reassemble d-bits */
-		i = 0; /* counts bits */
-		j = 4; /* counts output bits */
-		k = gsm_fr_map[0]-1; /* current number bit in element */
-		l = 0; /* counts element bits */
-		o = 0; /* offset input bits */
-		while (i < 260) {
-			data[j/8] |= (tf.d_bits[k+o] << (7-(j%8)));
-			if (--k < 0) {
-				o += gsm_fr_map[l];
-				k = gsm_fr_map[++l]-1;
-			}
-			i++;
-			j++;
-		}
+		gsm_fr_pack(frame->data, tf.d_bits);
 		frame->msg_type = GSM_TCHF_FRAME;
 		frame->callref = ue->callref;
-		msgb_put(msg, sizeof(struct gsm_data_frame) + 33);
+		msgb_put(msg, sizeof(struct gsm_data_frame) + GSM_FR_BYTES);
 		trau_tx_to_mncc(ue->net, msg);
 
 		return 0;
@@ -271,6 +374,7 @@ int trau_recv_lchan(struct gsm_lchan *lchan, uint32_t callref)
 	ue->net = lchan->ts->trx->bts->network;
 	ue->callref = callref;
 	llist_add(&ue->list, &ss_upqueue);
+	llist_add(&ue->hash_list, ss_bucket(ss_upqueue_hash, &ue->src));
 
 	return 0;
 }
@@ -280,8 +384,6 @@ int trau_send_frame(struct gsm_lchan *lchan, struct gsm_data_frame *frame)
 	uint8_t trau_bits_out[TRAU_FRAME_BITS];
 	struct gsm_e1_subslot *dst_e1_ss = &lchan->ts->e1_link;
 	struct subch_mux *mx;
-	int i, j, k, l, o;
-	unsigned char *data = frame->data;
 	struct decoded_trau_frame tf;
 
 	mx = e1inp_get_mux(dst_e1_ss->e1_nr, dst_e1_ss->e1_ts);
@@ -300,20 +402,7 @@ int trau_send_frame(struct gsm_lchan *lchan, struct gsm_data_frame *frame)
 		memset(&tf.c_bits[11], 1, 10);
 		memset(&tf.t_bits[0], 1, 4);
 		/* reassemble d-bits */
-		i = 0; /* counts bits */
-		j = 4; /* counts input bits */
-		k = gsm_fr_map[0]-1; /* current number bit in element */
-		l = 0; /* counts element bits */
-		o = 0; /* offset output bits */
-		while (i < 260) {
-			tf.d_bits[k+o] = (data[j/8] >> (7-(j%8))) & 1;
-			if (--k < 0) {
-				o += gsm_fr_map[l];
-				k = gsm_fr_map[++l]-1;
-			}
-			i++;
-			j++;
-		}
+		gsm_fr_unpack(tf.d_bits, frame->data);
 		break;
 	default:
 		DEBUGPC(DLMUX, "unsupported message type %d\n",
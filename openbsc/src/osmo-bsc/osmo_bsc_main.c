@@ -27,10 +27,12 @@
 #include <openbsc/signal.h>
 #include <openbsc/vty.h>
 #include <openbsc/ipaccess.h>
+#include <openbsc/pdu_trace.h>
 
 #include <osmocom/core/application.h>
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/talloc.h>
+#include <osmocom/core/rate_ctr.h>
 #include <osmocom/gsm/protocol/gsm_12_21.h>
 
 #include <osmocom/sccp/sccp.h>
@@ -394,6 +396,7 @@ int main(int argc, char **argv)
 	tall_bsc_ctx = talloc_named_const(NULL, 1, "openbsc");
 
 	osmo_init_logging(&log_info);
+	rate_ctr_init(tall_bsc_ctx);
 
 	bts_init();
 	libosmo_abis_init(tall_bsc_ctx);
@@ -404,6 +407,8 @@ int main(int argc, char **argv)
 	vty_info.copyright = openbsc_copyright;
 	vty_init(&vty_info);
 	bsc_vty_init(&log_info);
+	pdu_trace_vty_init();
+	pdu_trace_init(tall_bsc_ctx, PDU_TRACE_DEF_ENTRIES, PDU_TRACE_DEF_SNAPLEN);
 
 	/* parse options */
 	handle_options(argc, argv);
@@ -185,7 +185,8 @@ static int msc_alink_do_write(struct osmo_fd *fd, struct msgb *msg)
 	int ret;
 
 	LOGP(DMSC, LOGL_DEBUG, "Sending SCCP to MSC: %u\n", msgb_l2len(msg));
-	LOGP(DLMI, LOGL_DEBUG, "MSC TX %s\n", osmo_hexdump(msg->data, msg->len));
+	if (log_level_enabled(DLMI, LOGL_DEBUG))
+		LOGP(DLMI, LOGL_DEBUG, "MSC TX %s\n", osmo_hexdump(msg->data, msg->len));
 
 	ret = write(fd->fd, msg->data, msg->len);
 	if (ret < msg->len)
@@ -263,7 +264,9 @@ static int ipaccess_a_fd_cb(struct osmo_fd *bfd)
 		return -1;
 	}
 
-	LOGP(DLMI, LOGL_DEBUG, "From MSC: %s proto: %d\n", osmo_hexdump(msg->data, msg->len), msg->l2h[0]);
+	if (log_level_enabled(DLMI, LOGL_DEBUG))
+		LOGP(DLMI, LOGL_DEBUG, "From MSC: %s proto: %d\n",
+		     osmo_hexdump(msg->data, msg->len), msg->l2h[0]);
 
 	/* handle base message handling */
 	hh = (struct ipaccess_head *) msg->data;
@@ -44,6 +44,7 @@
 #include <openbsc/abis_nm.h>
 #include <openbsc/socket.h>
 #include <openbsc/vty.h>
+#include <openbsc/pdu_trace.h>
 
 #include <osmocom/core/application.h>
 #include <osmocom/core/talloc.h>
@@ -103,7 +104,7 @@ static void queue_for_msc(struct bsc_msc_connection *con, struct msgb *msg)
 		return;
 	}
 
-
+	pdu_trace_record(PDU_TRACE_IPA, PDU_TRACE_TX, 0, msg->data, msg->len);
 	if (osmo_wqueue_enqueue(&con->write_queue, msg) != 0) {
 		LOGP(DLINP, LOGL_ERROR, "Failed to enqueue the write.\n");
 		msgb_free(msg);
@@ -311,6 +312,7 @@ static void nat_send_rlc(struct bsc_msc_connection *msc_con,
 		LOGP(DNAT, LOGL_ERROR, "Failed to allocate clear command.\n");
 		return;
 	}
+	osmo_counter_inc(nat->stats.msg.allocs);
 
 	msg->l2h = msgb_put(msg, sizeof(*rlc));
 	rlc = (struct sccp_connection_release_complete *) msg->l2h;
@@ -495,7 +497,7 @@ static void bsc_send_con_refuse(struct bsc_connection *bsc,
 		con->con_type = NAT_CON_TYPE_LOCAL_REJECT;
 		con->con_local = NAT_CON_END_LOCAL;
 		con->has_remote_ref = 1;
-		con->remote_ref = con->patched_ref;
+		sccp_connection_set_remote_ref(con, &con->patched_ref);
 
 		/* 1. create a confirmation */
 		cc = sccp_create_cc(&con->remote_ref, &con->real_ref);
@@ -560,6 +562,7 @@ static void bsc_nat_send_paging(struct bsc_connection *bsc, struct msgb *msg)
 		return;
 	}
 
+	osmo_counter_inc(bsc->nat->stats.msg.allocs);
 	bsc_send_data(bsc, msg->l2h, msgb_l2len(msg), IPAC_PROTO_SCCP);
 }
 
@@ -634,13 +637,15 @@ static int forward_sccp_to_bts(struct bsc_msc_connection *msc_con, struct msgb *
 {
 	struct sccp_connections *con = NULL;
 	struct bsc_connection *bsc;
-	struct bsc_nat_parsed *parsed;
+	struct bsc_nat_parsed parsed_msg, *parsed = &parsed_msg;
 	int proto;
 
+	pdu_trace_record(PDU_TRACE_IPA, PDU_TRACE_RX, 0, msg->data, msg->len);
+
 	/* filter, drop, patch the message? */
-	parsed = bsc_nat_parse(msg);
-	if (!parsed) {
+	if (bsc_nat_parse_into(msg, parsed) != 0) {
 		LOGP(DNAT, LOGL_ERROR, "Can not parse msg from BSC.\n");
+		msgb_free(msg);
 		return -1;
 	}
 
@@ -706,17 +711,22 @@ static int forward_sccp_to_bts(struct bsc_msc_connection *msc_con, struct msgb *
 			LOGP(DNAT, LOGL_ERROR, "Unknown connection for msg type: 0x%x from the MSC.\n", parsed->sccp_type);
 	}
 
-	talloc_free(parsed);
-	if (!con)
+	if (!con) {
+		msgb_free(msg);
 		return -1;
+	}
 	if (!con->bsc->authenticated) {
 		LOGP(DNAT, LOGL_ERROR, "Selected BSC not authenticated.\n");
+		msgb_free(msg);
 		return -1;
 	}
 
 	update_con_authorize(con, parsed, msg);
 
-	bsc_send_data(con->bsc, msg->l2h, msgb_l2len(msg), proto);
+	/* hand on the received msgb, only the IPA header is rebuilt */
+	msgb_pull(msg, msg->l2h - msg->data);
+	bsc_write(con->bsc, msg, proto);
+	osmo_counter_inc(nat->stats.msg.forwarded);
 	return 0;
 
 send_to_all:
@@ -734,11 +744,12 @@ send_to_all:
 		if (!bsc->authenticated)
 			continue;
 
+		osmo_counter_inc(nat->stats.msg.allocs);
 		bsc_send_data(bsc, msg->l2h, msgb_l2len(msg), parsed->ipa_proto);
 	}
 
 exit:
-	talloc_free(parsed);
+	msgb_free(msg);
 	return 0;
 }
 
@@ -804,7 +815,9 @@ static int ipaccess_msc_read_cb(struct osmo_fd *bfd)
 		return -1;
 	}
 
-	LOGP(DNAT, LOGL_DEBUG, "MSG from MSC: %s proto: %d\n", osmo_hexdump(msg->data, msg->len), msg->l2h[0]);
+	if (log_level_enabled(DNAT, LOGL_DEBUG))
+		LOGP(DNAT, LOGL_DEBUG, "MSG from MSC: %s proto: %d\n",
+		     osmo_hexdump(msg->data, msg->len), msg->l2h[0]);
 
 	/* handle base message handling */
 	hh = (struct ipaccess_head *) msg->data;
@@ -816,8 +829,11 @@ static int ipaccess_msc_read_cb(struct osmo_fd *bfd)
 			initialize_msc_if_needed(msc_con);
 		else if (msg->l2h[0] == IPAC_MSGT_ID_GET)
 			send_id_get_response(msc_con);
-	} else if (hh->proto == IPAC_PROTO_SCCP)
+	} else if (hh->proto == IPAC_PROTO_SCCP) {
+		/* the msg is consumed */
 		forward_sccp_to_bts(msc_con, msg);
+		return 0;
+	}
 
 	msgb_free(msg);
 	return 0;
@@ -978,11 +994,13 @@ static int forward_sccp_to_msc(struct bsc_connection *bsc, struct msgb *msg)
 	struct bsc_msc_connection *con_msc = NULL;
 	struct bsc_connection *con_bsc = NULL;
 	int con_type;
-	struct bsc_nat_parsed *parsed;
+	struct bsc_nat_parsed parsed_msg, *parsed = &parsed_msg;
+
+	pdu_trace_record(PDU_TRACE_IPA, PDU_TRACE_RX,
+			 bsc->cfg ? bsc->cfg->nr + 1 : 0xffff, msg->data, msg->len);
 
 	/* Parse and filter messages */
-	parsed = bsc_nat_parse(msg);
-	if (!parsed) {
+	if (bsc_nat_parse_into(msg, parsed) != 0) {
 		LOGP(DNAT, LOGL_ERROR, "Can not parse msg from BSC.\n");
 		msgb_free(msg);
 		return -1;
@@ -1007,6 +1025,7 @@ static int forward_sccp_to_msc(struct bsc_connection *bsc, struct msgb *msg)
 	if (parsed->ipa_proto == IPAC_PROTO_SCCP) {
 		int filter;
 		struct sccp_connections *con;
+		struct msgb *rewritten;
 		switch (parsed->sccp_type) {
 		case SCCP_MSG_TYPE_CR:
 			filter = bsc_nat_filter_sccp_cr(bsc, msg, parsed, &con_type, &imsi);
@@ -1054,9 +1073,10 @@ static int forward_sccp_to_msc(struct bsc_connection *bsc, struct msgb *msg)
 					 * replace the msg and the parsed structure becomes
 					 * invalid.
 					 */
-					msg = bsc_nat_rewrite_msg(bsc->nat, msg, parsed, con->imsi);
-					talloc_free(parsed);
-					parsed = NULL;
+					rewritten = bsc_nat_rewrite_msg(bsc->nat, msg, parsed, con->imsi);
+					if (rewritten != msg)
+						parsed = NULL;
+					msg = rewritten;
 				} else if (con->con_local == NAT_CON_END_USSD) {
 					bsc_check_ussd(con, parsed, msg);
 				}
@@ -1115,8 +1135,7 @@ static int forward_sccp_to_msc(struct bsc_connection *bsc, struct msgb *msg)
 
 	/* send the non-filtered but maybe modified msg */
 	queue_for_msc(con_msc, msg);
-	if (parsed)
-		talloc_free(parsed);
+	osmo_counter_inc(bsc->nat->stats.msg.forwarded);
 	return 0;
 
 exit:
@@ -1147,7 +1166,6 @@ exit:
 exit2:
 	if (imsi)
 		talloc_free(imsi);
-	talloc_free(parsed);
 	msgb_free(msg);
 	return -1;
 
@@ -1156,7 +1174,6 @@ exit3:
 	if (imsi)
 		talloc_free(imsi);
 	bsc_send_con_refuse(bsc, parsed, con_type);
-	talloc_free(parsed);
 	msgb_free(msg);
 	return -1;
 }
@@ -1278,7 +1295,9 @@ static int ipaccess_bsc_read_cb(struct osmo_fd *bfd)
 	}
 
 
-	LOGP(DNAT, LOGL_DEBUG, "MSG from BSC: %s proto: %d\n", osmo_hexdump(msg->data, msg->len), msg->l2h[0]);
+	if (log_level_enabled(DNAT, LOGL_DEBUG))
+		LOGP(DNAT, LOGL_DEBUG, "MSG from BSC: %s proto: %d\n",
+		     osmo_hexdump(msg->data, msg->len), msg->l2h[0]);
 
 	/* Handle messages from the BSC */
 	hh = (struct ipaccess_head *) msg->data;
@@ -1725,6 +1744,8 @@ int main(int argc, char **argv)
 	vty_init(&vty_info);
 	logging_vty_add_cmds(&log_info);
 	bsc_nat_vty_init(nat);
+	pdu_trace_vty_init();
+	pdu_trace_init(tall_bsc_ctx, PDU_TRACE_DEF_ENTRIES, PDU_TRACE_DEF_SNAPLEN);
 
 
 	/* parse options */
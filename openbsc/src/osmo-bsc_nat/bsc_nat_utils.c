@@ -28,6 +28,7 @@
 #include <openbsc/debug.h>
 #include <openbsc/ipaccess.h>
 #include <openbsc/vty.h>
+#include <openbsc/pdu_trace.h>
 
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/talloc.h>
@@ -79,6 +80,7 @@ static const struct rate_ctr_group_desc bsc_cfg_acc_list_desc = {
 
 struct bsc_nat *bsc_nat_alloc(void)
 {
+	int i;
 	struct bsc_nat *nat = talloc_zero(tall_bsc_ctx, struct bsc_nat);
 	if (!nat)
 		return NULL;
@@ -90,6 +92,11 @@ struct bsc_nat *bsc_nat_alloc(void)
 	}
 
 	INIT_LLIST_HEAD(&nat->sccp_connections);
+	for (i = 0; i < ARRAY_SIZE(nat->sccp_by_patched); ++i) {
+		INIT_LLIST_HEAD(&nat->sccp_by_patched[i]);
+		INIT_LLIST_HEAD(&nat->sccp_by_real[i]);
+		INIT_LLIST_HEAD(&nat->sccp_by_remote[i]);
+	}
 	INIT_LLIST_HEAD(&nat->bsc_connections);
 	INIT_LLIST_HEAD(&nat->paging_groups);
 	INIT_LLIST_HEAD(&nat->bsc_configs);
@@ -105,6 +112,8 @@ struct bsc_nat *bsc_nat_alloc(void)
 	nat->stats.bsc.auth_fail = osmo_counter_alloc("nat.bsc.auth_fail");
 	nat->stats.msc.reconn = osmo_counter_alloc("nat.msc.conn");
 	nat->stats.ussd.reconn = osmo_counter_alloc("nat.ussd.conn");
+	nat->stats.msg.forwarded = osmo_counter_alloc("nat.msg.forwarded");
+	nat->stats.msg.allocs = osmo_counter_alloc("nat.msg.allocs");
 	nat->auth_timeout = 2;
 	nat->ping_timeout = 20;
 	nat->pong_timeout = 5;
@@ -274,6 +283,7 @@ void sccp_connection_destroy(struct sccp_connections *conn)
 	     sccp_src_ref_to_int(&conn->real_ref),
 	     sccp_src_ref_to_int(&conn->patched_ref), conn->bsc);
 	bsc_mgcp_dlcx(conn);
+	sccp_connection_unhash(conn);
 	llist_del(&conn->list_entry);
 	talloc_free(conn);
 }
@@ -337,7 +347,10 @@ int bsc_write_mgcp(struct bsc_connection *bsc, const uint8_t *data, unsigned int
 
 int bsc_write(struct bsc_connection *bsc, struct msgb *msg, int proto)
 {
-	return bsc_do_write(&bsc->write_queue, msg, proto);
+	ipaccess_prepend_header(msg, proto);
+	pdu_trace_record(PDU_TRACE_IPA, PDU_TRACE_TX,
+			 bsc->cfg ? bsc->cfg->nr + 1 : 0xffff, msg->data, msg->len);
+	return bsc_write_msg(&bsc->write_queue, msg);
 }
 
 int bsc_do_write(struct osmo_wqueue *queue, struct msgb *msg, int proto)
@@ -457,6 +470,7 @@ static int _cr_check_loc_upd(struct bsc_connection *bsc,
 
 	gsm48_mi_to_string(mi_string, sizeof(mi_string), lu->mi, lu->mi_len);
 	*imsi = talloc_strdup(bsc, mi_string);
+	osmo_counter_inc(bsc->nat->stats.msg.allocs);
 	return auth_imsi(bsc, mi_string);
 }
 
@@ -495,6 +509,7 @@ static int _cr_check_cm_serv_req(struct bsc_connection *bsc,
 		return 0;
 
 	*imsi = talloc_strdup(bsc, mi_string);
+	osmo_counter_inc(bsc->nat->stats.msg.allocs);
 	return auth_imsi(bsc, mi_string);
 }
 
@@ -522,6 +537,7 @@ static int _cr_check_pag_resp(struct bsc_connection *bsc,
 		return 0;
 
 	*imsi = talloc_strdup(bsc, mi_string);
+	osmo_counter_inc(bsc->nat->stats.msg.allocs);
 	return auth_imsi(bsc, mi_string);
 }
 
@@ -552,6 +568,7 @@ static int _dt_check_id_resp(struct bsc_connection *bsc,
 	ret = auth_imsi(bsc, mi_string);
 	con->imsi_checked = 1;
 	con->imsi = talloc_strdup(con, mi_string);
+	osmo_counter_inc(bsc->nat->stats.msg.allocs);
 	return ret;
 }
 
@@ -806,8 +823,10 @@ static char *rewrite_non_international(struct bsc_nat *nat, void *ctx, const cha
 			new_number = talloc_asprintf(ctx, "%s%s",
 					entry->replace,
 					&called->number[matches[1].rm_so]);
-		if (new_number)
+		if (new_number) {
+			osmo_counter_inc(nat->stats.msg.allocs);
 			break;
+		}
 	}
 
 	return new_number;
@@ -868,6 +887,7 @@ static struct msgb *rewrite_setup(struct bsc_nat *nat, struct msgb *msg,
 		talloc_free(new_number);
 		return NULL;
 	}
+	osmo_counter_inc(nat->stats.msg.allocs);
 
 	/* copy the header */
 	outptr = msgb_put(out, sizeof(*hdr48));
@@ -1019,8 +1039,10 @@ static struct msgb *rewrite_smsc(struct bsc_nat *nat, struct msgb *msg,
 			new_number = talloc_asprintf(msg, "%s%s",
 					entry->replace,
 					&smsc_addr[matches[1].rm_so]);
-		if (new_number)
+		if (new_number) {
+			osmo_counter_inc(nat->stats.msg.allocs);
 			break;
+		}
 	}
 
 	if (!new_number)
@@ -1054,6 +1076,7 @@ static struct msgb *rewrite_smsc(struct bsc_nat *nat, struct msgb *msg,
 		LOGP(DNAT, LOGL_ERROR, "Failed to allocate.\n");
 		return NULL;
 	}
+	osmo_counter_inc(nat->stats.msg.allocs);
 
 	out->l3h = out->data;
 	msgb_v_put(out, GSM411_MT_RP_DATA_MO);
@@ -1121,11 +1144,10 @@ struct msgb *bsc_nat_rewrite_msg(struct bsc_nat *nat, struct msgb *msg, struct b
 		LOGP(DNAT, LOGL_ERROR, "Failed to allocate.\n");
 		return msg;
 	}
+	osmo_counter_inc(nat->stats.msg.allocs);
 
 	ipaccess_prepend_header(sccp, IPAC_PROTO_SCCP);
 
-	/* the parsed hangs off from msg but it needs to survive */
-	talloc_steal(sccp, parsed);
 	msgb_free(msg);
 	return sccp;
 }
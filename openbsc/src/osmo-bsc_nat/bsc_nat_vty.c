@@ -270,6 +270,9 @@ static void dump_stat_total(struct vty *vty, struct bsc_nat *nat)
 	vty_out(vty, " BSC Connections %lu total, %lu auth failed.%s",
 		osmo_counter_get(nat->stats.bsc.reconn),
 		osmo_counter_get(nat->stats.bsc.auth_fail), VTY_NEWLINE);
+	vty_out(vty, " Messages %lu forwarded, %lu needed allocations%s",
+		osmo_counter_get(nat->stats.msg.forwarded),
+		osmo_counter_get(nat->stats.msg.allocs), VTY_NEWLINE);
 }
 
 static void dump_stat_bsc(struct vty *vty, struct bsc_config *conf)
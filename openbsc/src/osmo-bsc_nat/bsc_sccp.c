@@ -35,6 +35,71 @@ static int equal(struct sccp_source_reference *ref1, struct sccp_source_referenc
 	return memcmp(ref1, ref2, sizeof(*ref1)) == 0;
 }
 
+/*
+ * Every message going through the NAT needs to find its connection
+ * by one of the three references. Keep the connections hashed by
+ * each of them so the lookup does not scan all active connections.
+ */
+static unsigned int ref_hash(const struct sccp_source_reference *ref)
+{
+	uint32_t val = ref->octet1 | (ref->octet2 << 8) | (ref->octet3 << 16);
+
+	return (val ^ (val >> 8) ^ (val >> 16)) & (NAT_SCCP_HASH_SIZE - 1);
+}
+
+/*
+ * Until the MSC has confirmed the connection the remote ref is all zero.
+ * Hash those connections by the local ref instead so they do not all
+ * end up in the same bucket during call setup.
+ */
+static unsigned int remote_hash(const struct sccp_connections *conn)
+{
+	const struct sccp_source_reference *ref = &conn->remote_ref;
+
+	if (!ref->octet1 && !ref->octet2 && !ref->octet3)
+		ref = &conn->real_ref;
+	return ref_hash(ref);
+}
+
+static void hash_patched_ref(struct sccp_connections *conn, struct bsc_nat *nat)
+{
+	llist_add_tail(&conn->patched_hentry,
+		       &nat->sccp_by_patched[ref_hash(&conn->patched_ref)]);
+}
+
+static void hash_connection(struct sccp_connections *conn, struct bsc_nat *nat)
+{
+	hash_patched_ref(conn, nat);
+	llist_add_tail(&conn->real_hentry,
+		       &nat->sccp_by_real[ref_hash(&conn->real_ref)]);
+	llist_add_tail(&conn->remote_hentry,
+		       &nat->sccp_by_remote[remote_hash(conn)]);
+}
+
+void sccp_connection_unhash(struct sccp_connections *conn)
+{
+	/* connections created outside of create_sccp_src_ref are not hashed */
+	if (!conn->patched_hentry.next)
+		return;
+
+	llist_del(&conn->patched_hentry);
+	llist_del(&conn->real_hentry);
+	llist_del(&conn->remote_hentry);
+	conn->patched_hentry.next = NULL;
+}
+
+void sccp_connection_set_remote_ref(struct sccp_connections *conn,
+				    struct sccp_source_reference *ref)
+{
+	conn->remote_ref = *ref;
+	if (!conn->patched_hentry.next)
+		return;
+
+	llist_del(&conn->remote_hentry);
+	llist_add_tail(&conn->remote_hentry,
+		       &conn->bsc->nat->sccp_by_remote[remote_hash(conn)]);
+}
+
 /*
  * SCCP patching below
  */
@@ -44,7 +109,7 @@ static int sccp_ref_is_free(struct sccp_source_reference *ref, struct bsc_nat *n
 {
 	struct sccp_connections *conn;
 
-	llist_for_each_entry(conn, &nat->sccp_connections, list_entry) {
+	llist_for_each_entry(conn, &nat->sccp_by_patched[ref_hash(ref)], patched_hentry) {
 		if (memcmp(ref, &conn->patched_ref, sizeof(*ref)) == 0)
 			return -1;
 	}
@@ -86,24 +151,31 @@ struct sccp_connections *create_sccp_src_ref(struct bsc_connection *bsc,
 					     struct bsc_nat_parsed *parsed)
 {
 	struct sccp_connections *conn;
+	struct sccp_source_reference null_ref;
+	unsigned int hash = ref_hash(parsed->src_local_ref);
 
 	/* Some commercial BSCs like to reassign there SRC ref */
-	llist_for_each_entry(conn, &bsc->nat->sccp_connections, list_entry) {
+	llist_for_each_entry(conn, &bsc->nat->sccp_by_real[hash], real_hentry) {
 		if (conn->bsc != bsc)
 			continue;
 		if (memcmp(&conn->real_ref, parsed->src_local_ref, sizeof(conn->real_ref)) != 0)
 			continue;
 
 		/* the BSC has reassigned the SRC ref and we failed to keep track */
-		memset(&conn->remote_ref, 0, sizeof(conn->remote_ref));
+		memset(&null_ref, 0, sizeof(null_ref));
+		sccp_connection_set_remote_ref(conn, &null_ref);
+		llist_del(&conn->patched_hentry);
 		if (assign_src_local_reference(&conn->patched_ref, bsc->nat) != 0) {
 			LOGP(DNAT, LOGL_ERROR, "BSC %d reused src ref: %d and we failed to generate a new id.\n",
 			     bsc->cfg->nr, sccp_src_ref_to_int(parsed->src_local_ref));
 			bsc_mgcp_dlcx(conn);
+			llist_del(&conn->real_hentry);
+			llist_del(&conn->remote_hentry);
 			llist_del(&conn->list_entry);
 			talloc_free(conn);
 			return NULL;
 		} else {
+			hash_patched_ref(conn, bsc->nat);
 			clock_gettime(CLOCK_MONOTONIC, &conn->creation_time);
 			bsc_mgcp_dlcx(conn);
 			return conn;
@@ -116,6 +188,7 @@ struct sccp_connections *create_sccp_src_ref(struct bsc_connection *bsc,
 		LOGP(DNAT, LOGL_ERROR, "Memory allocation failure.\n");
 		return NULL;
 	}
+	osmo_counter_inc(bsc->nat->stats.msg.allocs);
 
 	conn->bsc = bsc;
 	clock_gettime(CLOCK_MONOTONIC, &conn->creation_time);
@@ -128,6 +201,7 @@ struct sccp_connections *create_sccp_src_ref(struct bsc_connection *bsc,
 
 	bsc_mgcp_init(conn);
 	llist_add_tail(&conn->list_entry, &bsc->nat->sccp_connections);
+	hash_connection(conn, bsc->nat);
 	rate_ctr_inc(&bsc->cfg->stats.ctrg->ctr[BCFG_CTR_SCCP_CONN]);
 	osmo_counter_inc(bsc->cfg->nat->stats.sccp.conn);
 
@@ -145,7 +219,7 @@ int update_sccp_src_ref(struct sccp_connections *sccp, struct bsc_nat_parsed *pa
 		return -1;
 	}
 
-	sccp->remote_ref = *parsed->src_local_ref;
+	sccp_connection_set_remote_ref(sccp, parsed->src_local_ref);
 	sccp->has_remote_ref = 1;
 	LOGP(DNAT, LOGL_DEBUG, "Updating 0x%x to remote 0x%x on %p\n",
 	     sccp_src_ref_to_int(&sccp->patched_ref),
@@ -157,8 +231,9 @@ int update_sccp_src_ref(struct sccp_connections *sccp, struct bsc_nat_parsed *pa
 void remove_sccp_src_ref(struct bsc_connection *bsc, struct msgb *msg, struct bsc_nat_parsed *parsed)
 {
 	struct sccp_connections *conn;
+	unsigned int hash = ref_hash(parsed->src_local_ref);
 
-	llist_for_each_entry(conn, &bsc->nat->sccp_connections, list_entry) {
+	llist_for_each_entry(conn, &bsc->nat->sccp_by_patched[hash], patched_hentry) {
 		if (memcmp(parsed->src_local_ref,
 			   &conn->patched_ref, sizeof(conn->patched_ref)) == 0) {
 
@@ -187,8 +262,8 @@ struct sccp_connections *patch_sccp_src_ref_to_bsc(struct msgb *msg,
 		return NULL;
 	}
 
-
-	llist_for_each_entry(conn, &nat->sccp_connections, list_entry) {
+	llist_for_each_entry(conn, &nat->sccp_by_patched[ref_hash(parsed->dest_local_ref)],
+			     patched_hentry) {
 		if (!equal(parsed->dest_local_ref, &conn->patched_ref))
 			continue;
 
@@ -213,23 +288,29 @@ struct sccp_connections *patch_sccp_src_ref_to_msc(struct msgb *msg,
 						   struct bsc_connection *bsc)
 {
 	struct sccp_connections *conn;
+	struct bsc_nat *nat = bsc->nat;
 
-	llist_for_each_entry(conn, &bsc->nat->sccp_connections, list_entry) {
-		if (conn->bsc != bsc)
-			continue;
-
-		if (parsed->src_local_ref) {
+	if (parsed->src_local_ref) {
+		llist_for_each_entry(conn, &nat->sccp_by_real[ref_hash(parsed->src_local_ref)],
+				     real_hentry) {
+			if (conn->bsc != bsc)
+				continue;
 			if (equal(parsed->src_local_ref, &conn->real_ref)) {
 				*parsed->src_local_ref = conn->patched_ref;
 				return conn;
 			}
-		} else if (parsed->dest_local_ref) {
+		}
+	} else if (parsed->dest_local_ref) {
+		llist_for_each_entry(conn, &nat->sccp_by_remote[ref_hash(parsed->dest_local_ref)],
+				     remote_hentry) {
+			if (conn->bsc != bsc || !conn->has_remote_ref)
+				continue;
 			if (equal(parsed->dest_local_ref, &conn->remote_ref))
 				return conn;
-		} else {
-			LOGP(DNAT, LOGL_ERROR, "Header has neither loc/dst ref.\n");
-			return NULL;
 		}
+	} else {
+		LOGP(DNAT, LOGL_ERROR, "Header has neither loc/dst ref.\n");
+		return NULL;
 	}
 
 	return NULL;
@@ -240,7 +321,7 @@ struct sccp_connections *bsc_nat_find_con_by_bsc(struct bsc_nat *nat,
 {
 	struct sccp_connections *conn;
 
-	llist_for_each_entry(conn, &nat->sccp_connections, list_entry) {
+	llist_for_each_entry(conn, &nat->sccp_by_real[ref_hash(ref)], real_hentry) {
 		if (memcmp(ref, &conn->real_ref, sizeof(*ref)) == 0)
 			return conn;
 	}
@@ -69,11 +69,10 @@ static void bsc_nat_ussd_destroy(struct bsc_nat_ussd_con *con)
 static int forward_sccp(struct bsc_nat *nat, struct msgb *msg)
 {
 	struct sccp_connections *con;
-	struct bsc_nat_parsed *parsed;
+	struct bsc_nat_parsed parsed_msg, *parsed = &parsed_msg;
 
 
-	parsed = bsc_nat_parse(msg);
-	if (!parsed) {
+	if (bsc_nat_parse_into(msg, parsed) != 0) {
 		LOGP(DNAT, LOGL_ERROR, "Can not parse msg from USSD.\n");
 		msgb_free(msg);
 		return -1;
@@ -92,7 +91,6 @@ static int forward_sccp(struct bsc_nat *nat, struct msgb *msg)
 		return -1;
 	}
 
-	talloc_free(parsed);
 	bsc_write_msg(&con->bsc->write_queue, msg);
 	return 0;
 }
@@ -268,6 +266,7 @@ static int forward_ussd_simple(struct sccp_connections *con, struct msgb *input)
 		LOGP(DNAT, LOGL_ERROR, "Allocation failed, not forwarding.\n");
 		return -1;
 	}
+	osmo_counter_inc(con->bsc->nat->stats.msg.allocs);
 
 	/* copy the data into the copy */
 	copy->l2h = msgb_put(copy, msgb_l2len(input));
@@ -294,6 +293,7 @@ static int forward_ussd(struct sccp_connections *con, const struct ussd_request
 		LOGP(DNAT, LOGL_ERROR, "Allocation failed, not forwarding.\n");
 		return -1;
 	}
+	osmo_counter_inc(con->bsc->nat->stats.msg.allocs);
 
 	copy = msgb_alloc_headroom(4096, 128, "forward bts");
 	if (!copy) {
@@ -301,6 +301,7 @@ static int forward_ussd(struct sccp_connections *con, const struct ussd_request
 		msgb_free(msg);
 		return -1;
 	}
+	osmo_counter_inc(con->bsc->nat->stats.msg.allocs);
 
 	copy->l2h = msgb_put(copy, msgb_l2len(input));
 	memcpy(copy->l2h, input->l2h, msgb_l2len(input));
@@ -36,6 +36,7 @@
 #include <osmocom/abis/abis.h>
 #include <osmocom/abis/e1_input.h>
 #include <osmocom/core/talloc.h>
+#include <osmocom/core/rate_ctr.h>
 #include <openbsc/signal.h>
 #include <openbsc/osmo_msc.h>
 #include <openbsc/sms_queue.h>
@@ -46,6 +47,8 @@
 #include <openbsc/handover_decision.h>
 #include <openbsc/rrlp.h>
 #include <openbsc/control_if.h>
+#include <openbsc/pdu_trace.h>
+#include <openbsc/auth.h>
 
 #include "../../bscconfig.h"
 
@@ -61,6 +64,11 @@ static int use_mncc_sock = 0;
 #define DB_SYNC_INTERVAL	60, 0
 static struct osmo_timer_list db_sync_timer;
 
+/* snapshots older than this are removed once a day */
+#define DB_COUNTER_KEEP_DAYS	30
+#define DB_PRUNE_SYNCS		(24 * 60)
+static unsigned int db_syncs;
+
 static void create_pcap_file(char *file)
 {
 	mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
@@ -197,15 +205,14 @@ static void signal_handler(int signal)
 }
 
 /* timer handling */
-static int _db_store_counter(struct osmo_counter *counter, void *data)
-{
-	return db_store_counter(counter);
-}
-
 static void db_sync_timer_cb(void *data)
 {
 	/* store counters to database and re-schedule */
-	osmo_counters_for_each(_db_store_counter, NULL);
+	db_store_counters();
+	if (++db_syncs == DB_PRUNE_SYNCS) {
+		db_syncs = 0;
+		db_prune_counters(DB_COUNTER_KEEP_DAYS);
+	}
 	osmo_timer_schedule(&db_sync_timer, DB_SYNC_INTERVAL);
 }
 
@@ -234,11 +241,14 @@ int main(int argc, char **argv)
 
 	libosmo_abis_init(tall_bsc_ctx);
 	osmo_init_logging(&log_info);
+	rate_ctr_init(tall_bsc_ctx);
 	bts_init();
 
 	/* This needs to precede handle_options() */
 	vty_init(&vty_info);
 	bsc_vty_init(&log_info);
+	pdu_trace_vty_init();
+	pdu_trace_init(tall_bsc_ctx, PDU_TRACE_DEF_ENTRIES, PDU_TRACE_DEF_SNAPLEN);
 
 	/* parse options */
 	handle_options(argc, argv);
@@ -270,6 +280,9 @@ int main(int argc, char **argv)
 	}
 	printf("DB: Database prepared.\n");
 
+	auth_pool_init(tall_bsc_ctx, AUTH_POOL_DEF_SUBSCRIBERS,
+		       AUTH_POOL_DEF_TUPLES);
+
 	/* setup the timer */
 	db_sync_timer.cb = db_sync_timer_cb;
 	db_sync_timer.data = NULL;
@@ -251,6 +251,7 @@ static void test_filter(void)
 				result, results[i].result);
 		}
 
+		talloc_free(parsed);
 		msgb_free(msg);
 	}
 }
@@ -332,24 +333,28 @@ static void test_contrack()
 		fprintf(stderr, "Failed to update the SCCP con.\n");
 		abort();
 	}
+	talloc_free(parsed);
 
 	/* 3.) send some data */
 	copy_to_msg(msg, bsc_dtap, sizeof(bsc_dtap));
 	parsed = bsc_nat_parse(msg);
 	con_found = patch_sccp_src_ref_to_msc(msg, parsed, con);
 	VERIFY(con_found, con, msg, bsc_dtap_patched, "BSC DTAP");
+	talloc_free(parsed);
 
 	/* 4.) receive some data */
 	copy_to_msg(msg, msc_dtap, sizeof(msc_dtap));
 	parsed = bsc_nat_parse(msg);
 	con_found = patch_sccp_src_ref_to_bsc(msg, parsed, nat);
 	VERIFY(con_found, con, msg, msc_dtap_patched, "MSC DTAP");
+	talloc_free(parsed);
 
 	/* 5.) close the connection */
 	copy_to_msg(msg, msc_rlsd, sizeof(msc_rlsd));
 	parsed = bsc_nat_parse(msg);
 	con_found = patch_sccp_src_ref_to_bsc(msg, parsed, nat);
 	VERIFY(con_found, con, msg, msc_rlsd_patched, "MSC RLSD");
+	talloc_free(parsed);
 
 	/* 6.) confirm the connection close */
 	copy_to_msg(msg, bsc_rlc, sizeof(bsc_rlc));
@@ -820,6 +825,7 @@ static void test_dt_filter()
 		fprintf(stderr, "FAIL: Should have passed..\n");
 		abort();
 	}
+	talloc_free(parsed);
 
 	/* just some basic length checking... */
 	for (i = ARRAY_SIZE(id_resp); i >= 0; --i) {
@@ -832,6 +838,7 @@ static void test_dt_filter()
 
 		con->imsi_checked = 0;
 		bsc_nat_filter_dt(bsc, msg, con, parsed);
+		talloc_free(parsed);
 	}
 }
 
@@ -914,6 +921,7 @@ static void test_setup_rewrite()
 	}
 
 	msgb_free(out);
+	talloc_free(parsed);
 
 	/* Make sure that a wildcard is matching */
 	entry.mnc = "*";
@@ -949,6 +957,7 @@ static void test_setup_rewrite()
 	}
 
 	msgb_free(out);
+	talloc_free(parsed);
 
 	/* Make sure that a wildcard is matching */
 	entry.mnc = "09";
@@ -978,6 +987,7 @@ static void test_setup_rewrite()
 	}
 
 	msgb_free(out);
+	talloc_free(parsed);
 }
 
 static void test_smsc_rewrite()
@@ -1029,6 +1039,9 @@ static void test_smsc_rewrite()
 		fprintf(stderr, "FAIL: the data should be changed.\n");
 		abort();
 	}
+
+	msgb_free(out);
+	talloc_free(parsed);
 }
 
 int main(int argc, char **argv)
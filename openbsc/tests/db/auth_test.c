@@ -0,0 +1,198 @@
+/* Location Updating latency with and without the auth tuple pool */
+
+/* (C) 2012 by the OpenBSC project
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <openbsc/db.h>
+#include <openbsc/auth.h>
+#include <openbsc/gsm_data.h>
+#include <openbsc/gsm_subscriber.h>
+
+#include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/gsm/comp128.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#define NUM_SUBSCR	500
+#define NUM_ROUNDS	4
+
+#define COMPARE(result, op, value) \
+    if (!((result) op (value))) {\
+	fprintf(stderr, "Compare failed. Was %x should be %x in %s:%d\n",result, value, __FILE__, __LINE__); \
+	exit(-1); \
+    }
+
+static struct gsm_subscriber *subscr[NUM_SUBSCR];
+static struct gsm_auth_info ainfo[NUM_SUBSCR];
+
+static void create_subscribers(void)
+{
+	char imsi[GSM_IMSI_LENGTH];
+	int i, j;
+
+	for (i = 0; i < NUM_SUBSCR; ++i) {
+		snprintf(imsi, sizeof(imsi), "90170%010d", i);
+		subscr[i] = db_create_subscriber(NULL, imsi);
+		COMPARE(subscr[i] != NULL, ==, 1);
+
+		/* a few subscribers use XOR, all others COMP128v1 */
+		ainfo[i].auth_algo = i % 10 ?
+				AUTH_ALGO_COMP128v1 : AUTH_ALGO_XOR;
+		ainfo[i].a3a8_ki_len = 16;
+		for (j = 0; j < 16; ++j)
+			ainfo[i].a3a8_ki[j] = random() & 0xff;
+		COMPARE(db_sync_authinfo_for_subscr(&ainfo[i], subscr[i]), ==, 0);
+		db_sync_lastauthtuple_for_subscr(NULL, subscr[i]);
+	}
+}
+
+static void check_tuple(int i, struct gsm_auth_tuple *atuple)
+{
+	uint8_t sres[4], kc[8];
+	int j;
+
+	if (ainfo[i].auth_algo == AUTH_ALGO_COMP128v1) {
+		comp128(ainfo[i].a3a8_ki, atuple->rand, sres, kc);
+	} else {
+		for (j = 0; j < 4; ++j)
+			sres[j] = atuple->rand[j] ^ ainfo[i].a3a8_ki[j];
+		for (j = 4; j < 12; ++j)
+			kc[j - 4] = atuple->rand[j] ^ ainfo[i].a3a8_ki[j];
+	}
+
+	COMPARE(memcmp(sres, atuple->sres, sizeof(sres)), ==, 0);
+	COMPARE(memcmp(kc, atuple->kc, sizeof(kc)), ==, 0);
+}
+
+/* let the refill timer run until the pool is topped up */
+static void run_refill(void)
+{
+	while (osmo_timers_check())
+		osmo_select_main(0);
+}
+
+/* one round of LUs of all subscribers, each needing a fresh tuple */
+static double lu_round(int pooled)
+{
+	struct gsm_auth_tuple atuple;
+	struct timeval start, end;
+	double usec = 0;
+	int i, rc;
+
+	for (i = 0; i < NUM_SUBSCR; ++i) {
+		gettimeofday(&start, NULL);
+		rc = auth_get_tuple_for_subscr(&atuple, subscr[i],
+					       GSM_KEY_SEQ_INVAL);
+		gettimeofday(&end, NULL);
+		COMPARE(rc, ==, AUTH_DO_AUTH_THAN_CIPH);
+		check_tuple(i, &atuple);
+
+		usec += (end.tv_sec - start.tv_sec) * 1e6
+				+ (end.tv_usec - start.tv_usec);
+	}
+
+	/* the refill is not part of the LU latency */
+	if (pooled)
+		run_refill();
+
+	return usec / NUM_SUBSCR;
+}
+
+static void bench(const char *name, int pooled)
+{
+	struct auth_pool_stats stats;
+	double usec = 0;
+	int i;
+
+	/* the first round only fills the pool */
+	lu_round(pooled);
+	for (i = 0; i < NUM_ROUNDS; ++i)
+		usec += lu_round(pooled);
+
+	auth_pool_get_stats(&stats);
+	printf("%s: %.1f usec per LU, %llu hits, %llu misses\n",
+		name, usec / NUM_ROUNDS, stats.hits, stats.misses);
+
+	if (pooled) {
+		COMPARE((int) stats.hits, ==, NUM_SUBSCR * NUM_ROUNDS);
+		COMPARE((int) stats.misses, ==, NUM_SUBSCR);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct auth_pool_stats stats;
+	struct gsm_auth_tuple atuple;
+	int i;
+
+	unlink("auth_test.sqlite3");
+	if (db_init("auth_test.sqlite3")) {
+		printf("DB: Failed to init database.\n");
+		return 1;
+	}
+	if (db_prepare()) {
+		printf("DB: Failed to prepare database.\n");
+		return 1;
+	}
+
+	create_subscribers();
+
+	auth_pool_init(NULL, 0, 0);
+	bench("pool disabled", 0);
+
+	auth_pool_init(NULL, NUM_SUBSCR, AUTH_POOL_DEF_TUPLES);
+	bench("pool enabled", 1);
+
+	/* a key changed in the HLR must not hand out the old tuples, even
+	 * without flushing the pool */
+	ainfo[0].auth_algo = AUTH_ALGO_COMP128v1;
+	ainfo[0].a3a8_ki[0] ^= 0xff;
+	db_sync_authinfo_for_subscr(&ainfo[0], subscr[0]);
+	for (i = 0; i < 2 * AUTH_POOL_DEF_TUPLES; ++i) {
+		COMPARE(auth_get_tuple_for_subscr(&atuple, subscr[0],
+						  GSM_KEY_SEQ_INVAL),
+			==, AUTH_DO_AUTH_THAN_CIPH);
+		check_tuple(0, &atuple);
+		run_refill();
+	}
+	auth_pool_get_stats(&stats);
+	COMPARE((int) stats.stale, ==, AUTH_POOL_DEF_TUPLES);
+
+	/* and no tuples at all once authentication is switched off */
+	ainfo[0].auth_algo = AUTH_ALGO_NONE;
+	db_sync_authinfo_for_subscr(&ainfo[0], subscr[0]);
+	COMPARE(auth_get_tuple_for_subscr(&atuple, subscr[0],
+					  GSM_KEY_SEQ_INVAL), ==, 0);
+
+	for (i = 0; i < NUM_SUBSCR; ++i)
+		subscr_put(subscr[i]);
+
+	db_fini();
+	unlink("auth_test.sqlite3");
+
+	printf("Done.\n");
+	return 0;
+}
+
+/* stubs */
+void vty_out() {}
@@ -0,0 +1,195 @@
+/* Deliver stored SMS through the SMS queue */
+
+/* (C) 2012 by the OpenBSC project
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <openbsc/db.h>
+#include <openbsc/debug.h>
+#include <openbsc/gsm_data.h>
+#include <openbsc/gsm_subscriber.h>
+#include <openbsc/gsm_04_11.h>
+#include <openbsc/signal.h>
+#include <openbsc/sms_queue.h>
+
+#include <osmocom/core/application.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/signal.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#define NUM_SUBSCR	200
+#define NUM_SMS		2000
+#define NUM_LATE	10
+#define MAX_PENDING	20
+
+#define COMPARE(result, op, value) \
+    if (!((result) op (value))) {\
+	fprintf(stderr, "Compare failed. Was %x should be %x in %s:%d\n",result, value, __FILE__, __LINE__); \
+	exit(-1); \
+    }
+
+static struct gsm_network *net;
+static struct gsm_subscriber *subscr[NUM_SUBSCR];
+static unsigned long long last_id[NUM_SUBSCR];
+
+/* the SMS handed to the MSC and not delivered yet, oldest first */
+static struct gsm_sms *in_flight[MAX_PENDING];
+static unsigned int in_flight_head, in_flight_len;
+static unsigned int delivered;
+
+/*
+ * The queue hands the SMS over to gsm411_send_sms_subscr() which would
+ * page the subscriber. The test is linked with --wrap for it and just
+ * keeps the SMS until it is delivered below.
+ */
+int __wrap_gsm411_send_sms_subscr(struct gsm_subscriber *subscr,
+				  struct gsm_sms *sms)
+{
+	COMPARE(in_flight_len < MAX_PENDING, ==, 1);
+	in_flight[(in_flight_head + in_flight_len) % MAX_PENDING] = sms;
+	in_flight_len += 1;
+	return 0;
+}
+
+/* what gsm_04_11.c does once the MS acknowledged the SMS */
+static void deliver_one(void)
+{
+	struct sms_signal_data sig;
+	struct gsm_sms *sms = in_flight[in_flight_head];
+	unsigned int i = sms->receiver->id - subscr[0]->id;
+
+	in_flight_head = (in_flight_head + 1) % MAX_PENDING;
+	in_flight_len -= 1;
+
+	/* the SMS of a receiver go out oldest first */
+	COMPARE(i < NUM_SUBSCR, ==, 1);
+	COMPARE(sms->id > last_id[i], ==, 1);
+	last_id[i] = sms->id;
+
+	db_sms_mark_sent(sms);
+	memset(&sig, 0, sizeof(sig));
+	sig.sms = sms;
+	osmo_signal_dispatch(SS_SMS, S_SMS_DELIVERED, &sig);
+	sms_free(sms);
+	delivered += 1;
+}
+
+/* deliver until the queue has nothing left, kicking it when it stalls */
+static void deliver_all(unsigned int num)
+{
+	int stalls = 0;
+
+	while (delivered < num) {
+		if (in_flight_len) {
+			deliver_one();
+			continue;
+		}
+
+		COMPARE(stalls++ < 10, ==, 1);
+		sms_queue_trigger(net->sms_queue);
+		while (!in_flight_len && osmo_timers_check())
+			osmo_select_main(0);
+	}
+}
+
+static void store_sms(unsigned int num)
+{
+	struct gsm_sms *sms;
+	unsigned int i;
+
+	for (i = 0; i < num; ++i) {
+		sms = sms_from_text(subscr[i % NUM_SUBSCR], 0, "queue test");
+		COMPARE(sms != NULL, ==, 1);
+		COMPARE(db_sms_store(sms), ==, 0);
+		sms_free(sms);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	char imsi[GSM_IMSI_LENGTH];
+	struct timeval start, end;
+	unsigned int num_sms = NUM_SMS;
+	struct gsm_sms *sms;
+	double usec;
+	int i;
+
+	/* e.g. 100000 for the delivery round benchmark */
+	if (argc > 1)
+		num_sms = atoi(argv[1]);
+
+	osmo_init_logging(&log_info);
+
+	net = gsm_network_init(1, 1, NULL);
+	COMPARE(net != NULL, ==, 1);
+
+	unlink("sms_queue_test.sqlite3");
+	if (db_init("sms_queue_test.sqlite3")) {
+		printf("DB: Failed to init database.\n");
+		return 1;
+	}
+	if (db_prepare()) {
+		printf("DB: Failed to prepare database.\n");
+		return 1;
+	}
+
+	for (i = 0; i < NUM_SUBSCR; ++i) {
+		snprintf(imsi, sizeof(imsi), "90170%010d", i);
+		subscr[i] = db_create_subscriber(net, imsi);
+		COMPARE(subscr[i] != NULL, ==, 1);
+		subscr[i]->lac = 1;
+		COMPARE(db_sync_subscriber(subscr[i]), ==, 0);
+	}
+	store_sms(num_sms);
+
+	/* the queue loads the stored SMS at start */
+	gettimeofday(&start, NULL);
+	COMPARE(sms_queue_start(net, MAX_PENDING), ==, 0);
+	deliver_all(num_sms);
+	db_sms_flush();
+	gettimeofday(&end, NULL);
+
+	usec = (end.tv_sec - start.tv_sec) * 1e6
+			+ (end.tv_usec - start.tv_usec);
+	printf("Delivered %u SMS, %.1f usec per SMS\n",
+	       delivered, usec / delivered);
+
+	/* all of them are marked as sent */
+	sms = db_sms_get_unsent(net, 0);
+	COMPARE(sms == NULL, ==, 1);
+
+	/* SMS stored behind the back of the queue are found by a kick */
+	store_sms(NUM_LATE);
+	deliver_all(num_sms + NUM_LATE);
+	db_sms_flush();
+	sms = db_sms_get_unsent(net, 0);
+	COMPARE(sms == NULL, ==, 1);
+
+	for (i = 0; i < NUM_SUBSCR; ++i)
+		subscr_put(subscr[i]);
+
+	db_fini();
+	unlink("sms_queue_test.sqlite3");
+
+	printf("Done.\n");
+	return 0;
+}
@@ -0,0 +1,165 @@
+/* Benchmark the BSSGP flow control with many MS buckets */
+/*
+ * (C) 2012 by the OpenBSC project
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/logging.h>
+
+#include <openbsc/debug.h>
+#include <openbsc/gprs_bssgp.h>
+#include <openbsc/gprs_llc.h>
+#include <openbsc/gprs_gmm.h>
+
+#define NUM_MS		10000
+#define NUM_PDUS	20
+#define PDU_LEN		500
+#define BUCKET_SIZE	1000
+#define LEAK_RATE	100000
+
+struct ms {
+	struct bssgp_flow_control fc;
+	unsigned int sent;
+	struct timespec first, last;
+};
+
+static struct ms ms[NUM_MS];
+static unsigned int total_sent;
+
+/* the parts of the SGSN that libgb calls into */
+int gprs_llc_rcvmsg(struct msgb *msg, struct tlv_parsed *tv)
+{
+	return 0;
+}
+
+int gprs_gmm_rx_suspend(struct gprs_ra_id *raid, uint32_t tlli)
+{
+	return 0;
+}
+
+int gprs_gmm_rx_resume(struct gprs_ra_id *raid, uint32_t tlli,
+		       uint8_t suspend_ref)
+{
+	return 0;
+}
+
+static double ts_diff(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+static int out_cb(struct bssgp_flow_control *fc, struct msgb *msg,
+		  uint32_t llc_pdu_len, void *priv)
+{
+	struct ms *m = (struct ms *) msg->cb[0];
+
+	if (!m->sent)
+		clock_gettime(CLOCK_MONOTONIC, &m->first);
+	clock_gettime(CLOCK_MONOTONIC, &m->last);
+	m->sent += 1;
+	total_sent += 1;
+	msgb_free(msg);
+	return 0;
+}
+
+static void send_pdus(int num)
+{
+	struct msgb *msg;
+	int i, j;
+
+	for (j = 0; j < num; j++) {
+		for (i = 0; i < NUM_MS; i++) {
+			msg = msgb_alloc(PDU_LEN, "test");
+			msg->cb[0] = (unsigned long) &ms[i];
+			if (bssgp_fc_in(&ms[i].fc, msg, PDU_LEN, NULL) < 0) {
+				fprintf(stderr, "PDU rejected\n");
+				exit(1);
+			}
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct timespec start, end;
+	clock_t cpu;
+	double min_secs;
+	int i;
+
+	osmo_init_logging(&log_info);
+
+	/* buckets that never fill up, just the per PDU cost */
+	for (i = 0; i < NUM_MS; i++)
+		bssgp_fc_init(&ms[i].fc, UINT32_MAX, UINT32_MAX,
+			      BSSGP_FC_MS_QUEUE_DEPTH, out_cb);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	send_pdus(100);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (total_sent != NUM_MS * 100) {
+		fprintf(stderr, "Only %u PDUs passed\n", total_sent);
+		return 1;
+	}
+	printf("Passed %u PDUs in %.3f seconds\n", total_sent,
+		ts_diff(&start, &end));
+
+	/* now every MS sends a burst that has to be queued */
+	total_sent = 0;
+	for (i = 0; i < NUM_MS; i++) {
+		bssgp_fc_init(&ms[i].fc, BUCKET_SIZE, LEAK_RATE,
+			      BSSGP_FC_MS_QUEUE_DEPTH, out_cb);
+		ms[i].sent = 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	cpu = clock();
+	send_pdus(NUM_PDUS);
+	while (total_sent < NUM_MS * NUM_PDUS)
+		osmo_select_main(0);
+	cpu = clock() - cpu;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("Drained %u queued PDUs of %u MS in %.3f seconds, "
+		"%.3f seconds CPU\n", total_sent, NUM_MS,
+		ts_diff(&start, &end), (double) cpu / CLOCKS_PER_SEC);
+
+	/* no MS may have sent faster than its leak rate, minus a tick */
+	min_secs = (double) (NUM_PDUS * PDU_LEN - BUCKET_SIZE - PDU_LEN)
+			/ LEAK_RATE - 0.01;
+	for (i = 0; i < NUM_MS; i++) {
+		if (ms[i].sent != NUM_PDUS
+		    || ts_diff(&ms[i].first, &ms[i].last) < min_secs) {
+			fprintf(stderr, "MS %d sent %u PDUs in %.3f seconds\n",
+				i, ms[i].sent, ts_diff(&ms[i].first, &ms[i].last));
+			return 1;
+		}
+	}
+
+	for (i = 0; i < NUM_MS; i++)
+		bssgp_fc_flush(&ms[i].fc);
+
+	printf("Done\n");
+	return 0;
+}
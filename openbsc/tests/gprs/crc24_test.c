@@ -0,0 +1,119 @@
+/* test the slicing-by-8 CRC24 against the byte-wise reference */
+/*
+ * (C) 2012 by the OpenBSC project
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <openbsc/crc24.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* N201-U maximum plus LLC header and FCS */
+#define MAX_FRAME	1520
+#define NUM_FRAMES	10000
+
+static uint8_t frame[MAX_FRAME + 8];
+
+static void test_known_frame(void)
+{
+	/* LLC UI frame header followed by some payload */
+	static uint8_t ui[] = {
+		0x01, 0xc0, 0x01, 0x08, 0x01, 0x02, 0xf5, 0xe0,
+		0x21, 0x08, 0x02, 0x05, 0xf4, 0xfb, 0xc5, 0x46,
+		0x79, 0xff, 0xff, 0xff, 0xff, 0x17, 0x30, 0x14,
+	};
+	uint32_t ref, fast;
+
+	ref = crc24_calc_bytewise(INIT_CRC24, ui, sizeof(ui));
+	fast = crc24_calc(INIT_CRC24, ui, sizeof(ui));
+	printf("Known frame: ref 0x%06x fast 0x%06x\n", ref, fast);
+	if (ref != fast)
+		abort();
+}
+
+static void test_random_frames(void)
+{
+	int i;
+
+	for (i = 0; i < NUM_FRAMES; i++) {
+		unsigned int len = rand() % MAX_FRAME;
+		/* vary the alignment of the buffer as well */
+		unsigned int off = rand() % 8;
+		uint32_t ref, fast;
+		int j;
+
+		for (j = 0; j < len; j++)
+			frame[off + j] = rand();
+
+		ref = crc24_calc_bytewise(INIT_CRC24, frame + off, len);
+		fast = crc24_calc(INIT_CRC24, frame + off, len);
+		if (ref != fast) {
+			printf("Mismatch len %u off %u: ref 0x%06x fast 0x%06x\n",
+				len, off, ref, fast);
+			abort();
+		}
+	}
+	printf("Random frames: %d frames match\n", NUM_FRAMES);
+}
+
+static double bench(uint32_t (*fn)(uint32_t, uint8_t *, unsigned int),
+		    unsigned int len, int rounds)
+{
+	struct timespec start, end;
+	volatile uint32_t fcs = 0;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < rounds; i++)
+		fcs ^= fn(INIT_CRC24, frame, len);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+static void bench_frames(void)
+{
+	static const unsigned int lens[] = { 24, 160, 520, 1520 };
+	int i;
+
+	for (i = 0; i < sizeof(lens)/sizeof(lens[0]); i++) {
+		int rounds = 20000000 / lens[i];
+		double ref = bench(crc24_calc_bytewise, lens[i], rounds);
+		double fast = bench(crc24_calc, lens[i], rounds);
+
+		printf("len %4u: bytewise %.0f MB/s, sliced %.0f MB/s\n", lens[i],
+			(double) lens[i] * rounds / ref * 1e3,
+			(double) lens[i] * rounds / fast * 1e3);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	srand(0x2342);
+
+	test_known_frame();
+	test_random_frames();
+
+	/* throughput numbers are only printed on request */
+	if (argc > 1 && !strcmp(argv[1], "-b"))
+		bench_frames();
+
+	return 0;
+}
@@ -0,0 +1,164 @@
+/* Run UL-UNITDATA through the NS and BSSGP receive path */
+/*
+ * (C) 2012 by the OpenBSC project
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+
+#include <openbsc/debug.h>
+#include <openbsc/gsm_data.h>
+#include <openbsc/gprs_ns.h>
+#include <openbsc/gprs_bssgp.h>
+
+#define NUM_PDUS	100
+#define TEST_TLLI	0xc0000001
+
+#define COMPARE(result, op, value) \
+    if (!((result) op (value))) {\
+	fprintf(stderr, "Compare failed. Was %x should be %x in %s:%d\n",result, value, __FILE__, __LINE__); \
+	exit(-1); \
+    }
+
+extern void *tall_msgb_ctx;
+
+static int bss_fd;
+static struct sockaddr_in sgsn_addr;
+static unsigned int llc_pdus;
+
+/* NS-RESET of NSVCI 1 / NSEI 2 */
+static const uint8_t ns_reset[] = {
+	NS_PDUT_RESET,
+	NS_IE_CAUSE, 0x81, 0x00,
+	NS_IE_VCI, 0x82, 0x00, 0x01,
+	NS_IE_NSEI, 0x82, 0x00, 0x02,
+};
+
+static const uint8_t ns_unblock[] = {
+	NS_PDUT_UNBLOCK,
+};
+
+/* NS-UNITDATA on the signalling BVC with a BVC-RESET of BVCI 3 */
+static const uint8_t bvc_reset[] = {
+	NS_PDUT_UNITDATA, 0x00, 0x00, 0x00,
+	BSSGP_PDUT_BVC_RESET,
+	BSSGP_IE_BVCI, 0x82, 0x00, 0x03,
+	BSSGP_IE_CAUSE, 0x81, 0x08,
+	BSSGP_IE_CELL_ID, 0x88, 0x62, 0xf2, 0x10, 0x00, 0x01, 0x01, 0x00, 0x01,
+};
+
+/* NS-UNITDATA on BVCI 3 with an UL-UNITDATA */
+static const uint8_t ul_unitdata[] = {
+	NS_PDUT_UNITDATA, 0x00, 0x00, 0x03,
+	BSSGP_PDUT_UL_UNITDATA, 0xc0, 0x00, 0x00, 0x01, 0x00, 0x00, 0x20,
+	BSSGP_IE_CELL_ID, 0x88, 0x62, 0xf2, 0x10, 0x00, 0x01, 0x01, 0x00, 0x01,
+	BSSGP_IE_LLC_PDU, 0x84, 0x01, 0xc0, 0x01, 0x00,
+};
+
+/* the parts of the SGSN that libgb calls into */
+int gprs_llc_rcvmsg(struct msgb *msg, struct tlv_parsed *tv)
+{
+	COMPARE(msgb_tlli(msg), ==, TEST_TLLI);
+	llc_pdus += 1;
+	return 0;
+}
+
+int gprs_gmm_rx_suspend(struct gprs_ra_id *raid, uint32_t tlli)
+{
+	return 0;
+}
+
+int gprs_gmm_rx_resume(struct gprs_ra_id *raid, uint32_t tlli,
+		       uint8_t suspend_ref)
+{
+	return 0;
+}
+
+static int ns_cb(enum gprs_ns_evt event, struct gprs_nsvc *nsvc,
+		 struct msgb *msg, uint16_t bvci)
+{
+	COMPARE(event, ==, GPRS_NS_EVT_UNIT_DATA);
+	return gprs_bssgp_rcvmsg(msg);
+}
+
+/* send a PDU from the BSS and let the SGSN side handle it */
+static void bss_send(const uint8_t *pdu, size_t len)
+{
+	char buf[NS_ALLOC_SIZE];
+
+	COMPARE((int) sendto(bss_fd, pdu, len, 0,
+			     (struct sockaddr *) &sgsn_addr,
+			     sizeof(sgsn_addr)), ==, (int) len);
+	/* handle it and flush the answers of the SGSN */
+	while (osmo_select_main(1) > 0)
+		;
+
+	/* drop whatever the SGSN answered */
+	while (recv(bss_fd, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+		;
+}
+
+int main(int argc, char **argv)
+{
+	struct gprs_ns_inst *nsi;
+	socklen_t len = sizeof(sgsn_addr);
+	size_t blocks;
+	int i;
+
+	osmo_init_logging(&log_info);
+	tall_msgb_ctx = talloc_named_const(NULL, 0, "msgb");
+
+	nsi = gprs_ns_instantiate(ns_cb);
+	bssgp_nsi = nsi;
+	nsi->nsip.local_ip = INADDR_LOOPBACK;
+	nsi->nsip.local_port = 0;
+	COMPARE(gprs_ns_nsip_listen(nsi), >=, 0);
+	COMPARE(getsockname(nsi->nsip.fd.fd, (struct sockaddr *) &sgsn_addr,
+			    &len), ==, 0);
+
+	bss_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	COMPARE(bss_fd, >=, 0);
+
+	bss_send(ns_reset, sizeof(ns_reset));
+	bss_send(ns_unblock, sizeof(ns_unblock));
+	bss_send(bvc_reset, sizeof(bvc_reset));
+
+	/* the first UL-UNITDATA sets up the receive buffers */
+	bss_send(ul_unitdata, sizeof(ul_unitdata));
+	blocks = talloc_total_blocks(tall_msgb_ctx);
+
+	for (i = 0; i < NUM_PDUS; ++i)
+		bss_send(ul_unitdata, sizeof(ul_unitdata));
+
+	COMPARE(llc_pdus, ==, NUM_PDUS + 1);
+	COMPARE((int) talloc_total_blocks(tall_msgb_ctx), ==, (int) blocks);
+
+	close(bss_fd);
+	printf("Done\n");
+	return 0;
+}
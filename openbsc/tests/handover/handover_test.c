@@ -0,0 +1,222 @@
+/* Stress test of the handover execution */
+/*
+ * (C) 2012 by the OpenBSC project
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/gsm/gsm_utils.h>
+
+#include <openbsc/gsm_data.h>
+#include <openbsc/chan_alloc.h>
+#include <openbsc/gsm_subscriber.h>
+#include <openbsc/handover.h>
+#include <openbsc/signal.h>
+
+#define NUM_TRX		256
+
+#define COMPARE(result, op, value) \
+    if (!((result) op (value))) {\
+	fprintf(stderr, "Compare failed. Was %x should be %x in %s:%d\n",result, value, __FILE__, __LINE__); \
+	exit(-1); \
+    }
+
+enum ho_result {
+	HO_NACK,
+	HO_COMPLETE,
+	HO_FAIL,
+};
+
+struct sim_ho {
+	struct gsm_subscriber_connection *conn;
+	struct gsm_lchan *old_lchan;
+	struct gsm_lchan *new_lchan;
+	enum ho_result result;
+};
+
+static int rsl_count;
+
+/* the BTS always has a link but we do not send anything */
+int abis_rsl_sendmsg(struct msgb *msg)
+{
+	rsl_count += 1;
+	msgb_free(msg);
+	return 0;
+}
+
+static struct gsm_bts *create_bts(struct gsm_network *net)
+{
+	struct gsm_bts *bts;
+	struct gsm_bts_trx *trx;
+	int i, j;
+
+	bts = gsm_bts_alloc_register(net, GSM_BTS_TYPE_UNKNOWN,
+				     HARDCODED_TSC, HARDCODED_BSIC);
+	if (!bts)
+		exit(1);
+	bts->band = GSM_BAND_900;
+
+	for (i = 1; i < NUM_TRX; i++) {
+		if (!gsm_bts_trx_alloc(bts))
+			exit(1);
+	}
+
+	i = 0;
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		trx->arfcn = 2 * i++ + bts->nr;
+		trx->rsl_link = (void *) 0x2342L;
+		/* TCH/F on every timeslot but the BCCH one */
+		for (j = 1; j < 8; j++)
+			trx->ts[j].pchan = GSM_PCHAN_TCH_F;
+	}
+
+	bts->c0->ts[0].pchan = GSM_PCHAN_CCCH;
+	return bts;
+}
+
+static void send_signal(int signal, struct gsm_lchan *lchan)
+{
+	struct lchan_signal_data sig;
+
+	sig.lchan = lchan;
+	sig.mr = NULL;
+	osmo_signal_dispatch(SS_LCHAN, signal, &sig);
+}
+
+static void shuffle(struct sim_ho **hos, int num)
+{
+	struct sim_ho *tmp;
+	int i, j;
+
+	for (i = num - 1; i > 0; i--) {
+		j = random() % (i + 1);
+		tmp = hos[i];
+		hos[i] = hos[j];
+		hos[j] = tmp;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct gsm_network *network;
+	struct gsm_bts *src, *dst;
+	struct gsm_lchan *lchan;
+	struct bsc_ho_stats *stats;
+	struct sim_ho *sim, **order;
+	int num, i, nack = 0, compl = 0, fail = 0;
+
+	printf("Testing concurrent handovers\n");
+
+	srandom(2342);
+	rate_ctr_init(NULL);
+
+	network = gsm_network_init(1, 1, NULL);
+	if (!network)
+		exit(1);
+	src = create_bts(network);
+	dst = create_bts(network);
+
+	sim = calloc(NUM_TRX * 8, sizeof(*sim));
+	order = calloc(NUM_TRX * 8, sizeof(*order));
+	if (!sim || !order)
+		exit(1);
+
+	/* occupy every TCH/F of the source cell */
+	for (num = 0; (lchan = lchan_alloc(src, GSM_LCHAN_TCH_F, 0)); num++) {
+		lchan->rsl_cmode = RSL_CMOD_SPD_SIGN;
+		lchan->tch_mode = GSM48_CMODE_SIGN;
+		lchan->state = LCHAN_S_ACTIVE;
+		lchan->conn = talloc_zero(NULL, struct gsm_subscriber_connection);
+		lchan->conn->lchan = lchan;
+		lchan->conn->bts = src;
+		lchan->conn->subscr = subscr_alloc();
+
+		sim[num].conn = lchan->conn;
+		sim[num].old_lchan = lchan;
+		sim[num].result = random() % 3;
+		order[num] = &sim[num];
+	}
+	printf("Starting %d handovers\n", num);
+
+	/* all of them at the same time */
+	for (i = 0; i < num; i++) {
+		COMPARE(bsc_handover_start(sim[i].old_lchan, dst), ==, 0);
+		sim[i].new_lchan = sim[i].conn->ho_lchan;
+		COMPARE(sim[i].new_lchan != NULL, ==, 1);
+		COMPARE(sim[i].new_lchan->ts->trx->bts == dst, ==, 1);
+	}
+	COMPARE(bsc_handover_start(sim[0].old_lchan, dst), ==, -EBUSY);
+	COMPARE(bsc_handover_start(sim[0].new_lchan, src), ==, -EBUSY);
+
+	/* the BTS answers the activations in any order */
+	shuffle(order, num);
+	for (i = 0; i < num; i++) {
+		if (order[i]->result == HO_NACK) {
+			send_signal(S_LCHAN_ACTIVATE_NACK, order[i]->new_lchan);
+			COMPARE(order[i]->conn->ho_lchan == NULL, ==, 1);
+			COMPARE(order[i]->new_lchan->ho == NULL, ==, 1);
+			COMPARE(order[i]->old_lchan->ho == NULL, ==, 1);
+		} else
+			send_signal(S_LCHAN_ACTIVATE_ACK, order[i]->new_lchan);
+	}
+
+	/* and the MS report back in any order */
+	shuffle(order, num);
+	for (i = 0; i < num; i++) {
+		switch (order[i]->result) {
+		case HO_NACK:
+			nack++;
+			break;
+		case HO_COMPLETE:
+			send_signal(S_LCHAN_HANDOVER_DETECT, order[i]->new_lchan);
+			send_signal(S_LCHAN_HANDOVER_COMPL, order[i]->new_lchan);
+			COMPARE(order[i]->conn->lchan == order[i]->new_lchan, ==, 1);
+			compl++;
+			break;
+		case HO_FAIL:
+			send_signal(S_LCHAN_HANDOVER_FAIL, order[i]->old_lchan);
+			COMPARE(order[i]->conn->lchan == order[i]->old_lchan, ==, 1);
+			fail++;
+			break;
+		}
+
+		COMPARE(order[i]->conn->ho_lchan == NULL, ==, 1);
+		COMPARE(order[i]->new_lchan->ho == NULL, ==, 1);
+		COMPARE(order[i]->old_lchan->ho == NULL, ==, 1);
+	}
+
+	/* the counters of the cell pair agree */
+	COMPARE(llist_empty(&dst->ho_stats), ==, 1);
+	stats = llist_entry(src->ho_stats.next, struct bsc_ho_stats, list);
+	COMPARE(stats->list.next == &src->ho_stats, ==, 1);
+	COMPARE(stats->target == dst, ==, 1);
+	COMPARE((int) stats->ctrg->ctr[BSC_HO_CTR_ATTEMPTED].current, ==, num);
+	COMPARE((int) stats->ctrg->ctr[BSC_HO_CTR_NO_CHANNEL].current, ==, 0);
+	COMPARE((int) stats->ctrg->ctr[BSC_HO_CTR_COMPLETED].current, ==, compl);
+	COMPARE((int) stats->ctrg->ctr[BSC_HO_CTR_FAILED].current, ==, fail);
+
+	printf("%d completed, %d failed, %d not activated, %d RSL messages\n",
+		compl, fail, nack, rsl_count);
+	printf("Done\n");
+	return 0;
+}
@@ -0,0 +1,176 @@
+/* Test the running sums of the measurement reports */
+/*
+ * (C) 2012 by the OpenBSC project
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openbsc/gsm_data.h>
+#include <openbsc/meas_rep.h>
+
+#define NUM_REPORTS	5000
+
+#define COMPARE(result, op, value) \
+    if (!((result) op (value))) {\
+	fprintf(stderr, "Compare failed. Was %x should be %x in %s:%d\n",result, value, __FILE__, __LINE__); \
+	exit(-1); \
+    }
+
+/* the plain scans the running sums replace */
+static int scan_avg(const struct gsm_lchan *lchan,
+		    enum meas_rep_field field, unsigned int num)
+{
+	unsigned int i, idx;
+	int avg = 0;
+
+	idx = calc_initial_idx(ARRAY_SIZE(lchan->meas_rep),
+				lchan->meas_rep_idx, num);
+	for (i = 0; i < num; i++) {
+		int j = (idx + i) % ARRAY_SIZE(lchan->meas_rep);
+		avg += meas_rep_get_field(&lchan->meas_rep[j], field);
+	}
+
+	return avg / num;
+}
+
+static int scan_n_out_of_m_be(const struct gsm_lchan *lchan,
+			      enum meas_rep_field field,
+			      unsigned int n, unsigned int m, int be)
+{
+	unsigned int i, idx;
+	unsigned int count = 0;
+
+	idx = calc_initial_idx(ARRAY_SIZE(lchan->meas_rep),
+				lchan->meas_rep_idx, m);
+	for (i = 0; i < m; i++) {
+		int j = (idx + i) % ARRAY_SIZE(lchan->meas_rep);
+		if (meas_rep_get_field(&lchan->meas_rep[j], field) >= be)
+			count++;
+	}
+
+	return count >= n;
+}
+
+static int scan_neigh_avg(const struct neigh_meas_proc *nmp, int window)
+{
+	unsigned int i, idx;
+	int avg = 0;
+
+	idx = calc_initial_idx(ARRAY_SIZE(nmp->rxlev),
+				nmp->rxlev_cnt % ARRAY_SIZE(nmp->rxlev),
+				window);
+	for (i = 0; i < window; i++) {
+		int j = (idx + i) % ARRAY_SIZE(nmp->rxlev);
+		avg += nmp->rxlev[j];
+	}
+
+	return avg / window;
+}
+
+static void fill_report(struct gsm_meas_rep *rep)
+{
+	rep->dl.full.rx_lev = random() % 64;
+	rep->dl.sub.rx_lev = random() % 64;
+	rep->dl.full.rx_qual = random() % 8;
+	rep->dl.sub.rx_qual = random() % 8;
+	rep->ul.full.rx_lev = random() % 64;
+	rep->ul.sub.rx_lev = random() % 64;
+	rep->ul.full.rx_qual = random() % 8;
+	rep->ul.sub.rx_qual = random() % 8;
+}
+
+static void check_lchan(const struct gsm_lchan *lchan)
+{
+	unsigned int num, n;
+	int field, be;
+
+	for (field = 0; field < MEAS_REP_NUM_FIELDS; field++) {
+		for (num = 1; num <= 10; num++)
+			COMPARE(get_meas_rep_avg(lchan, field, num),
+				==, scan_avg(lchan, field, num));
+
+		for (num = 1; num <= 10; num++)
+			for (n = 0; n <= num; n++)
+				for (be = -1; be <= 9; be++)
+					COMPARE(meas_rep_n_out_of_m_be(lchan,
+							field, n, num, be),
+						==, scan_n_out_of_m_be(lchan,
+							field, n, num, be));
+	}
+}
+
+static void test_meas_rep(void)
+{
+	struct gsm_lchan *lchan;
+	int i;
+
+	printf("Testing the measurement report averages\n");
+
+	lchan = calloc(1, sizeof(*lchan));
+	if (!lchan)
+		exit(1);
+
+	for (i = 0; i < NUM_REPORTS; i++) {
+		fill_report(lchan_next_meas_rep(lchan));
+
+		/* handover decision without and with the report committed */
+		check_lchan(lchan);
+		if (random() % 2) {
+			lchan_commit_meas_rep(lchan);
+			check_lchan(lchan);
+		}
+
+		/* the channel got released */
+		if (random() % 500 == 0) {
+			lchan_reset_meas_rep(lchan);
+			check_lchan(lchan);
+		}
+	}
+
+	free(lchan);
+}
+
+static void test_neigh_meas(void)
+{
+	struct neigh_meas_proc nmp;
+	int i, window;
+
+	printf("Testing the neighbor averages\n");
+
+	memset(&nmp, 0, sizeof(nmp));
+	for (i = 0; i < NUM_REPORTS; i++) {
+		neigh_meas_add(&nmp, random() % 64);
+
+		for (window = 1; window <= MAX_WIN_NEIGH_AVG; window++)
+			COMPARE(neigh_meas_avg(&nmp, window),
+				==, scan_neigh_avg(&nmp, window));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	srandom(2342);
+
+	test_meas_rep();
+	test_neigh_meas();
+
+	printf("Done\n");
+	return 0;
+}
@@ -0,0 +1,221 @@
+/* Replay an OML bring-up against a simulated BTS with latency */
+/*
+ * (C) 2012 by the OpenBSC project
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/gsm/protocol/gsm_12_21.h>
+#include <osmocom/abis/e1_input.h>
+
+#include <openbsc/gsm_data.h>
+#include <openbsc/abis_nm.h>
+#include <openbsc/bss.h>
+
+#define NUM_TRX		4
+#define LATENCY_MS	10	/* one way */
+#define PROCESS_MS	1	/* per message in the BTS */
+
+/*
+ * The simulated BTS handles one message after the other and answers
+ * each with an ACK. It checks that we never have two messages for the
+ * same object outstanding.
+ */
+struct sim_reply {
+	unsigned int due;
+	uint8_t msg_type;
+	uint8_t obj_class;
+	struct abis_om_obj_inst inst;
+};
+
+static struct {
+	unsigned int now;
+	unsigned int busy_until;
+	unsigned int sent;
+	int nr_replies;
+	struct sim_reply replies[64];
+} sim;
+
+static struct e1inp_sign_link oml_link;
+
+int abis_sendmsg(struct msgb *msg)
+{
+	struct abis_om_hdr *oh = (struct abis_om_hdr *) msg->data;
+	struct abis_om_fom_hdr *foh = (struct abis_om_fom_hdr *) oh->data;
+	struct sim_reply *reply;
+	unsigned int arrival;
+	int i;
+
+	for (i = 0; i < sim.nr_replies; i++) {
+		reply = &sim.replies[i];
+		if (reply->obj_class == foh->obj_class
+		    && !memcmp(&reply->inst, &foh->obj_inst, sizeof(reply->inst))) {
+			fprintf(stderr, "Message 0x%02x for an object that "
+				"waits for an ACK\n", foh->msg_type);
+			exit(-1);
+		}
+	}
+
+	arrival = sim.now + LATENCY_MS;
+	if (arrival < sim.busy_until)
+		arrival = sim.busy_until;
+	sim.busy_until = arrival + PROCESS_MS;
+
+	reply = &sim.replies[sim.nr_replies++];
+	reply->due = sim.busy_until + LATENCY_MS;
+	reply->msg_type = foh->msg_type + 1;
+	reply->obj_class = foh->obj_class;
+	reply->inst = foh->obj_inst;
+
+	sim.sent += 1;
+	msgb_free(msg);
+	return 0;
+}
+
+/* deliver the earliest ACK, the replies are ordered by due time */
+static void sim_deliver(void)
+{
+	struct sim_reply reply = sim.replies[0];
+	struct abis_om_hdr *oh;
+	struct abis_om_fom_hdr *foh;
+	struct msgb *msg;
+
+	sim.nr_replies -= 1;
+	memmove(&sim.replies[0], &sim.replies[1],
+		sim.nr_replies * sizeof(sim.replies[0]));
+	sim.now = reply.due;
+
+	msg = msgb_alloc(128, "OML ACK");
+	oh = (struct abis_om_hdr *) msgb_put(msg, ABIS_OM_FOM_HDR_SIZE);
+	oh->mdisc = ABIS_OM_MDISC_FOM;
+	oh->placement = ABIS_OM_PLACEMENT_ONLY;
+	oh->sequence = 0;
+	oh->length = sizeof(*foh);
+	foh = (struct abis_om_fom_hdr *) oh->data;
+	foh->msg_type = reply.msg_type;
+	foh->obj_class = reply.obj_class;
+	foh->obj_inst = reply.inst;
+
+	msg->l2h = msg->data;
+	msg->dst = &oml_link;
+	abis_nm_rcvmsg(msg);
+}
+
+/* the order in which bts_ipaccess_nanobts.c configures the objects */
+static void replay_bringup(struct gsm_bts *bts)
+{
+	static uint8_t attr[] = { NM_ATT_ARFCN_LIST, 0x00, 0x02, 0x00, 0x01 };
+	struct gsm_bts_trx *trx;
+	int i;
+
+	abis_nm_set_bts_attr(bts, attr, sizeof(attr));
+	abis_nm_chg_adm_state(bts, NM_OC_BTS, bts->bts_nr, 0xff, 0xff,
+			      NM_STATE_UNLOCKED);
+	abis_nm_opstart(bts, NM_OC_BTS, bts->bts_nr, 0xff, 0xff);
+
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		abis_nm_chg_adm_state(bts, NM_OC_BASEB_TRANSC, bts->bts_nr,
+				      trx->nr, 0xff, NM_STATE_UNLOCKED);
+		abis_nm_opstart(bts, NM_OC_BASEB_TRANSC, bts->bts_nr,
+				trx->nr, 0xff);
+
+		abis_nm_set_radio_attr(trx, attr, sizeof(attr));
+		abis_nm_chg_adm_state(bts, NM_OC_RADIO_CARRIER, bts->bts_nr,
+				      trx->nr, 0xff, NM_STATE_UNLOCKED);
+		abis_nm_opstart(bts, NM_OC_RADIO_CARRIER, bts->bts_nr,
+				trx->nr, 0xff);
+
+		for (i = 0; i < TRX_NR_TS; i++) {
+			struct gsm_bts_trx_ts *ts = &trx->ts[i];
+
+			abis_nm_set_channel_attr(ts, abis_nm_chcomb4pchan(ts->pchan));
+			abis_nm_chg_adm_state(bts, NM_OC_CHANNEL, bts->bts_nr,
+					      trx->nr, ts->nr, NM_STATE_UNLOCKED);
+			abis_nm_opstart(bts, NM_OC_CHANNEL, bts->bts_nr,
+					trx->nr, ts->nr);
+		}
+	}
+}
+
+static unsigned int run_bringup(struct gsm_bts *bts, int window)
+{
+	memset(&sim, 0, sizeof(sim));
+	bts->abis_nm_window = window;
+
+	replay_bringup(bts);
+	while (sim.nr_replies > 0)
+		sim_deliver();
+
+	if (!llist_empty(&bts->abis_queue) || bts->abis_nm_pend != 0) {
+		fprintf(stderr, "Window %d: OML queue did not drain\n", window);
+		exit(-1);
+	}
+
+	printf("window %d: %u messages, bring-up took %u ms\n",
+	       window, sim.sent, sim.now);
+	return sim.now;
+}
+
+int main(int argc, char **argv)
+{
+	struct gsm_network *network;
+	struct gsm_bts *bts;
+	unsigned int serial, windowed;
+	int i, j;
+
+	printf("Testing the OML send window\n");
+
+	bts_model_nanobts_init();
+	network = gsm_network_init(1, 1, NULL);
+	if (!network)
+		exit(1);
+	bts = gsm_bts_alloc_register(network, GSM_BTS_TYPE_NANOBTS,
+				     HARDCODED_TSC, HARDCODED_BSIC);
+	for (i = 1; i < NUM_TRX; i++)
+		gsm_bts_trx_alloc(bts);
+	for (i = 0; i < NUM_TRX; i++) {
+		struct gsm_bts_trx *trx = gsm_bts_trx_num(bts, i);
+
+		for (j = 0; j < TRX_NR_TS; j++) {
+			if (trx->ts[j].pchan == GSM_PCHAN_NONE)
+				trx->ts[j].pchan = GSM_PCHAN_TCH_F;
+		}
+	}
+
+	oml_link.trx = bts->c0;
+	bts->oml_link = &oml_link;
+
+	serial = run_bringup(bts, 1);
+	run_bringup(bts, 2);
+	run_bringup(bts, 4);
+	windowed = run_bringup(bts, 8);
+
+	if (windowed >= serial) {
+		fprintf(stderr, "A larger window did not help\n");
+		exit(-1);
+	}
+
+	printf("Done\n");
+	return 0;
+}
+
+/* stubs */
+void vty_out() {}
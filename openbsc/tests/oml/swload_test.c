@@ -0,0 +1,200 @@
+/* Load a software image against a loopback ACK responder */
+/*
+ * (C) 2012 by the OpenBSC project
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/gsm/protocol/gsm_12_21.h>
+#include <osmocom/abis/e1_input.h>
+
+#include <openbsc/gsm_data.h>
+#include <openbsc/abis_nm.h>
+#include <openbsc/bss.h>
+
+#define IMAGE_SIZE	(4 * 1024 * 1024)
+#define WINDOW_SIZE	8
+
+static uint8_t *image;
+static struct e1inp_sign_link oml_link;
+
+/* the BTS side, it checks the data and ACKs every window */
+static struct {
+	unsigned int rx_off;
+	unsigned int segs;
+	unsigned int seg_in_window;
+	int done;
+	int nr_replies;
+	uint8_t replies[4];
+} bts_sim;
+
+int abis_sendmsg(struct msgb *msg)
+{
+	struct abis_om_hdr *oh = (struct abis_om_hdr *) msg->data;
+	struct abis_om_fom_hdr *foh = (struct abis_om_fom_hdr *) oh->data;
+	unsigned int len;
+
+	switch (foh->msg_type) {
+	case NM_MT_LOAD_INIT:
+		bts_sim.replies[bts_sim.nr_replies++] = NM_MT_LOAD_INIT_ACK;
+		break;
+	case NM_MT_LOAD_SEG:
+		len = (foh->data[1] << 8) | foh->data[2];
+		if (foh->data[0] != NM_ATT_IPACC_FILE_DATA
+		    || bts_sim.rx_off + len > IMAGE_SIZE
+		    || memcmp(&foh->data[3], image + bts_sim.rx_off, len)) {
+			fprintf(stderr, "Wrong segment at %u\n", bts_sim.rx_off);
+			exit(-1);
+		}
+		bts_sim.rx_off += len;
+		bts_sim.segs += 1;
+		if (++bts_sim.seg_in_window == WINDOW_SIZE || len != 245) {
+			bts_sim.replies[bts_sim.nr_replies++] = NM_MT_LOAD_SEG_ACK;
+			bts_sim.seg_in_window = 0;
+		}
+		break;
+	case NM_MT_LOAD_END:
+		bts_sim.replies[bts_sim.nr_replies++] = NM_MT_LOAD_END_ACK;
+		break;
+	}
+
+	msgb_free(msg);
+	return 0;
+}
+
+static void bts_sim_reply(struct gsm_bts *bts)
+{
+	struct abis_om_hdr *oh;
+	struct abis_om_fom_hdr *foh;
+	struct msgb *msg;
+	uint8_t mt = bts_sim.replies[0];
+
+	bts_sim.nr_replies -= 1;
+	memmove(&bts_sim.replies[0], &bts_sim.replies[1], bts_sim.nr_replies);
+
+	msg = msgb_alloc(128, "OML ACK");
+	oh = (struct abis_om_hdr *) msgb_put(msg, ABIS_OM_FOM_HDR_SIZE);
+	oh->mdisc = ABIS_OM_MDISC_FOM;
+	oh->placement = ABIS_OM_PLACEMENT_ONLY;
+	oh->sequence = 0;
+	oh->length = sizeof(*foh);
+	foh = (struct abis_om_fom_hdr *) oh->data;
+	foh->msg_type = mt;
+	foh->obj_class = NM_OC_BASEB_TRANSC;
+	foh->obj_inst.bts_nr = bts->nr;
+	foh->obj_inst.trx_nr = 0;
+	foh->obj_inst.ts_nr = 0xff;
+
+	msg->l2h = msg->data;
+	msg->dst = &oml_link;
+	abis_nm_rcvmsg(msg);
+}
+
+static int swload_cbfn(unsigned int hook, unsigned int event, struct msgb *msg,
+		       void *data, void *param)
+{
+	if (event == NM_MT_LOAD_END_ACK)
+		bts_sim.done = 1;
+	return 0;
+}
+
+/* a nanoBTS SDP image with random content */
+static void write_image(const char *fname)
+{
+	uint32_t len = htonl(IMAGE_SIZE);
+	FILE *file;
+	int i;
+
+	image = malloc(IMAGE_SIZE);
+	for (i = 0; i < IMAGE_SIZE; i++)
+		image[i] = random();
+	memcpy(image, " SDP", 4);
+	memcpy(image + 4, "\x10\x02\x00\x00", 4);
+	memcpy(image + 12, &len, 4);
+
+	file = fopen(fname, "w");
+	if (!file || fwrite(image, IMAGE_SIZE, 1, file) != 1) {
+		perror("Writing the image");
+		exit(-1);
+	}
+	fclose(file);
+}
+
+int main(int argc, char **argv)
+{
+	char fname[] = "/tmp/swload_test.XXXXXX";
+	struct gsm_network *network;
+	struct gsm_bts *bts;
+	struct timeval start, end;
+	unsigned int ms;
+	int fd, rc;
+
+	printf("Testing the software load\n");
+
+	fd = mkstemp(fname);
+	if (fd < 0) {
+		perror("mkstemp");
+		exit(-1);
+	}
+	close(fd);
+	write_image(fname);
+
+	bts_model_nanobts_init();
+	network = gsm_network_init(1, 1, NULL);
+	if (!network)
+		exit(1);
+	bts = gsm_bts_alloc_register(network, GSM_BTS_TYPE_NANOBTS,
+				     HARDCODED_TSC, HARDCODED_BSIC);
+	oml_link.trx = bts->c0;
+	bts->oml_link = &oml_link;
+
+	gettimeofday(&start, NULL);
+	rc = abis_nm_software_load(bts, 0, fname, WINDOW_SIZE, 0,
+				   swload_cbfn, NULL);
+	if (rc < 0) {
+		fprintf(stderr, "Software load failed to start: %d\n", rc);
+		exit(-1);
+	}
+	while (bts_sim.nr_replies > 0)
+		bts_sim_reply(bts);
+	gettimeofday(&end, NULL);
+	unlink(fname);
+
+	if (!bts_sim.done || bts_sim.rx_off != IMAGE_SIZE) {
+		fprintf(stderr, "Load incomplete, %u of %u bytes\n",
+			bts_sim.rx_off, IMAGE_SIZE);
+		exit(-1);
+	}
+
+	ms = (end.tv_sec - start.tv_sec) * 1000
+		+ (end.tv_usec - start.tv_usec) / 1000;
+	printf("Loaded %u bytes in %u segments in %u ms\n",
+	       bts_sim.rx_off, bts_sim.segs, ms);
+
+	printf("Done\n");
+	return 0;
+}
+
+/* stubs */
+void vty_out() {}
@@ -0,0 +1,101 @@
+/* Test the incremental System Information push */
+/*
+ * (C) 2012 by the OpenBSC project
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <osmocom/core/msgb.h>
+
+#include <openbsc/gsm_data.h>
+#include <openbsc/system_information.h>
+
+static int rsl_count;
+
+#define COMPARE(result, op, value) \
+    if (!((result) op (value))) {\
+	fprintf(stderr, "Compare failed. Was %x should be %x in %s:%d\n",result, value, __FILE__, __LINE__); \
+	exit(-1); \
+    }
+
+/* count instead of sending */
+int abis_rsl_sendmsg(struct msgb *msg)
+{
+	rsl_count += 1;
+	msgb_free(msg);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct gsm_network *network;
+	struct gsm_bts *bts;
+
+	printf("Testing the System Information push\n");
+
+	network = gsm_network_init(1, 1, NULL);
+	if (!network)
+		exit(1);
+	bts = gsm_bts_alloc_register(network, GSM_BTS_TYPE_UNKNOWN,
+				     HARDCODED_TSC, HARDCODED_BSIC);
+	bts->band = GSM_BAND_900;
+	bts->c0->arfcn = 23;
+	bts->c0->rsl_link = (void *) 0x2342L;
+
+	/* a TRX coming up gets SI1..4, SI5 and SI6 */
+	rsl_count = 0;
+	COMPARE(gsm_bts_trx_set_system_infos(bts->c0), ==, 0);
+	COMPARE(rsl_count, ==, 6);
+
+	/* nothing changed, nothing is sent */
+	rsl_count = 0;
+	gsm_bts_si_changed(bts, SI_MASK_RACH | SI_MASK_NEIGH);
+	COMPARE(gsm_bts_set_system_infos(bts), ==, 0);
+	COMPARE(rsl_count, ==, 0);
+
+	/* the RACH control parameters are part of SI1..4 */
+	rsl_count = 0;
+	bts->si_common.rach_control.cell_bar = 1;
+	gsm_bts_si_changed(bts, SI_MASK_RACH);
+	COMPARE(gsm_bts_set_system_infos(bts), ==, 4);
+	COMPARE(rsl_count, ==, 4);
+
+	/* T3212 is only in SI3, changes are coalesced */
+	rsl_count = 0;
+	bts->si_common.chan_desc.t3212 = 10;
+	gsm_bts_si_changed(bts, SI_MASK(3));
+	bts->si_common.chan_desc.t3212 = 11;
+	gsm_bts_si_changed(bts, SI_MASK(3));
+	COMPARE(gsm_bts_set_system_infos(bts), ==, 1);
+	COMPARE(rsl_count, ==, 1);
+
+	/* a TRX without RSL link gets nothing */
+	rsl_count = 0;
+	bts->c0->rsl_link = NULL;
+	bts->si_common.rach_control.cell_bar = 0;
+	gsm_bts_si_changed(bts, SI_MASK_RACH);
+	COMPARE(gsm_bts_set_system_infos(bts), ==, 0);
+	COMPARE(rsl_count, ==, 0);
+
+	printf("Done\n");
+	return 0;
+}
+
+/* stubs */
+void vty_out() {}
@@ -0,0 +1,261 @@
+/* Test and benchmark the TRAU mux */
+/*
+ * (C) 2012 by the OpenBSC project
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/application.h>
+#include <osmocom/abis/e1_input.h>
+#include <osmocom/abis/subchan_demux.h>
+#include <osmocom/abis/trau_frame.h>
+
+#include <openbsc/gsm_data.h>
+#include <openbsc/debug.h>
+#include <openbsc/mncc.h>
+#include <openbsc/trau_mux.h>
+
+/* 30 timeslots with 4 subslots each, the first half is received by
+ * the MNCC and the second half is switched in pairs */
+#define NUM_SS		120
+#define NUM_UPQUEUE	60
+#define NUM_FRAMES	100000
+#define FR_BYTES	33
+
+#define COMPARE(result, op, value) \
+    if (!((result) op (value))) {\
+	fprintf(stderr, "Compare failed. Was %x should be %x in %s:%d\n",result, value, __FILE__, __LINE__); \
+	exit(-1); \
+    }
+
+/* bit lengths of the parameters, TS 06.10 Table 1.1 */
+static const uint8_t fr_map[] = {
+	6, 6, 5, 5, 4, 4, 3, 3, 7, 2, 2, 6, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 3, 3, 3, 7, 2, 2, 6, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	3, 3, 7, 2, 2, 6, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 7,
+	2, 2, 6, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+};
+
+static struct gsm_e1_subslot subslots[NUM_SS];
+static struct gsm_bts_trx_ts timeslots[NUM_UPQUEUE];
+static struct subch_mux muxes[32];
+
+/* the last frame given to the muxer */
+static struct {
+	struct subch_mux *mx;
+	int ss;
+	uint8_t bits[TRAU_FRAME_BITS];
+	int count;
+} muxed;
+
+/* the last frame given to the MNCC */
+static struct {
+	uint8_t data[FR_BYTES];
+	uint32_t callref;
+	int count;
+} received;
+
+struct subch_mux *e1inp_get_mux(uint8_t e1_nr, uint8_t ts_nr)
+{
+	if (e1_nr != 0 || ts_nr >= ARRAY_SIZE(muxes))
+		return NULL;
+	return &muxes[ts_nr];
+}
+
+int subchan_mux_enqueue(struct subch_mux *mx, int s_nr, const uint8_t *data,
+			int len)
+{
+	COMPARE(len, ==, TRAU_FRAME_BITS);
+	muxed.mx = mx;
+	muxed.ss = s_nr;
+	memcpy(muxed.bits, data, len);
+	muxed.count += 1;
+	return 0;
+}
+
+static int mncc_recv(struct gsm_network *net, struct msgb *msg)
+{
+	struct gsm_data_frame *frame = (struct gsm_data_frame *) msg->data;
+
+	COMPARE(frame->msg_type, ==, GSM_TCHF_FRAME);
+	COMPARE((int) msgb_length(msg), ==, (int) (sizeof(*frame) + FR_BYTES));
+	memcpy(received.data, frame->data, FR_BYTES);
+	received.callref = frame->callref;
+	received.count += 1;
+	msgb_free(msg);
+	return 0;
+}
+
+/* the bit by bit reassembly the mux used before */
+static void ref_pack(uint8_t *data, const uint8_t *d_bits)
+{
+	int i, k, l = 0, o = 0;
+
+	memset(data, 0, FR_BYTES);
+	data[0] = 0xd << 4;
+	for (i = 0; i < 260; i++) {
+		k = fr_map[l] - 1 - (i - o);
+		data[(i + 4) / 8] |= d_bits[o + k] << (7 - ((i + 4) % 8));
+		if (k == 0)
+			o += fr_map[l++];
+	}
+}
+
+static void random_frame(uint8_t *data)
+{
+	int i;
+
+	for (i = 0; i < FR_BYTES; i++)
+		data[i] = random();
+	data[0] = 0xd0 | (data[0] & 0x0f);
+}
+
+static void send_frame(struct gsm_lchan *lchan, const uint8_t *data)
+{
+	uint8_t buf[sizeof(struct gsm_data_frame) + FR_BYTES];
+	struct gsm_data_frame *frame = (struct gsm_data_frame *) buf;
+
+	frame->msg_type = GSM_TCHF_FRAME;
+	frame->callref = 0;
+	memcpy(frame->data, data, FR_BYTES);
+	COMPARE(trau_send_frame(lchan, frame), ==, 0);
+}
+
+/* MNCC -> lchan -> MNCC, comparing with the old reassembly */
+static void check_upqueue(int i)
+{
+	struct decoded_trau_frame tf;
+	uint8_t data[FR_BYTES], ref[FR_BYTES];
+	int muxed_count = muxed.count, received_count = received.count;
+
+	random_frame(data);
+	send_frame(&timeslots[i].lchan[0], data);
+	COMPARE(muxed.count, ==, muxed_count + 1);
+	COMPARE(muxed.mx == &muxes[subslots[i].e1_ts], ==, 1);
+	COMPARE(muxed.ss, ==, subslots[i].e1_ts_ss);
+
+	COMPARE(decode_trau_frame(&tf, muxed.bits), ==, 0);
+	ref_pack(ref, tf.d_bits);
+	COMPARE(memcmp(ref, data, FR_BYTES), ==, 0);
+
+	COMPARE(trau_mux_input(&subslots[i], muxed.bits, TRAU_FRAME_BITS), ==, 0);
+	COMPARE(received.count, ==, received_count + 1);
+	COMPARE(received.callref, ==, i + 1);
+	COMPARE(memcmp(received.data, data, FR_BYTES), ==, 0);
+}
+
+/* an uplink frame on one subslot is sent down on its peer */
+static void check_map(int i, const uint8_t *uplink)
+{
+	int peer = NUM_UPQUEUE + ((i - NUM_UPQUEUE) ^ 1);
+	int muxed_count = muxed.count;
+
+	COMPARE(trau_mux_input(&subslots[i], uplink, TRAU_FRAME_BITS), ==, 0);
+	COMPARE(muxed.count, ==, muxed_count + 1);
+	COMPARE(muxed.mx == &muxes[subslots[peer].e1_ts], ==, 1);
+	COMPARE(muxed.ss, ==, subslots[peer].e1_ts_ss);
+}
+
+int main(int argc, char **argv)
+{
+	struct gsm_network *network;
+	struct gsm_bts *bts;
+	struct decoded_trau_frame tf;
+	uint8_t uplink[TRAU_FRAME_BITS];
+	struct timeval start, end;
+	double secs;
+	int i;
+
+	printf("Testing the TRAU mux\n");
+
+	srandom(2342);
+	osmo_init_logging(&log_info);
+
+	network = gsm_network_init(1, 1, mncc_recv);
+	if (!network)
+		exit(1);
+	bts = gsm_bts_alloc_register(network, GSM_BTS_TYPE_UNKNOWN,
+				     HARDCODED_TSC, HARDCODED_BSIC);
+
+	for (i = 0; i < NUM_SS; i++) {
+		subslots[i].e1_nr = 0;
+		subslots[i].e1_ts = 1 + i / 4;
+		subslots[i].e1_ts_ss = i % 4;
+	}
+
+	for (i = 0; i < NUM_UPQUEUE; i++) {
+		timeslots[i].trx = bts->c0;
+		timeslots[i].e1_link = subslots[i];
+		timeslots[i].lchan[0].ts = &timeslots[i];
+		COMPARE(trau_recv_lchan(&timeslots[i].lchan[0], i + 1), ==, 0);
+	}
+	for (i = NUM_UPQUEUE; i < NUM_SS; i += 2)
+		COMPARE(trau_mux_map(&subslots[i], &subslots[i + 1]), ==, 0);
+
+	/* an uplink FR frame for the switched subslots */
+	memset(&tf, 0, sizeof(tf));
+	tf.c_bits[3] = 1;
+	memset(&tf.c_bits[11], 1, 10);
+	memset(tf.t_bits, 1, 4);
+	for (i = 0; i < 260; i++)
+		tf.d_bits[i] = random() & 1;
+	encode_trau_frame(uplink, &tf);
+
+	for (i = 0; i < NUM_SS; i++) {
+		if (i < NUM_UPQUEUE)
+			check_upqueue(i);
+		else
+			check_map(i, uplink);
+	}
+
+	/* one of the mappings is gone, and so is a receiver */
+	COMPARE(trau_mux_unmap(&subslots[NUM_UPQUEUE + 1], 0), ==, 0);
+	COMPARE(trau_mux_input(&subslots[NUM_UPQUEUE], uplink,
+			       TRAU_FRAME_BITS), ==, -EINVAL);
+	COMPARE(trau_mux_unmap(NULL, 1), ==, 0);
+	COMPARE(trau_mux_input(&subslots[0], muxed.bits, TRAU_FRAME_BITS), ==,
+		-EINVAL);
+	COMPARE(trau_mux_unmap(&subslots[0], 0), ==, -ENOENT);
+	COMPARE(trau_mux_map(&subslots[NUM_UPQUEUE], &subslots[NUM_UPQUEUE + 1]), ==, 0);
+	COMPARE(trau_recv_lchan(&timeslots[0].lchan[0], 1), ==, 0);
+
+	/* every subslot carries a frame each 20ms */
+	gettimeofday(&start, NULL);
+	for (i = 0; i < NUM_FRAMES; i++) {
+		int ss = i % NUM_SS;
+
+		if (ss < NUM_UPQUEUE) {
+			send_frame(&timeslots[ss].lchan[0], received.data);
+			trau_mux_input(&subslots[ss], muxed.bits, TRAU_FRAME_BITS);
+		} else
+			trau_mux_input(&subslots[ss], uplink, TRAU_FRAME_BITS);
+	}
+	gettimeofday(&end, NULL);
+
+	secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+	printf("%d frames on %d subslots in %.3f seconds, %.0f frames per "
+		"second\n", NUM_FRAMES, NUM_SS, secs, NUM_FRAMES / secs);
+
+	printf("Done\n");
+	return 0;
+}